@@ -0,0 +1,256 @@
+//  cidrtest.c
+//
+//  Copyright © 2016-2018 Dr. Rolf Jansen. All rights reserved.
+//
+//  Differential test of the range to CIDR decomposition by cidrIP4()/cidrIP6() against the former
+//  log2 and alignment loops, which is exhaustive for every range in some windows of the address spaces
+//  -- at the bottom, across the 31/32 and 63/64 bit boundaries and at the top -- and random otherwise.
+//  Besides, each decomposition is checked to cover the range exactly by aligned blocks of maximal size.
+//
+//  make cidrtest && ./cidrtest
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "utils.h"
+#include "uint128t.h"
+#include "store.h"
+
+typedef unsigned long long ullong;
+typedef union
+{
+    ullong    q[2];
+    uint128t  t;
+  __uint128_t v;
+} uint128u;
+
+#define MAXBLK 300
+
+typedef struct
+{
+   __uint128_t ip;
+   int32_t     m;
+} Block;
+
+static ullong errors, dropped, wrapped, ranges;
+
+
+static uint64_t rnd(void)
+{
+   static uint64_t s = 0x9E3779B97F4A7C15;
+   s ^= s << 13, s ^= s >> 7, s ^= s << 17;
+   return s;
+}
+
+
+#pragma mark ••• Former Decomposition •••
+
+static int32_t intlb6_1p(uint128t v)
+{
+   uint128t u;
+   int o, p, q;
+   for (p = 0, q = 127; p <= q;)
+   {
+      o = (p + q) >> 1;
+      if (le_u128(u = v6[o].number, v) && lt_u128(v, v6[o+1].number))
+         return o;
+      else if (lt_u128(v, u))
+         q = o-1;
+      else // (ge_u128(v, v6[o+1]))
+         p = o+1;
+   }
+
+   return 0;
+}
+
+static int formerIP4(uint32_t ip, uint32_t hi, Block blk[])
+{
+   int32_t m, n = 0;
+   do
+   {
+      m = (int32_t)log2((double)(hi - ip)+1);
+      while (ip - (ip >> m << m))
+         m--;
+      blk[n].ip = ip, blk[n].m = m;
+   }
+   while (++n < MAXBLK && (ip += (uint32_t)1<<m) < hi);
+
+   return n;
+}
+
+static int formerIP6(uint128t ip, uint128t hi, Block blk[])
+{
+   int32_t m, n = 0;
+   do
+   {
+      m = intlb6_1p(sub_u128(hi, ip));
+      while (gt_u128(sub_u128(ip, shl_u128(shr_u128(ip, m), m)), u64_to_u128t(0)))
+         m--;
+      blk[n].ip = ((uint128u)ip).v, blk[n].m = m;
+   }
+   while (++n < MAXBLK && lt_u128(ip = add_u128(ip, shl_u128(u64_to_u128t(1), m)), hi));
+
+   return n;
+}
+
+
+#pragma mark ••• Bit Trick Decomposition •••
+
+static int cidrsIP4(uint32_t ip, uint32_t hi, Block blk[])
+{
+   uint32_t last;
+   int32_t  m, n = 0;
+   do
+   {
+      m = cidrIP4(ip, hi);
+      blk[n].ip = ip, blk[n].m = m, n++;
+   }
+   while ((last = ip + (uint32_t)(((uint64_t)1<<m) - 1)) < hi && (ip = last + 1, true));
+
+   return n;
+}
+
+static int cidrsIP6(uint128t ip, uint128t hi, Block blk[])
+{
+   uint128t last;
+   int32_t  m, n = 0;
+   do
+   {
+      m = cidrIP6(ip, hi);
+      blk[n].ip = ((uint128u)ip).v, blk[n].m = m, n++;
+   }
+   while (lt_u128(last = add_u128(ip, v6[m].number), hi) && (ip = add_u128(last, u64_to_u128t(1)), true));
+
+   return n;
+}
+
+
+#pragma mark ••• Verification •••
+
+// the blocks must be aligned, adjacent, cover [lo, hi] exactly, and none may be doubled without
+// either losing its alignment or extending beyond hi
+static boolean exact(__uint128_t lo, __uint128_t hi, int bits, Block blk[], int n)
+{
+   __uint128_t ip = lo, size, top = (bits == 128) ? ~(__uint128_t)0 : ((__uint128_t)1 << bits) - 1;
+   int i;
+
+   for (i = 0; i < n; i++)
+   {
+      if (blk[i].ip != ip || blk[i].m < 0 || blk[i].m > bits)
+         return false;
+
+      size = (blk[i].m < 128) ? (__uint128_t)1 << blk[i].m : 0;
+      if (blk[i].m < 128 && ip & (size - 1))
+         return false;
+
+      if (blk[i].m < bits && !(ip & size) && size - 1 <= top - ip && ip + 2*size - 1 <= hi)
+         return false;
+
+      if (i < n-1)
+         ip += size;
+   }
+
+   return (blk[n-1].m == bits) ? lo == 0 && hi == top
+                               : ip + ((__uint128_t)1 << blk[n-1].m) - 1 == hi;
+}
+
+static void compare(__uint128_t lo, __uint128_t hi, int bits, Block old[], int o, Block new[], int n)
+{
+   int i;
+
+   ranges++;
+   if (!exact(lo, hi, bits, new, n))
+   {
+      errors++;
+      printf("IPv%d 0x%016llX|%016llX - 0x%016llX|%016llX -- inexact decomposition\n", (bits == 32) ? 4 : 6,
+             (ullong)(lo >> 64), (ullong)lo, (ullong)(hi >> 64), (ullong)hi);
+      return;
+   }
+
+   if (o == MAXBLK || o > n)
+   {
+      wrapped++;    // the former loop ran past the top of the address space
+      return;
+   }
+
+   for (i = 0; i < o; i++)
+      if (old[i].ip != new[i].ip || old[i].m != new[i].m)
+         break;
+
+   if (i == o && o == n)
+      return;
+
+   if (i == o && o == n-1 && new[o].m == 0)
+      dropped++;    // the former loop lost the last address of the range
+   else
+   {
+      errors++;
+      printf("IPv%d 0x%016llX|%016llX - 0x%016llX|%016llX -- block %d differs\n", (bits == 32) ? 4 : 6,
+             (ullong)(lo >> 64), (ullong)lo, (ullong)(hi >> 64), (ullong)hi, i);
+   }
+}
+
+static void testIP4(uint32_t lo, uint32_t hi)
+{
+   Block old[MAXBLK], new[MAXBLK];
+   int   o = (hi - lo != UINT32_MAX) ? formerIP4(lo, hi, old) : MAXBLK,
+         n = cidrsIP4(lo, hi, new);
+   compare(lo, hi, 32, old, o, new, n);
+}
+
+static void testIP6(__uint128_t lo, __uint128_t hi)
+{
+   Block    old[MAXBLK], new[MAXBLK];
+   uint128u l = {.v = lo}, h = {.v = hi};
+   int      o = (hi - lo != ~(__uint128_t)0) ? formerIP6(l.t, h.t, old) : MAXBLK,
+            n = cidrsIP6(l.t, h.t, new);
+   compare(lo, hi, 128, old, o, new, n);
+}
+
+
+int main(int argc, const char *argv[])
+{
+   int         b, i, k, w = 2048;
+   uint32_t    base4[] = {0, 0x7FFFFC00, 0xFFFFF800};
+   __uint128_t base6[] = {0, ((__uint128_t)1 << 64) - 1024, ((__uint128_t)1 << 127) - 1024, ~(__uint128_t)0 - (w-1)};
+
+   for (b = 0; b < sizeof(base4)/sizeof(uint32_t); b++)
+      for (i = 0; i < w; i++)
+         for (k = i; k < w; k++)
+            testIP4(base4[b] + i, base4[b] + k);
+   testIP4(0, UINT32_MAX);
+
+   for (i = 0; i < 10000000; i++)
+   {
+      uint32_t p = (uint32_t)rnd(), q = (uint32_t)rnd() >> (rnd() & 31);
+      testIP4(p & ~q, p | q);
+   }
+
+   for (b = 0; b < sizeof(base6)/sizeof(__uint128_t); b++)
+      for (i = 0; i < w; i++)
+         for (k = i; k < w; k++)
+            testIP6(base6[b] + i, base6[b] + k);
+   testIP6(0, ~(__uint128_t)0);
+
+   for (i = 0; i < 1000000; i++)
+   {
+      uint128u p = {.q = {rnd(), rnd()}}, q = {.q = {rnd(), rnd()}};
+      q.v >>= rnd() & 127;
+      testIP6(p.v & ~q.v, p.v | q.v);
+   }
+
+   printf("%llu ranges, %llu errors, former loop dropped the last address %llu and wrapped %llu times\n",
+          ranges, errors, dropped, wrapped);
+   return (errors) ? 1 : 0;
+}
@@ -64,7 +64,7 @@ void usage(const char *executable)
    printf("             i.e, 2 letter capital country codes, separated by colon.\n");
    printf(" -d DD:EE:.. deny IPv4 source addresses from the listed countries.\n");
    printf("             NOTE: the -a and the -d option are mutually exclusive.\n");
-   printf(" -r bstfile  the path to the binary file with the consolidated IP ranges that has been.\n");
+   printf(" -r bstfile  the path to the database file with the consolidated IP ranges that has been\n");
    printf("             generated by the 'ipdb' tool [default: /usr/local/etc/ipdb/IPRanges/ipcc.bst].\n");
    printf(" -p pidfile  the path to the pid file [default: /var/run/"DAEMON_NAME".pid].\n");
    printf(" -f          foreground mode, don't fork off as a daemon.\n");
@@ -195,14 +195,33 @@ void daemonize(DaemonKind kind)
 bool allowMatch = true;
 
 CCNode **CCTable = NULL;
-IP4Set  *sortedIP4Sets = NULL;
+DBFile   *IPDB          = NULL;
+uint32_t *startKeys     = NULL,     // range starts (v4k, v4v), if present,
+         *startVals     = NULL;
+IP4Pack   packedIP4Sets = {};       // otherwise the packed table (v4p), if present,
+IP4Set   *sortedIP4Sets = NULL;     // otherwise the plain table (v4)
+int       tableCount    = 0;
 
 void releaseStores(void)
 {
-   deallocate(VPR(sortedIP4Sets), false);
+   closeDB(&IPDB);
    releaseCCTable(CCTable);
 }
 
+// Returns the country code of the range of ip4, or 0 if it is not in any range.
+static inline uint32_t lookupCC(uint32_t ip4)
+{
+   int    o;
+   IP4Set set;
+
+   if (startKeys)
+      return ((o = predecessorIP4Search(ip4, startKeys, tableCount)) >= 0) ? startVals[o] : 0;
+   else if (packedIP4Sets.head)
+      return (searchIP4Pack(ip4, &packedIP4Sets, &set) >= 0) ? set.cc : 0;
+   else
+      return ((o = bisectionIP4Search(ip4, sortedIP4Sets, tableCount)) >= 0) ? sortedIP4Sets[o].cc : 0;
+}
+
 int main(int argc, char *argv[])
 {
    int   ch, rc     = 0;
@@ -286,17 +305,18 @@ int main(int argc, char *argv[])
       }
    }
 
-   struct stat st;
-   FILE *in;
-   if (stat(bstfname, &st) == no_error && st.st_size && (in = fopen(bstfname, "r")))
+   if (IPDB = openDB(bstfname))
    {
-      sortedIP4Sets = allocate((ssize_t)st.st_size, false, default_align);
+      int n;
       atexit(releaseStores);
-      rc = (int)fread(sortedIP4Sets, (ssize_t)st.st_size, 1, in);
-      fclose(in);
-      if (!rc)
+      if ((startKeys = getDBSection(IPDB, "v4k", sizeof(uint32_t), &tableCount)) == NULL
+       || (startVals = getDBSection(IPDB, "v4v", sizeof(uint32_t), &n)) == NULL || n != tableCount)
+         startKeys = NULL;
+
+      if (!startKeys && !openIP4Pack(IPDB, "v4p", &packedIP4Sets)
+       && !(sortedIP4Sets = getDBSection(IPDB, "v4", sizeof(IP4Set), &tableCount)))
       {
-         syslog(LOG_ERR, "IPv4 database file could not be loaded.");
+         syslog(LOG_ERR, "IPv4 database table could not be found.");
          exit(EXIT_FAILURE);
       }
 
@@ -322,7 +342,7 @@ int main(int argc, char *argv[])
       socklen_t addrlen = sizeof(addr);
       ssize_t recvlen, sendlen;
 
-      int o, n = (int)(st.st_size/sizeof(IP4Set));
+      uint32_t cc;
 
       for (;;)
       {
@@ -333,9 +353,9 @@ int main(int argc, char *argv[])
          }
 
          // don't filter if no CC list was given or if the source IP cannot be found in the IP ranges sets
-         if (CCTable && (o = bisectionIP4Search(htonl(ip->ip_src.s_addr), sortedIP4Sets, n)) >= 0)
+         if (CCTable && (cc = lookupCC(htonl(ip->ip_src.s_addr))))
          {
-            bool doesMatch = findCC(CCTable, sortedIP4Sets[o].cc) != NULL;
+            bool doesMatch = findCC(CCTable, cc) != NULL;
             if (allowMatch && !doesMatch || !allowMatch && doesMatch)
                continue;
          }
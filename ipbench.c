@@ -0,0 +1,765 @@
+//  ipbench.c
+//  ipbench
+//
+//  Copyright © 2016-2018 Dr. Rolf Jansen. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+//  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+//  AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER
+//  OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+//  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//  Benchmark of the lookup engines, built by 'make bench'. It is not installed.
+//
+//  The v4 and v6 tables are taken from a database file, or they are synthesized with -g. The bench derives the
+//  packed and the range start copies from the plain tables into a temporary database file, so that all engines
+//  are compared on the same rows, independent of the ipdb options with which the database file was built.
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "utils.h"
+#include "uint128t.h"
+#include "store.h"
+
+
+void usage(const char *executable)
+{
+   const char *r = executable + strvlen(executable);
+   while (--r >= executable && *r != '/');
+   r++;
+   printf("%s v1.2b (" SCMREV "), Copyright © 2016-2018 Dr. Rolf Jansen\n\n", r);
+   printf("Usage:\n\n");
+   printf("1) measure the lookup rate and latency percentiles of the bisection, packed and range start lookups:\n\n");
+   printf("   %s [-n lookups] [-z exponent] [-a addrfile] [-g rows] [-s seed] [-4] [-6] [-h] [bstfile]\n\n", r);
+   printf("      -n lookups        Number of lookups per address stream [default: 1000000].\n");
+   printf("      -z exponent       Exponent of the Zipf distribution of the skewed stream [default: 1.0].\n");
+   printf("      -a addrfile       Replay the IPv4 and IPv6 addresses in addrfile, one per line, as a third stream.\n");
+   printf("      -g rows           Synthesize tables with the given number of IPv4 ranges and a quarter as many IPv6 ranges,\n");
+   printf("                        instead of loading them from the database file.\n");
+   printf("      -4                Benchmark only the IPv4 lookups.\n");
+   printf("      -6                Benchmark only the IPv6 lookups.\n");
+   printf("      -h                Show these usage instructions.\n");
+   printf("      bstfile           Path to the database file which was generated by the 'ipdb' tool\n");
+   printf("                        [default: /usr/local/etc/ipdb/IPRanges/ipcc.bst].\n\n");
+   printf("2) generate synthetic RIR statistics files afrinic.dat ... ripencc.dat for benchmarking the 'ipdb' build:\n\n");
+   printf("   %s -f records [-s seed] [directory]\n\n", r);
+   printf("      -f records        Total number of ipv4, ipv6 and asn records, distributed over the five files.\n");
+   printf("      directory         The files are written into the given directory [default: the current directory].\n\n");
+   printf("   valid argument in usage forms 1+2:\n\n");
+   printf("      -s seed           Seed of the random number generator, the same seed gives the same tables or files.\n\n");
+}
+
+
+#pragma mark ••• Timing •••
+
+// The latencies are measured per lookup with the time stamp counter, and so, they include some jitter
+// of the out-of-order execution. The overhead of reading the counter is deducted.
+
+static double nsPerTick = 1.0;
+static uint64_t  ticksOH = 0;
+
+static inline double seconds(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+static inline uint64_t ticks(void)
+{
+#if defined(__x86_64__)
+   return __rdtsc();
+#else
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (uint64_t)t.tv_sec*1000000000 + (uint64_t)t.tv_nsec;
+#endif
+}
+
+static void calibrateTicks(void)
+{
+   double   s = seconds(), e;
+   uint64_t t = ticks(), u;
+   while ((e = seconds()) - s < 0.05);
+   u = ticks();
+   nsPerTick = (e - s)*1e9/(double)(u - t);
+
+   ticksOH = UINT64_MAX;
+   for (int i = 0; i < 1000; i++)
+   {
+      t = ticks(), u = ticks();
+      if (u - t < ticksOH)
+         ticksOH = u - t;
+   }
+}
+
+
+#pragma mark ••• Address Streams •••
+
+static uint64_t seed = 88172645463325252ULL;
+
+static inline uint64_t rnd64(void)
+{
+   seed ^= seed << 13;
+   seed ^= seed >> 7;
+   seed ^= seed << 17;
+   return seed;
+}
+
+static inline double rnd01(void)
+{
+   return (double)(rnd64() >> 11)*0x1.0p-53;
+}
+
+// Zipf ranks are drawn by bisection of the cumulative distribution, and rank r is mapped to row perm[r],
+// so that the popular rows are scattered over the table, like the popular networks in the address space.
+typedef struct
+{
+   double *cdf;
+   int    *perm;
+   int     count;
+} Zipf;
+
+static boolean createZipf(Zipf *z, int count, double s)
+{
+   *z = (Zipf){};
+   if ((z->cdf = allocate(count*sizeof(double), default_align, false)) == NULL
+    || (z->perm = allocate(count*sizeof(int), default_align, false)) == NULL)
+      return false;
+
+   double sum = 0.0;
+   for (int r = 0; r < count; r++)
+      z->cdf[r] = sum += pow(r + 1, -s);
+   for (int r = 0; r < count; r++)
+      z->cdf[r] /= sum, z->perm[r] = r;
+   for (int r = count - 1; r > 0; r--)
+   {
+      int k = (int)(rnd64() % (uint64_t)(r + 1)), t = z->perm[r];
+      z->perm[r] = z->perm[k], z->perm[k] = t;
+   }
+
+   z->count = count;
+   return true;
+}
+
+static inline int zipfRow(Zipf *z)
+{
+   double u = rnd01();
+   int    o = 0, n = z->count, half;
+   for (; n > 1; n -= half)
+   {
+      half = n >> 1;
+      o = (z->cdf[o + half - 1] < u) ? o + half : o;
+   }
+   return z->perm[o];
+}
+
+static void releaseZipf(Zipf *z)
+{
+   deallocate_batch(false, VPR(z->cdf), VPR(z->perm), NULL);
+}
+
+static inline uint32_t rangeIP4(IP4Set *set)
+{
+   return set->lo + (uint32_t)(rnd64() % ((uint64_t)set->hi - set->lo + 1));
+}
+
+static inline uint128t rangeIP6(IP6Set *set)
+{
+   IP6Desc span = {.number = sub_u128(set->hi, set->lo)};
+   uint64_t  o = (span.quad[b2_1] || span.quad[b2_0] == UINT64_MAX) ? rnd64() : rnd64() % (span.quad[b2_0] + 1);
+   return add_u128(set->lo, u64_to_u128t(o));
+}
+
+typedef struct
+{
+   uint32_t *ip4;
+   uint128t *ip6;
+   int       n4, n6;
+} Replay;
+
+static boolean readReplay(const char *name, Replay *rp, int max)
+{
+   FILE *in;
+   char  line[256];
+
+   if ((in = fopen(name, "r")) == NULL)
+      return false;
+
+   rp->ip4 = allocate(max*sizeof(uint32_t), default_align, false);
+   rp->ip6 = allocate(max*sizeof(uint128t), default_align, false);
+   rp->n4 = rp->n6 = 0;
+
+   while (rp->ip4 && rp->ip6 && (rp->n4 < max || rp->n6 < max) && fgets(line, sizeof(line), in))
+   {
+      char *ip = bskip(line);
+      ip[wordlen(ip)] = '\0';
+
+      if (strchr(ip, ':'))
+      {
+         uint128t ip6 = ipv6_str2bin(ip);
+         if (rp->n6 < max && gt_u128(ip6, u64_to_u128t(0)))
+            rp->ip6[rp->n6++] = ip6;
+      }
+
+      else if (*ip)
+      {
+         uint32_t ip4 = ipv4_str2bin(ip);
+         if (rp->n4 < max && ip4)
+            rp->ip4[rp->n4++] = ip4;
+      }
+   }
+
+   fclose(in);
+   return rp->ip4 && rp->ip6;
+}
+
+
+#pragma mark ••• Tables •••
+
+static const char *engines[] = {"bisection", "packed", "starts"};
+
+typedef struct
+{
+   IP4Set   *sets;
+   IP4Pack   pack;
+   uint32_t *keys, *vals;
+   int       count, starts;
+} IP4Tables;
+
+typedef struct
+{
+   IP6Set   *sets;
+   IP6Pack   pack;
+   uint128t *keys;
+   uint32_t *vals;
+   int       count, starts;
+} IP6Tables;
+
+static inline uint32_t lookupIP4(int engine, uint32_t ip4, IP4Tables *t)
+{
+   IP4Set set;
+   int    o;
+
+   switch (engine)
+   {
+      case 0:
+         return ((o = bisectionIP4Search(ip4, t->sets, t->count)) >= 0) ? t->sets[o].cc : 0;
+      case 1:
+         return (searchIP4Pack(ip4, &t->pack, &set) >= 0) ? set.cc : 0;
+      default:
+         return ((o = predecessorIP4Search(ip4, t->keys, t->starts)) >= 0) ? t->vals[o] : 0;
+   }
+}
+
+static inline uint32_t lookupIP6(int engine, uint128t ip6, IP6Tables *t)
+{
+   IP6Set set;
+   int    o;
+
+   switch (engine)
+   {
+      case 0:
+         return ((o = bisectionIP6Search(ip6, t->sets, t->count)) >= 0) ? t->sets[o].cc : 0;
+      case 1:
+         return (searchIP6Pack(ip6, &t->pack, &set) >= 0) ? set.cc : 0;
+      default:
+         return ((o = predecessorIP6Search(ip6, t->keys, t->starts)) >= 0) ? t->vals[o] : 0;
+   }
+}
+
+// Sorted disjoint ranges of 256 to 65536 addresses with random gaps and country codes.
+static IP4Set *synthesizeIP4Sets(int count)
+{
+   IP4Set  *sets = allocate(count*sizeof(IP4Set), default_align, true);
+   uint64_t lo   = 0x01000000;
+   char     cc[2];
+
+   for (int i = 0; sets && i < count; i++)
+   {
+      uint64_t size = 1ULL << (8 + rnd64()%9);
+      lo = (lo + (rnd64()%4)*size + size - 1) & ~(size - 1);
+      if (lo + size > UINT32_MAX)
+         return (deallocate(VPR(sets), false), NULL);
+
+      cc[0] = 'A' + rnd64()%26, cc[1] = 'A' + rnd64()%26;
+      sets[i].lo = (uint32_t)lo, sets[i].hi = (uint32_t)(lo + size - 1);
+      sets[i].cc = *(uint16_t *)cc;
+      lo += size;
+   }
+   return sets;
+}
+
+// Sorted disjoint /32 to /48 networks within 2000::/3.
+static IP6Set *synthesizeIP6Sets(int count)
+{
+   IP6Set  *sets = allocate(count*sizeof(IP6Set), default_align, true);
+   uint64_t lo   = 0x2000000000000000ULL;
+   char     cc[2];
+
+   for (int i = 0; sets && i < count; i++)
+   {
+      uint64_t size = 1ULL << (16 + rnd64()%17);   // in units of /64 networks
+      lo = (lo + (rnd64()%4)*size + size - 1) & ~(size - 1);
+      if (lo + size > 0x3FFFFFFFFFFFFFFFULL)
+         return (deallocate(VPR(sets), false), NULL);
+
+      cc[0] = 'A' + rnd64()%26, cc[1] = 'A' + rnd64()%26;
+      sets[i].lo = (IP6Desc){.quad[b2_1] = lo}.number;
+      sets[i].hi = (IP6Desc){.quad[b2_1] = lo + size - 1, .quad[b2_0] = UINT64_MAX}.number;
+      sets[i].cc = *(uint16_t *)cc;
+      lo += size;
+   }
+   return sets;
+}
+
+static boolean storeIP4Tables(DBWriter *db, IP4Set sets[], int count)
+{
+   IP4Packer *pack   = createIP4Packer();
+   IP4Starts *starts = createIP4Starts(false);
+   boolean    rc     = pack && starts
+                    && beginDBSection(db, "v4", sizeof(IP4Set)) && appendDBSection(db, sets, count*sizeof(IP4Set))
+                    && packIP4Sets(pack, sets, count) && beginDBSection(db, "v4p", 1) && serializeIP4Packer(db, pack)
+                    && appendIP4Starts(starts, sets, count) && serializeIP4Starts(db, "v4", starts);
+   releaseIP4Packer(&pack);
+   releaseIP4Starts(&starts);
+   return rc;
+}
+
+static boolean storeIP6Tables(DBWriter *db, IP6Set sets[], int count)
+{
+   IP6Packer *pack   = createIP6Packer();
+   IP6Starts *starts = createIP6Starts(false);
+   boolean    rc     = pack && starts
+                    && beginDBSection(db, "v6", sizeof(IP6Set)) && appendDBSection(db, sets, count*sizeof(IP6Set))
+                    && packIP6Sets(pack, sets, count) && beginDBSection(db, "v6p", 1) && serializeIP6Packer(db, pack)
+                    && appendIP6Starts(starts, sets, count) && serializeIP6Starts(db, "v6", starts);
+   releaseIP6Packer(&pack);
+   releaseIP6Starts(&starts);
+   return rc;
+}
+
+
+#pragma mark ••• Synthetic RIR Statistics •••
+
+// The records follow the extended delegation statistics format, which is parsed by readRIRStatisticsFormat_v2() of ipdb.
+// Each registry allocates ascending from its own part of the address space, and the owners recur, so that the segments
+// of the same owner are merged by ipdb like the real ones.
+
+static const char *registries[] = {"afrinic", "apnic", "arin", "lacnic", "ripencc"};
+
+static boolean generateRIRFiles(const char *dir, int records)
+{
+   int   owners = records/8 + 1;
+   char *name   = alloca(OSP(strvlen(dir) + 16));
+   FILE *out;
+
+   for (int k = 0; k < 5; k++)
+   {
+      uint32_t lo4 = (uint32_t)(16 + k*40) << 24, end4 = lo4 + (40u << 24);
+      uint64_t lo6 = 0x2000000000000000ULL | (uint64_t)k << 57;
+      int      n   = records/5 + (k < records%5), e;
+      char     cc[3] = {}, ipstr[40];
+
+      // limit the sizes of the IPv4 ranges to 256 << (e-1), so that the ranges fit into the 40 /8 of the registry
+      for (e = 9; e > 1 && (double)n*0.75*(256.0*((1 << e) - 1)/e + 640.0) > (40u << 24); e--);
+
+      sprintf(name, "%s/%s.dat", dir, registries[k]);
+      if ((out = fopen(name, "w")) == NULL)
+         return false;
+
+      fprintf(out, "2|%s|20230828|%d|19830705|20230828|+0000\n", registries[k], n);
+      fprintf(out, "%s|*|asn|*|%d|summary\n%s|*|ipv4|*|%d|summary\n%s|*|ipv6|*|%d|summary\n", registries[k], n/20, registries[k], n*15/20, registries[k], n*4/20);
+
+      for (int i = 0; i < n; i++)
+      {
+         uint64_t r = rnd64() % 20, o = rnd64() % owners;
+         cc[0] = 'A' + rnd64()%26, cc[1] = 'A' + rnd64()%26;
+
+         if (r == 0)
+            fprintf(out, "%s|%s|asn|%d|1|20120605|allocated|%016llx%016llx\n", registries[k], cc, 64512 + i, (unsigned long long)(o*0x9E3779B97F4A7C15ULL), (unsigned long long)(~o*0xC2B2AE3D27D4EB4FULL));
+
+         else if (r < 16)
+         {
+            uint32_t size = (rnd64()%8) ? 256u << rnd64()%e : 256u*(1 + rnd64()%(2*e));
+            lo4 += (uint32_t)(rnd64()%4)*256;
+            if (lo4 + (uint64_t)size > end4)
+               continue;
+            fprintf(out, "%s|%s|ipv4|%s|%u|20120605|%s|%016llx%016llx\n", registries[k], cc, ipv4_bin2str(lo4, ipstr), size, (r & 1) ? "allocated" : "assigned", (unsigned long long)(o*0x9E3779B97F4A7C15ULL), (unsigned long long)(~o*0xC2B2AE3D27D4EB4FULL));
+            lo4 += size;
+         }
+
+         else
+         {
+            int      plen = 29 + (int)(rnd64()%20);
+            uint64_t step = 1ULL << (64 - plen);
+            lo6 = (lo6 + (rnd64()%2)*step + step - 1) & ~(step - 1);
+            fprintf(out, "%s|%s|ipv6|%s|%d|20120605|allocated|%016llx%016llx\n", registries[k], cc, ipv6_bin2str((IP6Desc){.quad[b2_1] = lo6}.number, ipstr), plen, (unsigned long long)(o*0x9E3779B97F4A7C15ULL), (unsigned long long)(~o*0xC2B2AE3D27D4EB4FULL));
+            lo6 += step;
+         }
+      }
+
+      if (fclose(out) != no_error)
+         return false;
+   }
+
+   return true;
+}
+
+
+#pragma mark ••• Report •••
+
+static int cmpTicks(const void *a, const void *b)
+{
+   uint32_t p = *(uint32_t *)a, q = *(uint32_t *)b;
+   return (p < q) ? -1 : (p > q);
+}
+
+static void printLine(const char *stream, int engine, int n, double secs, uint32_t lat[], int hits, int miss)
+{
+   qsort(lat, n, sizeof(uint32_t), cmpTicks);
+   printf("%-8s %-10s %10.2f %8.1f %8.1f %8.1f %8.1f %9d %10d\n", stream, engines[engine], n/secs*1e-6,
+          lat[n/2]*nsPerTick, lat[(int)(n*0.9)]*nsPerTick, lat[(int)(n*0.99)]*nsPerTick, lat[(int)(n*0.999)]*nsPerTick, hits, miss);
+}
+
+// The results of the bisection serve as the reference, and any deviating result of another engine is counted as mismatch.
+// Mismatches are expected only for addresses in overlapping ranges, of which the packed and the range start tables
+// resolve to the later one, while the bisection may end at either.
+static void benchIP4(const char *stream, uint32_t ips[], int n, IP4Tables *t, uint32_t ref[], uint32_t lat[])
+{
+   for (int engine = 0; engine < 3; engine++)
+   {
+      volatile uint32_t sink = 0;
+      int      hits = 0, miss = 0;
+      uint64_t s, e;
+      double   secs = seconds();
+
+      for (int i = 0; i < n; i++)
+         sink += lookupIP4(engine, ips[i], t);
+      secs = seconds() - secs;
+
+      for (int i = 0; i < n; i++)
+      {
+         s = ticks();
+         uint32_t cc = lookupIP4(engine, ips[i], t);
+         e = ticks();
+         lat[i] = (e - s > ticksOH) ? (uint32_t)(e - s - ticksOH) : 0;
+
+         if (engine == 0)
+            ref[i] = cc;
+         else if (cc != ref[i])
+            miss++;
+         hits += (cc != 0);
+      }
+
+      printLine(stream, engine, n, secs, lat, hits, miss);
+   }
+}
+
+static void benchIP6(const char *stream, uint128t ips[], int n, IP6Tables *t, uint32_t ref[], uint32_t lat[])
+{
+   for (int engine = 0; engine < 3; engine++)
+   {
+      volatile uint32_t sink = 0;
+      int      hits = 0, miss = 0;
+      uint64_t s, e;
+      double   secs = seconds();
+
+      for (int i = 0; i < n; i++)
+         sink += lookupIP6(engine, ips[i], t);
+      secs = seconds() - secs;
+
+      for (int i = 0; i < n; i++)
+      {
+         s = ticks();
+         uint32_t cc = lookupIP6(engine, ips[i], t);
+         e = ticks();
+         lat[i] = (e - s > ticksOH) ? (uint32_t)(e - s - ticksOH) : 0;
+
+         if (engine == 0)
+            ref[i] = cc;
+         else if (cc != ref[i])
+            miss++;
+         hits += (cc != 0);
+      }
+
+      printLine(stream, engine, n, secs, lat, hits, miss);
+   }
+}
+
+static void printHeader(const char *family, int rows, int n)
+{
+   printf("\n%s tables with %d ranges, %d lookups per stream, %.3f ns per tick\n\n", family, rows, n, nsPerTick);
+   printf("%-8s %-10s %10s %8s %8s %8s %8s %9s %10s\n", "stream", "engine", "Mlookups/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "hits", "mismatches");
+}
+
+
+int main(int argc, char *argv[])
+{
+   bool only4Flag = false,
+        only6Flag = false;
+
+   int32_t  ch,
+            rc    = 1,
+            rows  = 0,
+            recs  = 0,
+            n     = 1000000;
+   double   zexp  = 1.0;
+
+   char *bstname  = "/usr/local/etc/ipdb/IPRanges/ipcc.bst",
+        *replay   = NULL,
+        *cmd      = argv[0],
+        *lastopt  = "";
+
+   while ((ch = getopt(argc, argv, "n:z:a:g:f:s:46h")) != -1)
+   {
+      switch (ch)
+      {
+         case 'n':
+            if ((n = (int32_t)strtol(optarg, NULL, 10)) <= 0)
+            {
+               lastopt = optarg;
+               goto arg_err;
+            }
+            break;
+
+         case 'z':
+            if ((zexp = strtod(optarg, NULL)) <= 0.0)
+            {
+               lastopt = optarg;
+               goto arg_err;
+            }
+            break;
+
+         case 'a':
+            replay = optarg;
+            break;
+
+         case 'g':
+            if ((rows = (int32_t)strtol(optarg, NULL, 10)) <= 0)
+            {
+               lastopt = optarg;
+               goto arg_err;
+            }
+            break;
+
+         case 'f':
+            if ((recs = (int32_t)strtol(optarg, NULL, 10)) <= 0)
+            {
+               lastopt = optarg;
+               goto arg_err;
+            }
+            break;
+
+         case 's':
+            if ((seed = strtoull(optarg, NULL, 10)) == 0)
+            {
+               lastopt = optarg;
+               goto arg_err;
+            }
+            break;
+
+         case '4':
+            if (only6Flag)
+               goto arg_err;
+            only4Flag = true;
+            break;
+
+         case '6':
+            if (only4Flag)
+               goto arg_err;
+            only6Flag = true;
+            break;
+
+         arg_err:
+            printf("Incorrect argument:\n -%c %s, ...\n\n", ch, lastopt);
+         default:
+            rc = 1;
+         case 'h':
+            usage(cmd);
+            return rc;
+      }
+   }
+
+   if (recs)
+   {
+      const char *dir = (optind < argc) ? argv[optind] : ".";
+      if (!generateRIRFiles(dir, recs))
+      {
+         printf("The RIR statistics files could not be written into %s.\n", dir);
+         return 1;
+      }
+      return 0;
+   }
+
+   if (optind < argc)
+      bstname = argv[optind];
+
+   IP4Set   *sets4 = NULL;
+   IP6Set   *sets6 = NULL;
+   int       n4 = 0, n6 = 0;
+   DBFile   *src = NULL, *db = NULL;
+   DBWriter *out;
+   Replay    rp  = {};
+
+   char temp[] = "/tmp/ipbench.XXXXXX";
+   int  fd;
+
+   if (rows)
+   {
+      if ((sets4 = synthesizeIP4Sets(n4 = rows)) == NULL
+       || (sets6 = synthesizeIP6Sets(n6 = (rows + 3)/4)) == NULL)
+      {
+         printf("The tables with %d ranges could not be synthesized.\n", rows);
+         goto quit;
+      }
+   }
+
+   else if ((src = openDB(bstname)) == NULL
+         || (sets4 = getDBSection(src, "v4", sizeof(IP4Set), &n4)) == NULL
+         || (sets6 = getDBSection(src, "v6", sizeof(IP6Set), &n6)) == NULL)
+   {
+      printf("The tables could not be loaded from the database file %s.\n", bstname);
+      goto quit;
+   }
+
+   if (replay && !readReplay(replay, &rp, n))
+   {
+      printf("The addresses could not be read from the file %s.\n", replay);
+      goto quit;
+   }
+
+   if ((fd = mkstemp(temp)) < 0)
+      goto quit;
+   close(fd);
+
+   if ((out = createDB(temp)) == NULL)
+      goto quit;
+
+   if (!storeIP4Tables(out, sets4, n4) || !storeIP6Tables(out, sets6, n6))
+   {
+      abortDB(out);
+      unlink(temp);
+      goto quit;
+   }
+
+   rc = !commitDB(out) || (db = openDB(temp)) == NULL;
+   unlink(temp);
+   if (rc)
+   {
+      printf("The temporary database file %s could not be created.\n", temp);
+      goto quit;
+   }
+
+   IP4Tables t4 = {};
+   IP6Tables t6 = {};
+   int       o;
+
+   if ((t4.sets = getDBSection(db, "v4", sizeof(IP4Set), &t4.count)) == NULL || !openIP4Pack(db, "v4p", &t4.pack)
+    || (t4.keys = getDBSection(db, "v4k", sizeof(uint32_t), &t4.starts)) == NULL
+    || (t4.vals = getDBSection(db, "v4v", sizeof(uint32_t), &o)) == NULL || o != t4.starts
+    || (t6.sets = getDBSection(db, "v6", sizeof(IP6Set), &t6.count)) == NULL || !openIP6Pack(db, "v6p", &t6.pack)
+    || (t6.keys = getDBSection(db, "v6k", sizeof(uint128t), &t6.starts)) == NULL
+    || (t6.vals = getDBSection(db, "v6v", sizeof(uint32_t), &o)) == NULL || o != t6.starts)
+   {
+      rc = 1;
+      goto quit;
+   }
+
+   uint32_t *ref = allocate(n*sizeof(uint32_t), default_align, false);
+   uint32_t *lat = allocate(n*sizeof(uint32_t), default_align, false);
+   uint32_t *ip4 = allocate(n*sizeof(uint32_t), default_align, false);
+   uint128t *ip6 = allocate(n*sizeof(uint128t), default_align, false);
+   Zipf      z;
+
+   if (!ref || !lat || !ip4 || !ip6)
+      rc = 1;
+
+   else
+   {
+      calibrateTicks();
+
+      if (!only6Flag && t4.count)
+      {
+         printHeader("IPv4", t4.count, n);
+
+         for (int i = 0; i < n; i++)
+            ip4[i] = (uint32_t)rnd64();
+         benchIP4("uniform", ip4, n, &t4, ref, lat);
+
+         if (createZipf(&z, t4.count, zexp))
+         {
+            for (int i = 0; i < n; i++)
+               ip4[i] = rangeIP4(&t4.sets[zipfRow(&z)]);
+            benchIP4("zipf", ip4, n, &t4, ref, lat);
+         }
+         releaseZipf(&z);
+
+         if (rp.n4)
+            benchIP4("replay", rp.ip4, rp.n4, &t4, ref, lat);
+      }
+
+      if (!only4Flag && t6.count)
+      {
+         printHeader("IPv6", t6.count, n);
+
+         // uniform within the span of the upper 64 bits of the table
+         uint64_t first = ((IP6Desc){.number = t6.sets[0].lo}).quad[b2_1],
+                  last  = ((IP6Desc){.number = t6.sets[t6.count-1].hi}).quad[b2_1];
+         for (int i = 0; i < n; i++)
+            ip6[i] = (IP6Desc){.quad[b2_1] = first + rnd64()%(last - first + 1), .quad[b2_0] = rnd64()}.number;
+         benchIP6("uniform", ip6, n, &t6, ref, lat);
+
+         if (createZipf(&z, t6.count, zexp))
+         {
+            for (int i = 0; i < n; i++)
+               ip6[i] = rangeIP6(&t6.sets[zipfRow(&z)]);
+            benchIP6("zipf", ip6, n, &t6, ref, lat);
+         }
+         releaseZipf(&z);
+
+         if (rp.n6)
+            benchIP6("replay", rp.ip6, rp.n6, &t6, ref, lat);
+      }
+
+      printf("\n");
+      rc = 0;
+   }
+
+   deallocate_batch(false, VPR(ref), VPR(lat), VPR(ip4), VPR(ip6), NULL);
+
+quit:
+   if (rows)
+      deallocate_batch(false, VPR(sets4), VPR(sets6), NULL);
+   deallocate_batch(false, VPR(rp.ip4), VPR(rp.ip6), NULL);
+   closeDB(&db);
+   closeDB(&src);
+   return rc;
+}
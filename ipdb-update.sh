@@ -141,9 +141,9 @@ else
    exit 1
 fi
 
-/usr/local/bin/ipdb "$IPRanges/ipcc.bst" \
-                    "$IPRanges/afrinic.dat" \
-                    "$IPRanges/apnic.dat" \
-                    "$IPRanges/arin.dat" \
-                    "$IPRanges/lacnic.dat" \
-                    "$IPRanges/ripencc.dat"
+/usr/local/bin/ipdb -i -x -c "$IPRanges/ipcc.bst" \
+                          "$IPRanges/afrinic.dat" \
+                          "$IPRanges/apnic.dat" \
+                          "$IPRanges/arin.dat" \
+                          "$IPRanges/lacnic.dat" \
+                          "$IPRanges/ripencc.dat"
@@ -37,20 +37,238 @@
 #include <math.h>
 #include <syslog.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <glob.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 
 #include "utils.h"
 #include "uint128t.h"
 #include "store.h"
 
 
-IP4Node *IP4Store = NULL;
-IP6Node *IP6Store = NULL;
-IP4Node *NS4Store = NULL;
-IP6Node *NS6Store = NULL;
+IP4Index IP4Store = {};
+IP6Index IP6Store = {};
+IP4Index NS4Store = {};
+IP6Index NS6Store = {};
 
-boolean readRIRStatisticsFormat_v2(FILE *in, size_t totalsize, int *ip_count, int *ns_count)
+NSODict *Owners   = NULL;       // the owners of the net segments of the .s4 and .s6 tables
+boolean  Packed   = false;      // write block compressed copies of the tables as well
+boolean  Starts   = false;      // write the range start tables as well
+boolean  Inverted = false;      // write the posting lists of the country codes and owners as well
+boolean  Joined   = false;      // write the joined tables of the country codes and owners as well
+boolean  Summed   = false;      // write the summaries of the country codes and owners as well
+boolean  Statistics = false;    // report the coverage and the structure of the tables
+boolean  Profile  = false;      // report the timers and counters of the build phases
+
+
+void usage(const char *executable)
+{
+   const char *r = executable + strvlen(executable);
+   while (--r >= executable && *r != '/');
+   r++;
+   printf("%s v1.2b (" SCMREV "), Copyright © 2016-2018 Dr. Rolf Jansen\n\n", r);
+   printf("Usage: %s [-i] [-z] [-k] [-x] [-j] [-c] [-s] [-p] [-h] <outnamebase> <datafile1> <datafile2> ...\n\n", r);
+   printf("   -i   Incremental update: diff the data files against the delegation snapshots of the previous build\n");
+   printf("        and patch only the affected ranges into the existing database. A changeset is written to <outnamebase>.chg.\n");
+   printf("        Falls back to a full build if the previous tables or snapshots are not available.\n");
+   printf("   -z   Write block compressed copies of the tables in addition, which are used for the lookups.\n");
+   printf("   -k   Write tables of the range starts in addition, which are used for the lookups.\n");
+   printf("   -x   Write the row numbers of each country code and owner in addition, which ipup uses for gathering\n");
+   printf("        the ranges of the selected countries and owners without a scan over the whole tables.\n");
+   printf("   -j   Write joined tables of the country codes and owners in addition, in which one lookup finds both.\n");
+   printf("   -c   Write the number of rows, address/masklen pairs and addresses of each country code and owner in addition,\n");
+   printf("        which ipup -c reports without generating the tables.\n");
+   printf("   -s | --stats\n");
+   printf("        Report the address space coverage per registry and per country, the number of merged rows, the histogram\n");
+   printf("        of the range lengths, and the rows, bytes and search steps of each section of the database file.\n");
+   printf("   -p | --profile\n");
+   printf("        Report the wall clock and CPU time, the number of records, the number of allocations, the allocated\n");
+   printf("        memory and the peak resident set size of each phase of the build.\n");
+   printf("   -h   Show these usage instructions.\n\n");
+}
+
+
+#pragma mark ••• Build Profile •••
+
+// The phases are recorded by beginPhase()/endPhase() in main(). The address conversions are timed
+// one by one within the parse phase, and so, the profile mode is slower by the overhead of the clock.
+
+typedef struct
+{
+   const char *name;
+   double      wall, cpu;        // seconds
+   long        records;
+   ssize_t     allocs, bytes;    // number of allocations, peak of the allocated bytes
+   long        rss;              // peak resident set size in kB
+} Phase;
+
+static Phase   Phases[8];
+static int     PhaseCount;
+static Phase   PhaseStart;
+static double  ConvTime  = 0.0;  // time spent in inet_pton() and strtoul() while parsing
+static long    ConvCount = 0;
+
+static inline double clockTime(clockid_t clock)
+{
+   struct timespec t;
+   clock_gettime(clock, &t);
+   return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+static void beginPhase(void)
+{
+   if (Profile)
+   {
+      PhaseStart.wall   = clockTime(CLOCK_MONOTONIC);
+      PhaseStart.cpu    = clockTime(CLOCK_PROCESS_CPUTIME_ID);
+      PhaseStart.allocs = gAllocationCount;
+      gAllocationPeak   = gAllocationTotal;
+   }
+}
+
+static void endPhase(const char *name, long records)
+{
+   if (Profile && PhaseCount < sizeof(Phases)/sizeof(Phase))
+   {
+      struct rusage ru;
+      getrusage(RUSAGE_SELF, &ru);
+   #if defined __APPLE__
+      ru.ru_maxrss /= 1024;            // bytes on macOS, kilobytes elsewhere
+   #endif
+
+      Phases[PhaseCount++] = (Phase){name, clockTime(CLOCK_MONOTONIC) - PhaseStart.wall, clockTime(CLOCK_PROCESS_CPUTIME_ID) - PhaseStart.cpu,
+                                     records, gAllocationCount - PhaseStart.allocs, gAllocationPeak, (long)ru.ru_maxrss};
+   }
+}
+
+static void printProfile(void)
+{
+   printf("\n%-12s %10s %10s %10s %12s %14s %12s\n", "phase", "wall s", "cpu s", "records", "allocations", "peak alloc kB", "peak RSS kB");
+   for (int i = 0; i < PhaseCount; i++)
+   {
+      Phase *p = &Phases[i];
+      printf("%-12s %10.3f %10.3f %10ld %12zd %14zd %12ld\n", p->name, p->wall, p->cpu, p->records, p->allocs, p->bytes/1024, p->rss);
+      if (i == 0 && ConvCount)
+         printf(" conversions %10.3f %10s %10ld\n", ConvTime, "-", ConvCount);
+   }
+}
+
+static inline uint32_t convIP4(char *ip)
+{
+   if (!Profile)
+      return ipv4_str2bin(ip);
+
+   double   t = clockTime(CLOCK_MONOTONIC);
+   uint32_t ipst = ipv4_str2bin(ip);
+   ConvTime += clockTime(CLOCK_MONOTONIC) - t, ConvCount++;
+   return ipst;
+}
+
+static inline uint128t convIP6(char *ip)
+{
+   if (!Profile)
+      return ipv6_str2bin(ip);
+
+   double   t = clockTime(CLOCK_MONOTONIC);
+   uint128t ipst = ipv6_str2bin(ip);
+   ConvTime += clockTime(CLOCK_MONOTONIC) - t, ConvCount++;
+   return ipst;
+}
+
+
+#pragma mark ••• Delegation Records •••
+
+// One record per ipv4/ipv6 line of an RIR delegation statistics file. The records of each registry
+// are kept sorted and stored as snapshots (<outnamebase>.<registry>.d4/.d6) next to the tables, so
+// that the following build can find out which delegations did actually change.
+
+typedef struct
+{
+   uint32_t lo, hi;
+   uint32_t cc;
+   char nso[36];
+} IP4Deleg;
+
+typedef struct
+{
+   uint128t lo, hi;
+   uint32_t cc;
+   char nso[36];
+} IP6Deleg;
+
+typedef struct
+{
+   char      reg[8];
+   IP4Deleg *d4;
+   IP6Deleg *d6;
+   int       n4, c4;
+   int       n6, c6;
+} Registry;
+
+
+static IP4Deleg *newIP4Deleg(Registry *r)
+{
+   if (r->n4 == r->c4)
+   {
+      r->c4 = (r->c4) ? 2*r->c4 : 4096;
+      if ((r->d4 = reallocate(r->d4, r->c4*(ssize_t)sizeof(IP4Deleg), false, true)) == NULL)
+      {
+         r->n4 = r->c4 = 0;
+         return NULL;
+      }
+   }
+
+   return memset(&r->d4[r->n4++], 0, sizeof(IP4Deleg));
+}
+
+static IP6Deleg *newIP6Deleg(Registry *r)
+{
+   if (r->n6 == r->c6)
+   {
+      r->c6 = (r->c6) ? 2*r->c6 : 4096;
+      if ((r->d6 = reallocate(r->d6, r->c6*(ssize_t)sizeof(IP6Deleg), false, true)) == NULL)
+      {
+         r->n6 = r->c6 = 0;
+         return NULL;
+      }
+   }
+
+   return memset(&r->d6[r->n6++], 0, sizeof(IP6Deleg));
+}
+
+
+static int cmpIP4Deleg(const void *a, const void *b)
+{
+   const IP4Deleg *p = a, *q = b;
+
+   if (p->lo != q->lo)
+      return (p->lo < q->lo) ? -1 : 1;
+   else if (p->hi != q->hi)
+      return (p->hi < q->hi) ? -1 : 1;
+   else if (p->cc != q->cc)
+      return (p->cc < q->cc) ? -1 : 1;
+   else
+      return strcmp(p->nso, q->nso);
+}
+
+static int cmpIP6Deleg(const void *a, const void *b)
+{
+   const IP6Deleg *p = a, *q = b;
+
+   if (!eq_u128(p->lo, q->lo))
+      return (lt_u128(p->lo, q->lo)) ? -1 : 1;
+   else if (!eq_u128(p->hi, q->hi))
+      return (lt_u128(p->hi, q->hi)) ? -1 : 1;
+   else if (p->cc != q->cc)
+      return (p->cc < q->cc) ? -1 : 1;
+   else
+      return strcmp(p->nso, q->nso);
+}
+
+
+boolean readRIRStatisticsFormat_v2(FILE *in, size_t totalsize, Registry *r)
 {
    boolean rc = false;
 
@@ -60,7 +278,6 @@ boolean readRIRStatisticsFormat_v2(FILE *in, size_t totalsize, int *ip_count, in
 
    char *data = allocate(chunksize+1, default_align, false);
    char  ver[4] = {};
-   char  reg[8] = {};
 
    while (totalread < totalsize && (bytesread = fread(data+offset, 1, chunksize-offset, in)) > 0)
    {
@@ -68,14 +285,20 @@ boolean readRIRStatisticsFormat_v2(FILE *in, size_t totalsize, int *ip_count, in
       bytesread += offset;
       data[bytesread] = '\0';
 
-      int   vl = 0, rl = 0, fl, ll;
+      int   vl = 0, rl, fl, nf;
       char *line = data;
-      char *nextline, *cc, *cnt, *pfx, *ns, *iv, *ip;
+      char *nextline, *eol, *fld[8], *cc, *cnt, *pfx, *ns, *iv, *ip;
+
+      FieldIndex fi;
+      indexFields(&fi, data, '|', '\n');
 
       while (line < data + bytesread)
       {
-         ll = linelen(line);
-         nextline = line + ll;
+         // collect the field delimiters of the line, each record has 8 fields
+         for (nf = 0; (eol = nextDelim(&fi)) && *eol == '|'; nf++)
+            if (nf < 8)
+               fld[nf] = eol;
+         nextline = (eol) ?: fi.next;
 
          if (nextline[0] != '\0' && nextline[1] != '\0')
             *nextline++ = '\0';
@@ -89,126 +312,71 @@ boolean readRIRStatisticsFormat_v2(FILE *in, size_t totalsize, int *ip_count, in
          {
             if (!vl)                            // has the data format version been read?
             {
-               if (*line != '2')
+               if (*line != '2' || nf < 2)
                   goto quit;                    // only version 2[.x] is supported
 
-               vl = fieldlen(line);
-               strmlcpy(ver, line, 4, &vl);
-               line += vl+1;
+               vl = (int)(fld[0] - line);
+               snprintf(ver, sizeof(ver), "%.*s", vl, line);
 
-               rl = fieldlen(line);
-               strmlcpy(reg, line, 8, &rl);
-               rl++;
+               rl = (int)(fld[1] - fld[0] - 1);
+               strmlcpy(r->reg, fld[0]+1, 8, &rl);
             }
 
-            else if (*(cc = line+rl) != '*')    // skip the summary lines
+            else if (nf >= 7 && *(cc = fld[0]+1) != '*')    // skip the summary lines
             {
-               fl = fieldlen(cc);
-               iv = cc+fl+1;                    // the ip version
+               fl = (int)(fld[1] - cc);
+               iv = fld[1]+1;                   // the ip version
+               ip = fld[2]+1;
+               ns = fld[6]+1;                   // unique identifier of the net segment owner, f.ex.: 5a5f320b-aefc-4f38-8b03-dff796ea678d
+               if (nf > 7)
+                  *fld[7] = '\0';
+
                if (fl)
                   if (cmp4(iv, "ipv4"))
                   {
-                     IP4Node *node;
-                     uint32_t ipst, ipct, iplo, iphi;
+                     IP4Deleg *d;
+                     uint32_t  ipst, ipct;
 
                      uppercase(cc, fl);
                      cc[fl] = '\0';
                      if (*cc)
                      {
-                        ip = iv+fieldlen(iv)+1;
-                        fl = fieldlen(ip);
-                        ip[fl] = '\0';
-                        cnt = ip+fl+1;
-                        if ((ipst = ipv4_str2bin(ip))
+                        *fld[3] = '\0';
+                        cnt = fld[3]+1;
+                        if ((ipst = convIP4(ip))
                          && (ipct = (uint32_t)strtoul(cnt, NULL, 10)))
                         {
-                           iplo = ipst, iphi = iplo + ipct - 1;
-
-                           if (!cmp2(cc, "EU"))
-                              while (node = findNet4Node(iplo, iphi, *(uint16_t*)cc, NULL, IP4Store))
-                              {
-                                 if (node->lo < iplo)
-                                    iplo = node->lo;
-
-                                 if (node->hi > iphi)
-                                    iphi = node->hi;
-
-                                 removeIP4Node(node->lo, &IP4Store); (*ip_count)--;
-                              }
-
-                           addIP4Node(iplo, iphi, *(uint16_t*)cc, NULL, &IP4Store); (*ip_count)++;
+                           if ((d = newIP4Deleg(r)) == NULL)
+                              goto quit;
 
-                           ns = cnt + fieldlen(cnt) + 1; // timestamp, f.ex.: 20120605
-                           ns += fieldlen(ns) + 1;       // status: assigned, allocated, available, reserved
-                           ns += fieldlen(ns) + 1;       // unique identifier of the ASN owner, f.ex.: 5a5f320b-aefc-4f38-8b03-dff796ea678d
-                           ns[fieldlen(ns)] = '\0';
-                           iplo = ipst, iphi = iplo + ipct - 1;
-                           while (node = findNet4Node(iplo, iphi, 0, ns, NS4Store))
-                           {
-                              if (node->lo < iplo)
-                                 iplo = node->lo;
-
-                              if (node->hi > iphi)
-                                 iphi = node->hi;
-
-                              removeIP4Node(node->lo, &NS4Store); (*ns_count)--;
-                           }
-
-                           addIP4Node(iplo, iphi, 0, ns, &NS4Store); (*ns_count)++;
+                           d->lo = ipst, d->hi = ipst + ipct - 1;
+                           d->cc = cc16(cc);
+                           nsocpy(d->nso, ns);
                         }
                      }
                   }
 
                   else if (cmp4(iv, "ipv6"))
                   {
-                     IP6Node *node;
-                     int32_t  ipfx;
-                     uint128t ipst, iplo, iphi;
+                     IP6Deleg *d;
+                     int32_t   ipfx;
+                     uint128t  ipst;
 
                      uppercase(cc, fl);
                      cc[fl] = '\0';
                      if (*cc)
                      {
-                        ip = iv+fieldlen(iv)+1;
-                        fl = fieldlen(ip);
-                        ip[fl] = '\0';
-                        pfx = ip+fl+1;
-                        if (gt_u128(ipst = ipv6_str2bin(ip), u64_to_u128t(0))
+                        *fld[3] = '\0';
+                        pfx = fld[3]+1;
+                        if (gt_u128(ipst = convIP6(ip), u64_to_u128t(0))
                          && (ipfx = 128 - (int32_t)strtoul(pfx, NULL, 10)) >= 0)
                         {
-                           iplo = ipst, iphi = add_u128(ipst, inteb6_m1(ipfx));
-
-                           if (!cmp2(cc, "EU"))
-                              while (node = findNet6Node(iplo, iphi, *(uint16_t*)cc, NULL, IP6Store))
-                              {
-                                 if (lt_u128(node->lo, iplo))
-                                    iplo = node->lo;
-
-                                 if (gt_u128(node->hi, iphi))
-                                    iphi = node->hi;
-
-                                 removeIP6Node(node->lo, &IP6Store); (*ip_count)--;
-                              }
-
-                           addIP6Node(iplo, iphi, *(uint16_t*)cc, NULL, &IP6Store); (*ip_count)++;
-
-                           ns = pfx + fieldlen(pfx) + 1; // timestamp, f.ex.: 20120605
-                           ns += fieldlen(ns) + 1;       // status: assigned, allocated, available, reserved
-                           ns += fieldlen(ns) + 1;       // unique identifier of the ASN owner, f.ex.: 5a5f320b-aefc-4f38-8b03-dff796ea678d
-                           ns[fieldlen(ns)] = '\0';
-                           iplo = ipst, iphi = add_u128(ipst, inteb6_m1(ipfx));
-                           while (node = findNet6Node(iplo, iphi, 0, ns, NS6Store))
-                           {
-                              if (lt_u128(node->lo, iplo))
-                                 iplo = node->lo;
+                           if ((d = newIP6Deleg(r)) == NULL)
+                              goto quit;
 
-                              if (gt_u128(node->hi, iphi))
-                                 iphi = node->hi;
-
-                              removeIP6Node(node->lo, &NS6Store); (*ns_count)--;
-                           }
-
-                           addIP6Node(iplo, iphi, 0, ns, &NS6Store); (*ns_count)++;
+                           d->lo = ipst, d->hi = add_u128(ipst, inteb6_m1(ipfx));
+                           d->cc = cc16(cc);
+                           nsocpy(d->nso, ns);
                         }
                      }
                   }
@@ -219,7 +387,15 @@ boolean readRIRStatisticsFormat_v2(FILE *in, size_t totalsize, int *ip_count, in
       }
    }
 
-   rc = (*ip_count + *ns_count != 0);
+   // The canonical processing order is the order of the data files and within each file ascending by range,
+   // which the incremental update relies on. Having the records sorted is also the prerequisite for diffing
+   // the snapshots of two subsequent builds in one pass.
+   if (r->n4)
+      qsort(r->d4, r->n4, sizeof(IP4Deleg), cmpIP4Deleg);
+   if (r->n6)
+      qsort(r->d6, r->n6, sizeof(IP6Deleg), cmpIP6Deleg);
+
+   rc = (r->n4 + r->n6 != 0);
 
 quit:
    deallocate(VPR(data), false);
@@ -227,79 +403,1349 @@ quit:
 }
 
 
-int main(int argc, const char *argv[])
+#pragma mark ••• Build Statistics •••
+
+// With -s, the coverage of the address spaces per country and the histograms of the range lengths are tallied from the rows
+// of the tables while these are serialized, and reported after the build together with the coverage per registry, the number
+// of merges and the sizes of the sections with the number of search steps, for sizing caches and choosing lookup engines.
+
+enum {v4Tab, s4Tab, v6Tab, s6Tab};
+
+typedef struct
+{
+   uint64_t  cc4[ccTableSize + 1];     // covered IPv4 addresses per country code, the last one for any improper code
+   double    cc6[ccTableSize + 1];     // covered IPv6 /64 networks per country code
+   long      hist[4][129];             // rows per table by floor(log2(length))
+   long      merges[4];                // rows of the tables which were merged with overlapping or adjoining delegations
+   int       nsect;
+   DBSection sect[DB_MAX_SECTIONS];    // the directory of the written database file
+} BuildStats;
+
+static BuildStats Stats;
+
+// The IPv6 ranges are measured in /64 networks.
+static inline double nets6(uint128t lo, uint128t hi)
+{
+   IP6Desc d = {.number = sub_u128(hi, lo)};
+   return (double)d.quad[b2_1] + ((double)d.quad[b2_0] + 1.0)/18446744073709551616.0;
+}
+
+// The tally of a table keeps the last row pending, until the following one tells, whether it is cut off.
+typedef struct
+{
+   int     tab;
+   boolean pending;
+   IP4Set  last;
+} IP4Tally;
+
+typedef struct
+{
+   int     tab;
+   boolean pending;
+   IP6Set  last;
+} IP6Tally;
+
+static void tallyIP4Row(IP4Tally *t, IP4Set *set)
 {
-   if (argc >= 3)
+   uint64_t len;
+
+   if (t->pending && t->tab == v4Tab && (!set || set->lo > t->last.lo))
+      Stats.cc4[ccKey(t->last.cc)] += (uint64_t)((set && set->lo <= t->last.hi) ? set->lo - 1 : t->last.hi) - t->last.lo + 1;
+
+   if (t->pending = (set != NULL))
    {
-      int   namelen = strvlen(argv[1]);
-      char *outIP4Name = strcpy(alloca(OSP(namelen+4)), argv[1]); cpy4(outIP4Name+namelen, ".v4");
-      char *outIP6Name = strcpy(alloca(OSP(namelen+4)), argv[1]); cpy4(outIP6Name+namelen, ".v6");
-      char *outNS4Name = strcpy(alloca(OSP(namelen+4)), argv[1]); cpy4(outNS4Name+namelen, ".s4");
-      char *outNS6Name = strcpy(alloca(OSP(namelen+4)), argv[1]); cpy4(outNS6Name+namelen, ".s6");
-      FILE *outIP4, *outIP6, *outNS4, *outNS6;
+      t->last = *set;
+      len = (uint64_t)set->hi - set->lo + 1;
+      Stats.hist[t->tab][63 - __builtin_clzll(len)]++;
+   }
+}
 
-      if (outIP4 = fopen(outIP4Name, "w"))
-         if (outIP6 = fopen(outIP6Name, "w"))
-            if (outNS4 = fopen(outNS4Name, "w"))
-               if (outNS6 = fopen(outNS6Name, "w"))
-               {
-                  int ip_count, ns_count, ip_total = 0, ns_total = 0;
+static void tallyIP6Row(IP6Tally *t, IP6Set *set)
+{
+   IP6Desc len;
 
-                  FILE  *in;
-                  struct stat st;
+   if (t->pending && t->tab == v6Tab && (!set || gt_u128(set->lo, t->last.lo)))
+      Stats.cc6[ccKey(t->last.cc)] += nets6(t->last.lo, (set && le_u128(set->lo, t->last.hi)) ? sub_u128(set->lo, u64_to_u128t(1)) : t->last.hi);
 
-                  printf("ipdb v1.2b (" SCMREV "), Copyright © 2016-2018 Dr. Rolf Jansen\nProcessing RIR data files ...\n\n");
-                  for (int inc = 2; inc < argc; inc++)
-                  {
-                     if (stat(argv[inc], &st) == no_error && st.st_size && (in = fopen(argv[inc], "r")))
-                     {
-                        const char *file = strrchr(argv[inc], '/');
-                        if (file)
-                           file++;
-                        else
-                           file = argv[inc];
-                        printf(" %s ", file);
-                        fflush(stdout);
-
-                        ip_count = ns_count = 0;
-                        if (readRIRStatisticsFormat_v2(in, (size_t)st.st_size, &ip_count, &ns_count))
-                           ip_total += ip_count, ns_total += ns_count;
-
-                        fclose(in);
-                     }
+   if (t->pending = (set != NULL))
+   {
+      t->last = *set;
+      len.number = add_u128(sub_u128(set->hi, set->lo), u64_to_u128t(1));
+      Stats.hist[t->tab][(len.quad[b2_1]) ? 127 - __builtin_clzll(len.quad[b2_1]) : (len.quad[b2_0]) ? 63 - __builtin_clzll(len.quad[b2_0]) : 128]++;
+   }
+}
 
-                     else
-                     {
-                        fclose(outNS6), fclose(outNS4), fclose(outIP6), fclose(outIP4);
-                        printf("\n");
-                        return 1;
-                     }
-                  }
+// Tallies the rows of a table in order, and the last one with set == NULL. Returns true for use in the copy chains.
+static boolean tallyIP4Rows(IP4Tally *t, IP4Set sets[], int n)
+{
+   if (!sets)
+      tallyIP4Row(t, NULL);
+   for (int i = 0; i < n; i++)
+      tallyIP4Row(t, &sets[i]);
+   return true;
+}
 
-                  serializeIP4Tree(outIP4, IP4Store);
-                  releaseIP4Tree(IP4Store);
+static boolean tallyIP6Rows(IP6Tally *t, IP6Set sets[], int n)
+{
+   if (!sets)
+      tallyIP6Row(t, NULL);
+   for (int i = 0; i < n; i++)
+      tallyIP6Row(t, &sets[i]);
+   return true;
+}
 
-                  serializeIP6Tree(outIP6, IP6Store);
-                  releaseIP6Tree(IP6Store);
+// Tally the rows of a table, which is copied from the old database file.
+static void tallyIP4Table(const char *tab, IP4Set sets[], int n)
+{
+   IP4Tally tally = {.tab = (*tab == 's') ? s4Tab : v4Tab};
 
-                  serializeIP4Tree(outNS4, NS4Store);
-                  releaseIP4Tree(NS4Store);
+   if (Statistics)
+      tallyIP4Rows(&tally, sets, n), tallyIP4Rows(&tally, NULL, 0);
+}
 
-                  serializeIP6Tree(outNS6, NS6Store);
-                  releaseIP6Tree(NS6Store);
+static void tallyIP6Table(const char *tab, IP6Set sets[], int n)
+{
+   IP6Tally tally = {.tab = (*tab == 's') ? s6Tab : v6Tab};
 
-                  fclose(outNS6), fclose(outNS4), fclose(outIP6), fclose(outIP4);
+   if (Statistics)
+      tallyIP6Rows(&tally, sets, n), tallyIP6Rows(&tally, NULL, 0);
+}
 
-                  printf("\n\nTotal number of processed IP-Ranges = %d\nTotal number of processed Segments  = %d\n", ip_total, ns_total);
-                  return 0;
-               }
-               else
-                  fclose(outNS4), fclose(outIP6), fclose(outIP4);
+static void recordSections(DBSection sect[], int count)
+{
+   Stats.nsect = count;
+   memcpy(Stats.sect, sect, count*sizeof(DBSection));
+}
+
+static void printStatistics(Registry regs[], int nreg)
+{
+   int      i, k;
+   uint64_t a4;
+   double   a6;
+   uint32_t cc = 0;
+   uint8_t *ca = (uint8_t *)&cc;
+
+   printf("\nMerged rows: v4 %ld, s4 %ld, v6 %ld, s6 %ld\n", Stats.merges[v4Tab], Stats.merges[s4Tab], Stats.merges[v6Tab], Stats.merges[s6Tab]);
+
+   printf("\n%-12s %14s %9s %22s %9s\n", "registry", "IPv4 addr", "% IPv4", "IPv6 /64 nets", "% IPv6");
+   for (k = 0; k < nreg; k++)
+   {
+      for (a4 = 0, i = 0; i < regs[k].n4; i++)
+         a4 += (uint64_t)regs[k].d4[i].hi - regs[k].d4[i].lo + 1;
+      for (a6 = 0.0, i = 0; i < regs[k].n6; i++)
+         a6 += nets6(regs[k].d6[i].lo, regs[k].d6[i].hi);
+      printf("%-12s %14llu %9.4f %22.0f %9.6f\n", regs[k].reg, (unsigned long long)a4, a4*100.0/4294967296.0, a6, a6*100.0/18446744073709551616.0);
+   }
+
+   printf("\n%-12s %14s %9s %22s %9s\n", "country", "IPv4 addr", "% IPv4", "IPv6 /64 nets", "% IPv6");
+   for (ca[b2_0] = 'A'; ca[b2_0] <= 'Z'; ca[b2_0]++)
+      for (ca[b2_1] = 'A'; ca[b2_1] <= 'Z'; ca[b2_1]++)
+         if (Stats.cc4[k = (int)ccKey(cc)] || Stats.cc6[k])
+            printf("%-12s %14llu %9.4f %22.0f %9.6f\n", (char *)&cc, (unsigned long long)Stats.cc4[k], Stats.cc4[k]*100.0/4294967296.0, Stats.cc6[k], Stats.cc6[k]*100.0/18446744073709551616.0);
+   if (Stats.cc4[ccTableSize] || Stats.cc6[ccTableSize])
+      printf("%-12s %14llu %9.4f %22.0f %9.6f\n", "other", (unsigned long long)Stats.cc4[ccTableSize], Stats.cc4[ccTableSize]*100.0/4294967296.0, Stats.cc6[ccTableSize], Stats.cc6[ccTableSize]*100.0/18446744073709551616.0);
+
+   printf("\nRange lengths 2^k <= length < 2^(k+1), rows per table\n%5s %9s %9s %9s %9s\n", "k", "v4", "s4", "v6", "s6");
+   for (k = 0; k <= 128; k++)
+      if (Stats.hist[v4Tab][k] || Stats.hist[s4Tab][k] || Stats.hist[v6Tab][k] || Stats.hist[s6Tab][k])
+         printf("%5d %9ld %9ld %9ld %9ld\n", k, Stats.hist[v4Tab][k], Stats.hist[s4Tab][k], Stats.hist[v6Tab][k], Stats.hist[s6Tab][k]);
+
+   // the row tables are searched by bisection, the key tables of the range starts by bisection down to a window of keys
+   printf("\n%-8s %10s %12s %14s\n", "section", "rows", "bytes", "search steps");
+   for (k = 0; k < Stats.nsect; k++)
+   {
+      DBSection *s = &Stats.sect[k];
+      long       rows = (long)(s->size/s->rowsize), steps = -1;
+      int        nl = strvlen(s->name),
+                 w  = (s->rowsize == sizeof(uint32_t)) ? PRED_WINDOW : PRED_WINDOW/2;
+
+      if (nl == 2)
+         for (steps = 0; (1L << steps) <= rows; steps++);
+      else if (s->name[nl-1] == 'k')
+         for (steps = 1; ((long)w << (steps - 1)) < rows; steps++);
+
+      if (s->rowsize == 1)
+         printf("%-8s %10s %12llu %14s\n", s->name, "-", (unsigned long long)s->size, "-");
+      else if (steps < 0)
+         printf("%-8s %10ld %12llu %14s\n", s->name, rows, (unsigned long long)s->size, "-");
+      else
+         printf("%-8s %10ld %12llu %14ld\n", s->name, rows, (unsigned long long)s->size, steps);
+   }
+}
+
+
+#pragma mark ••• Consolidation of Delegations into the Range Stores •••
+
+static void mergeIP4Deleg(IP4Deleg *d, IP4Index *ipStore, IP4Index *nsStore, int *ip_count, int *ns_count)
+{
+   IP4Set  *node;
+   uint32_t iplo = d->lo, iphi = d->hi;
+   uint32_t id   = internNSO(Owners, d->nso);
+
+   if (!cmp2(&d->cc, "EU"))
+      while (node = findNet4Range(iplo, iphi, d->cc, 0, ipStore))
+      {
+         if (node->lo < iplo)
+            iplo = node->lo;
+
+         if (node->hi > iphi)
+            iphi = node->hi;
+
+         removeIP4Range(node, ipStore); (*ip_count)--; Stats.merges[v4Tab]++;
+      }
+
+   addIP4Range(iplo, iphi, d->cc, 0, ipStore); (*ip_count)++;
+
+   iplo = d->lo, iphi = d->hi;
+   while (node = findNet4Range(iplo, iphi, 0, id, nsStore))
+   {
+      if (node->lo < iplo)
+         iplo = node->lo;
+
+      if (node->hi > iphi)
+         iphi = node->hi;
+
+      removeIP4Range(node, nsStore); (*ns_count)--; Stats.merges[s4Tab]++;
+   }
+
+   addIP4Range(iplo, iphi, 0, id, nsStore); (*ns_count)++;
+}
+
+static void mergeIP6Deleg(IP6Deleg *d, IP6Index *ipStore, IP6Index *nsStore, int *ip_count, int *ns_count)
+{
+   IP6Set  *node;
+   uint128t iplo = d->lo, iphi = d->hi;
+   uint32_t id   = internNSO(Owners, d->nso);
+
+   if (!cmp2(&d->cc, "EU"))
+      while (node = findNet6Range(iplo, iphi, d->cc, 0, ipStore))
+      {
+         if (lt_u128(node->lo, iplo))
+            iplo = node->lo;
+
+         if (gt_u128(node->hi, iphi))
+            iphi = node->hi;
+
+         removeIP6Range(node, ipStore); (*ip_count)--; Stats.merges[v6Tab]++;
+      }
+
+   addIP6Range(iplo, iphi, d->cc, 0, ipStore); (*ip_count)++;
+
+   iplo = d->lo, iphi = d->hi;
+   while (node = findNet6Range(iplo, iphi, 0, id, nsStore))
+   {
+      if (lt_u128(node->lo, iplo))
+         iplo = node->lo;
+
+      if (gt_u128(node->hi, iphi))
+         iphi = node->hi;
+
+      removeIP6Range(node, nsStore); (*ns_count)--; Stats.merges[s6Tab]++;
+   }
+
+   addIP6Range(iplo, iphi, 0, id, nsStore); (*ns_count)++;
+}
+
+
+#pragma mark ••• Delegation Snapshots •••
+
+static char *snapshotName(const char *base, const char *reg, const char *ext)
+{
+   int   bl = strvlen(base), rl = strvlen(reg);
+   char *name = allocate(bl + 1 + rl + 4, default_align, false);
+   if (name)
+   {
+      memvcpy(name, base, bl);
+      name[bl] = '.';
+      memvcpy(name+bl+1, reg, rl);
+      cpy4(name+bl+1+rl, ext);
+   }
+   return name;
+}
+
+static void *loadFile(const char *name, size_t *size)
+{
+   void  *data = NULL;
+   FILE  *in;
+   struct stat st;
+
+   *size = 0;
+   if (stat(name, &st) == no_error && (in = fopen(name, "r")))
+   {
+      if (data = allocate((ssize_t)st.st_size, default_align, false))
+         if (st.st_size == 0 || fread(data, (size_t)st.st_size, 1, in))
+            *size = (size_t)st.st_size;
          else
-            fclose(outIP6), fclose(outIP4);
+            deallocate(VPR(data), false);
+      fclose(in);
+   }
+
+   return data;
+}
+
+static boolean storeFile(const char *name, const void *data, size_t size)
+{
+   boolean rc = false;
+   FILE   *out;
+
+   if (out = fopen(name, "w"))
+   {
+      rc = (size == 0 || fwrite(data, size, 1, out) == 1);
+      rc = (fclose(out) == no_error) && rc;
+   }
+
+   return rc;
+}
+
+static boolean storeSnapshots(const char *base, Registry *r)
+{
+   boolean rc  = false;
+   char   *d4n = snapshotName(base, r->reg, ".d4");
+   char   *d6n = snapshotName(base, r->reg, ".d6");
+
+   if (d4n && d6n)
+      rc = storeFile(d4n, r->d4, r->n4*sizeof(IP4Deleg))
+        && storeFile(d6n, r->d6, r->n6*sizeof(IP6Deleg));
+
+   deallocate_batch(false, VPR(d6n), VPR(d4n), NULL);
+   return rc;
+}
+
+static void removeSnapshots(const char *base, Registry *r)
+{
+   char *d4n = snapshotName(base, r->reg, ".d4");
+   char *d6n = snapshotName(base, r->reg, ".d6");
+
+   if (d4n && d6n)
+      unlink(d4n), unlink(d6n);
+
+   deallocate_batch(false, VPR(d6n), VPR(d4n), NULL);
+}
+
+// Append the registries, the snapshots of which were left by an earlier build, but which are missing among the data files of
+// this build, as registries without delegations, so that an incremental update removes their rows, as a full build does.
+// Returns the number of the appended registries.
+static int staleRegistries(const char *base, Registry **regs, int nreg)
+{
+   int      bl = strvlen(base), i, k, n = 0;
+   char    *pattern = snapshotName(base, "*", ".d4");
+   glob_t   snaps = {};
+   Registry *r;
+
+   if (pattern && glob(pattern, 0, NULL, &snaps) == no_error)
+      for (i = 0; i < (int)snaps.gl_pathc; i++)
+      {
+         char reg[8] = {};
+         int  rl = strvlen(snaps.gl_pathv[i]) - bl - 4;
+
+         if (rl > 0 && rl < 8)
+         {
+            memvcpy(reg, snaps.gl_pathv[i]+bl+1, rl);
+            for (k = 0; k < nreg + n && strcmp((*regs)[k].reg, reg); k++);
+
+            if (k == nreg + n && (r = reallocate(*regs, (nreg + n + 1)*(ssize_t)sizeof(Registry), false, false)))
+            {
+               *regs = r;
+               (*regs)[nreg + n++] = (Registry){};
+               strcpy((*regs)[k].reg, reg);
+            }
+         }
+      }
+
+   globfree(&snaps);
+   deallocate(VPR(pattern), false);
+   return n;
+}
+
+
+#pragma mark ••• Incremental Update •••
+
+// The consolidation of a delegation may interact only with delegations and consolidated ranges which
+// overlap or adjoin it. Therefore, all the spans (old table rows, new delegations and changed delegations)
+// are swept in ascending order into maximal connected regions, and only those regions which contain a
+// changed delegation need to be re-consolidated, by replaying the new delegations of the region in the
+// canonical order. The rows outside of the dirty regions are identical to the ones of a full build.
+
+typedef struct
+{
+   uint32_t lo, hi;
+   int      dirty;
+} IP4Span;
+
+typedef struct
+{
+   uint128t lo, hi;
+   int      dirty;
+} IP6Span;
+
+static int cmpIP4Span(const void *a, const void *b)
+{
+   const IP4Span *p = a, *q = b;
+   return (p->lo < q->lo) ? -1 : (p->lo > q->lo) ? 1 : 0;
+}
+
+static int cmpIP6Span(const void *a, const void *b)
+{
+   const IP6Span *p = a, *q = b;
+   return (lt_u128(p->lo, q->lo)) ? -1 : (gt_u128(p->lo, q->lo)) ? 1 : 0;
+}
+
+
+// Append the spans of the records which are only in one of the two sorted lists to the changed list.
+static int diffIP4Delegs(IP4Deleg *old, int n, IP4Deleg *new, int m, IP4Span *changed)
+{
+   int i = 0, j = 0, k = 0, ord;
+
+   while (i < n || j < m)
+   {
+      if (i == n)
+         ord = 1;
+      else if (j == m)
+         ord = -1;
+      else
+         ord = cmpIP4Deleg(&old[i], &new[j]);
+
+      if (ord < 0)
+         changed[k++] = (IP4Span){old[i].lo, old[i].hi, 1}, i++;
+      else if (ord > 0)
+         changed[k++] = (IP4Span){new[j].lo, new[j].hi, 1}, j++;
+      else
+         i++, j++;
+   }
+
+   return k;
+}
+
+static int diffIP6Delegs(IP6Deleg *old, int n, IP6Deleg *new, int m, IP6Span *changed)
+{
+   int i = 0, j = 0, k = 0, ord;
+
+   while (i < n || j < m)
+   {
+      if (i == n)
+         ord = 1;
+      else if (j == m)
+         ord = -1;
+      else
+         ord = cmpIP6Deleg(&old[i], &new[j]);
+
+      if (ord < 0)
+         changed[k++] = (IP6Span){old[i].lo, old[i].hi, 1}, i++;
+      else if (ord > 0)
+         changed[k++] = (IP6Span){new[j].lo, new[j].hi, 1}, j++;
       else
-         fclose(outIP4);
+         i++, j++;
    }
 
-   return 1;
+   return k;
+}
+
+
+// Write the differences between the old and the new rows of a dirty region to the changeset, returns their number.
+static int diffIP4Sets(FILE *chg, const char *tab, IP4Set *old, int n, IP4Set *new, int m)
+{
+   IP4Str lostr, histr;
+   int i = 0, j = 0, d = 0;
+
+   while (i < n || j < m)
+      if (i < n && j < m && old[i].lo == new[j].lo && old[i].hi == new[j].hi && old[i].cc == new[j].cc && old[i].id == new[j].id)
+         i++, j++;
+
+      else if (j == m || i < n && old[i].lo <= new[j].lo)
+      {
+         fprintf(chg, "- %s %s %s %s\n", tab, ipv4_bin2str(old[i].lo, lostr), ipv4_bin2str(old[i].hi, histr), (old[i].cc) ? (char *)&old[i].cc : nsoString(Owners, old[i].id));
+         i++, d++;
+      }
+
+      else
+      {
+         fprintf(chg, "+ %s %s %s %s\n", tab, ipv4_bin2str(new[j].lo, lostr), ipv4_bin2str(new[j].hi, histr), (new[j].cc) ? (char *)&new[j].cc : nsoString(Owners, new[j].id));
+         j++, d++;
+      }
+
+   return d;
+}
+
+static int diffIP6Sets(FILE *chg, const char *tab, IP6Set *old, int n, IP6Set *new, int m)
+{
+   IP6Str lostr, histr;
+   int i = 0, j = 0, d = 0;
+
+   while (i < n || j < m)
+      if (i < n && j < m && eq_u128(old[i].lo, new[j].lo) && eq_u128(old[i].hi, new[j].hi) && old[i].cc == new[j].cc && old[i].id == new[j].id)
+         i++, j++;
+
+      else if (j == m || i < n && le_u128(old[i].lo, new[j].lo))
+      {
+         fprintf(chg, "- %s %s %s %s\n", tab, ipv6_bin2str(old[i].lo, lostr), ipv6_bin2str(old[i].hi, histr), (old[i].cc) ? (char *)&old[i].cc : nsoString(Owners, old[i].id));
+         i++, d++;
+      }
+
+      else
+      {
+         fprintf(chg, "+ %s %s %s %s\n", tab, ipv6_bin2str(new[j].lo, lostr), ipv6_bin2str(new[j].hi, histr), (new[j].cc) ? (char *)&new[j].cc : nsoString(Owners, new[j].id));
+         j++, d++;
+      }
+
+   return d;
+}
+
+
+// The names of the sections of a table and of its optional copies, which are requested by the flags. The joined table
+// is counted to the s table, after which it is written.
+static int tableSections(const char *tab, char names[][8])
+{
+   int n = 0;
+
+   snprintf(names[n++], 8, "%s", tab);
+   if (Packed)
+      snprintf(names[n++], 8, "%sp", tab);
+   if (Starts)
+      snprintf(names[n++], 8, "%sk", tab), snprintf(names[n++], 8, "%sv", tab);
+   if (Inverted)
+      snprintf(names[n++], 8, "%sx", tab);
+   if (Summed)
+      snprintf(names[n++], 8, "%sc", tab);
+   if (Joined && *tab == 's')
+      snprintf(names[n++], 8, "j%c", tab[1]);
+
+   return n;
+}
+
+static boolean reusableSections(DBFile *old, const char *tab)
+{
+   char names[8][8];
+   int  i, n = tableSections(tab, names);
+
+   for (i = 0; i < n; i++)
+      if (!findDBSection(old, names[i]))
+         return false;
+   return true;
+}
+
+// Returns the number of the requested sections of all tables, or 0 if any of these is missing in the old database file.
+static int requestedSections(DBFile *old)
+{
+   char names[8][8];
+
+   return (reusableSections(old, "v4") && reusableSections(old, "s4") && reusableSections(old, "v6") && reusableSections(old, "s6"))
+        ? tableSections("v4", names) + tableSections("s4", names) + tableSections("v6", names) + tableSections("s6", names)
+        : 0;
+}
+
+static boolean copySections(DBWriter *db, DBFile *old, const char *tab)
+{
+   char names[8][8];
+   int  i, n = tableSections(tab, names);
+
+   for (i = 0; i < n; i++)
+      if (!copyDBSection(db, old, names[i]))
+         return false;
+   return true;
+}
+
+
+// The optional copies of a table, which are written right after it: the packed table into the section <tab>p (-z),
+// the range starts into the sections <tab>k and <tab>v (-k), the posting lists into the section <tab>x (-x), and the
+// summaries into the section <tab>c (-c).
+// For the joined tables (-j), the range starts of the v table are kept until the s table is complete, which is always
+// written right after the v table, and then both are swept into the section j4 or j6. The statistics (-s) are tallied
+// from the same rows.
+typedef struct
+{
+   IP4Packer *pack;
+   IP4Starts *starts;
+   Postings  *post;
+   Summaries *sums;
+   IP4Starts *join;
+   IP4Tally   tally;
+} IP4Copies;
+
+static IP4Starts *IP4Join = NULL;
+
+static boolean createIP4Copies(IP4Copies *cp, const char *tab)
+{
+   *cp = (IP4Copies){.tally.tab = (!Statistics) ? -1 : (*tab == 's') ? s4Tab : v4Tab};
+   return (!Packed || (cp->pack = createIP4Packer()))
+       && (!Starts || (cp->starts = createIP4Starts(*tab == 's')))
+       && (!Inverted || (cp->post = createPostings(*tab == 's')))
+       && (!Summed || (cp->sums = createSummaries(*tab == 's')))
+       && (!Joined || (cp->join = createIP4Starts(*tab == 's')));
+}
+
+static boolean appendIP4Rows(DBWriter *db, IP4Copies *cp, IP4Set sets[], int n)
+{
+   return appendDBSection(db, sets, n*sizeof(IP4Set))
+       && (!cp->pack   || packIP4Sets(cp->pack, sets, n))
+       && (!cp->starts || appendIP4Starts(cp->starts, sets, n))
+       && (!cp->post   || appendIP4Postings(cp->post, sets, n))
+       && (!cp->sums   || appendIP4Summaries(cp->sums, sets, n))
+       && (!cp->join   || appendIP4Starts(cp->join, sets, n))
+       && (cp->tally.tab < 0 || tallyIP4Rows(&cp->tally, sets, n));
+}
+
+static boolean joinIP4Starts(DBWriter *db, const char *tab, IP4Copies *cp)
+{
+   boolean rc = true;
+
+   if (*tab == 'v')
+   {
+      releaseIP4Starts(&IP4Join);
+      IP4Join = cp->join, cp->join = NULL;
+   }
+
+   else
+   {
+      rc = IP4Join && serializeIP4Join(db, IP4Join, cp->join);
+      releaseIP4Starts(&IP4Join);
+   }
+
+   return rc;
+}
+
+static boolean storeIP4Copies(DBWriter *db, const char *tab, IP4Copies *cp)
+{
+   char name[8];
+   snprintf(name, sizeof(name), "%sp", tab);
+   return (!cp->pack   || beginDBSection(db, name, 1) && serializeIP4Packer(db, cp->pack))
+       && (!cp->starts || serializeIP4Starts(db, tab, cp->starts))
+       && (!cp->post   || serializePostings(db, tab, cp->post))
+       && (!cp->sums   || serializeSummaries(db, tab, cp->sums))
+       && (!cp->join   || joinIP4Starts(db, tab, cp))
+       && (cp->tally.tab < 0 || tallyIP4Rows(&cp->tally, NULL, 0));
+}
+
+static void releaseIP4Copies(IP4Copies *cp)
+{
+   releaseIP4Packer(&cp->pack);
+   releaseIP4Starts(&cp->starts);
+   releasePostings(&cp->post);
+   releaseSummaries(&cp->sums);
+   releaseIP4Starts(&cp->join);
+}
+
+static boolean storeIP4Table(DBWriter *db, const char *tab, IP4Index *index)
+{
+   IP4Copies cp;
+   boolean rc = createIP4Copies(&cp, tab)
+             && beginDBSection(db, tab, sizeof(IP4Set)) && serializeIP4Index(db, index)
+             && (!cp.pack   || packIP4Index(cp.pack, index))
+             && (!cp.starts || collectIP4Starts(cp.starts, index))
+             && (!cp.post   || collectIP4Postings(cp.post, index))
+             && (!cp.sums   || collectIP4Summaries(cp.sums, index))
+             && (!cp.join   || collectIP4Starts(cp.join, index))
+             && (cp.tally.tab < 0 || tallyIP4Rows(&cp.tally, index->set, index->gap)
+                                  && tallyIP4Rows(&cp.tally, &index->set[index->gap + index->cap - index->count], index->count - index->gap))
+             && storeIP4Copies(db, tab, &cp);
+   releaseIP4Copies(&cp);
+   return rc;
+}
+
+// Splice the re-consolidated rows of the dirty regions into the old table and write the result.
+static boolean patchIP4Table(DBWriter *db, const char *tab, IP4Set *old, int n, IP4Span *regions, int r, IP4Set *new[], int m[])
+{
+   IP4Copies cp;
+   boolean rc = createIP4Copies(&cp, tab) && beginDBSection(db, tab, sizeof(IP4Set));
+   int     i = 0, k, l;
+
+   for (k = 0; rc && k < r; k++)
+   {
+      for (l = i; i < n && old[i].lo < regions[k].lo; i++);
+      rc = appendIP4Rows(db, &cp, &old[l], i-l);
+
+      for (l = i; i < n && old[i].lo <= regions[k].hi; i++);
+      rc = rc && appendIP4Rows(db, &cp, new[k], m[k]);
+   }
+
+   rc = rc && appendIP4Rows(db, &cp, &old[i], n-i) && storeIP4Copies(db, tab, &cp);
+   releaseIP4Copies(&cp);
+   return rc;
+}
+
+// Write the differences of the rows of the dirty regions to the changeset, returns their number.
+static int diffIP4Table(FILE *chg, const char *tab, IP4Set *old, int n, IP4Span *regions, int r, IP4Set *new[], int m[])
+{
+   int i = 0, d = 0, k, l;
+
+   for (k = 0; k < r; k++)
+   {
+      for (; i < n && old[i].lo < regions[k].lo; i++);
+      for (l = i; i < n && old[i].lo <= regions[k].hi; i++);
+      d += diffIP4Sets(chg, tab, &old[l], i-l, new[k], m[k]);
+   }
+
+   return d;
+}
+
+static boolean copyIP4Table(DBWriter *db, DBFile *old, const char *tab, IP4Set *rows, int n)
+{
+   tallyIP4Table(tab, rows, n);
+   return copySections(db, old, tab);
+}
+
+// Write the v and the s table with their copies. A table, the rows of which did not change, is copied verbatim together with
+// its copies from the old database file, if all of these are present, otherwise it is patched and its copies are regenerated.
+// The joined table depends on both tables, and so with -j, both are either copied or patched.
+static boolean writeIP4Tables(DBWriter *db, FILE *chg, DBFile *old, IP4Set *ipOld, int ipn, IP4Set *nsOld, int nsn,
+                              IP4Span *regions, int r, IP4Set *ipNew[], int ipm[], IP4Set *nsNew[], int nsm[])
+{
+   boolean ipCopy = !diffIP4Table(chg, "v4", ipOld, ipn, regions, r, ipNew, ipm) && reusableSections(old, "v4"),
+           nsCopy = !diffIP4Table(chg, "s4", nsOld, nsn, regions, r, nsNew, nsm) && reusableSections(old, "s4");
+
+   if (Joined)
+      ipCopy = nsCopy = ipCopy && nsCopy;
+
+   return ((ipCopy) ? copyIP4Table(db, old, "v4", ipOld, ipn) : patchIP4Table(db, "v4", ipOld, ipn, regions, r, ipNew, ipm))
+       && ((nsCopy) ? copyIP4Table(db, old, "s4", nsOld, nsn) : patchIP4Table(db, "s4", nsOld, nsn, regions, r, nsNew, nsm));
+}
+
+typedef struct
+{
+   IP6Packer *pack;
+   IP6Starts *starts;
+   Postings  *post;
+   Summaries *sums;
+   IP6Starts *join;
+   IP6Tally   tally;
+} IP6Copies;
+
+static IP6Starts *IP6Join = NULL;
+
+static boolean createIP6Copies(IP6Copies *cp, const char *tab)
+{
+   *cp = (IP6Copies){.tally.tab = (!Statistics) ? -1 : (*tab == 's') ? s6Tab : v6Tab};
+   return (!Packed || (cp->pack = createIP6Packer()))
+       && (!Starts || (cp->starts = createIP6Starts(*tab == 's')))
+       && (!Inverted || (cp->post = createPostings(*tab == 's')))
+       && (!Summed || (cp->sums = createSummaries(*tab == 's')))
+       && (!Joined || (cp->join = createIP6Starts(*tab == 's')));
+}
+
+static boolean appendIP6Rows(DBWriter *db, IP6Copies *cp, IP6Set sets[], int n)
+{
+   return appendDBSection(db, sets, n*sizeof(IP6Set))
+       && (!cp->pack   || packIP6Sets(cp->pack, sets, n))
+       && (!cp->starts || appendIP6Starts(cp->starts, sets, n))
+       && (!cp->post   || appendIP6Postings(cp->post, sets, n))
+       && (!cp->sums   || appendIP6Summaries(cp->sums, sets, n))
+       && (!cp->join   || appendIP6Starts(cp->join, sets, n))
+       && (cp->tally.tab < 0 || tallyIP6Rows(&cp->tally, sets, n));
+}
+
+static boolean joinIP6Starts(DBWriter *db, const char *tab, IP6Copies *cp)
+{
+   boolean rc = true;
+
+   if (*tab == 'v')
+   {
+      releaseIP6Starts(&IP6Join);
+      IP6Join = cp->join, cp->join = NULL;
+   }
+
+   else
+   {
+      rc = IP6Join && serializeIP6Join(db, IP6Join, cp->join);
+      releaseIP6Starts(&IP6Join);
+   }
+
+   return rc;
+}
+
+static boolean storeIP6Copies(DBWriter *db, const char *tab, IP6Copies *cp)
+{
+   char name[8];
+   snprintf(name, sizeof(name), "%sp", tab);
+   return (!cp->pack   || beginDBSection(db, name, 1) && serializeIP6Packer(db, cp->pack))
+       && (!cp->starts || serializeIP6Starts(db, tab, cp->starts))
+       && (!cp->post   || serializePostings(db, tab, cp->post))
+       && (!cp->sums   || serializeSummaries(db, tab, cp->sums))
+       && (!cp->join   || joinIP6Starts(db, tab, cp))
+       && (cp->tally.tab < 0 || tallyIP6Rows(&cp->tally, NULL, 0));
+}
+
+static void releaseIP6Copies(IP6Copies *cp)
+{
+   releaseIP6Packer(&cp->pack);
+   releaseIP6Starts(&cp->starts);
+   releasePostings(&cp->post);
+   releaseSummaries(&cp->sums);
+   releaseIP6Starts(&cp->join);
+}
+
+static boolean storeIP6Table(DBWriter *db, const char *tab, IP6Index *index)
+{
+   IP6Copies cp;
+   boolean rc = createIP6Copies(&cp, tab)
+             && beginDBSection(db, tab, sizeof(IP6Set)) && serializeIP6Index(db, index)
+             && (!cp.pack   || packIP6Index(cp.pack, index))
+             && (!cp.starts || collectIP6Starts(cp.starts, index))
+             && (!cp.post   || collectIP6Postings(cp.post, index))
+             && (!cp.sums   || collectIP6Summaries(cp.sums, index))
+             && (!cp.join   || collectIP6Starts(cp.join, index))
+             && (cp.tally.tab < 0 || tallyIP6Rows(&cp.tally, index->set, index->gap)
+                                  && tallyIP6Rows(&cp.tally, &index->set[index->gap + index->cap - index->count], index->count - index->gap))
+             && storeIP6Copies(db, tab, &cp);
+   releaseIP6Copies(&cp);
+   return rc;
+}
+
+static boolean patchIP6Table(DBWriter *db, const char *tab, IP6Set *old, int n, IP6Span *regions, int r, IP6Set *new[], int m[])
+{
+   IP6Copies cp;
+   boolean rc = createIP6Copies(&cp, tab) && beginDBSection(db, tab, sizeof(IP6Set));
+   int     i = 0, k, l;
+
+   for (k = 0; rc && k < r; k++)
+   {
+      for (l = i; i < n && lt_u128(old[i].lo, regions[k].lo); i++);
+      rc = appendIP6Rows(db, &cp, &old[l], i-l);
+
+      for (l = i; i < n && le_u128(old[i].lo, regions[k].hi); i++);
+      rc = rc && appendIP6Rows(db, &cp, new[k], m[k]);
+   }
+
+   rc = rc && appendIP6Rows(db, &cp, &old[i], n-i) && storeIP6Copies(db, tab, &cp);
+   releaseIP6Copies(&cp);
+   return rc;
+}
+
+// Write the differences of the rows of the dirty regions to the changeset, returns their number.
+static int diffIP6Table(FILE *chg, const char *tab, IP6Set *old, int n, IP6Span *regions, int r, IP6Set *new[], int m[])
+{
+   int i = 0, d = 0, k, l;
+
+   for (k = 0; k < r; k++)
+   {
+      for (; i < n && lt_u128(old[i].lo, regions[k].lo); i++);
+      for (l = i; i < n && le_u128(old[i].lo, regions[k].hi); i++);
+      d += diffIP6Sets(chg, tab, &old[l], i-l, new[k], m[k]);
+   }
+
+   return d;
+}
+
+static boolean copyIP6Table(DBWriter *db, DBFile *old, const char *tab, IP6Set *rows, int n)
+{
+   tallyIP6Table(tab, rows, n);
+   return copySections(db, old, tab);
+}
+
+// Write the v and the s table with their copies. A table, the rows of which did not change, is copied verbatim together with
+// its copies from the old database file, if all of these are present, otherwise it is patched and its copies are regenerated.
+// The joined table depends on both tables, and so with -j, both are either copied or patched.
+static boolean writeIP6Tables(DBWriter *db, FILE *chg, DBFile *old, IP6Set *ipOld, int ipn, IP6Set *nsOld, int nsn,
+                              IP6Span *regions, int r, IP6Set *ipNew[], int ipm[], IP6Set *nsNew[], int nsm[])
+{
+   boolean ipCopy = !diffIP6Table(chg, "v6", ipOld, ipn, regions, r, ipNew, ipm) && reusableSections(old, "v6"),
+           nsCopy = !diffIP6Table(chg, "s6", nsOld, nsn, regions, r, nsNew, nsm) && reusableSections(old, "s6");
+
+   if (Joined)
+      ipCopy = nsCopy = ipCopy && nsCopy;
+
+   return ((ipCopy) ? copyIP6Table(db, old, "v6", ipOld, ipn) : patchIP6Table(db, "v6", ipOld, ipn, regions, r, ipNew, ipm))
+       && ((nsCopy) ? copyIP6Table(db, old, "s6", nsOld, nsn) : patchIP6Table(db, "s6", nsOld, nsn, regions, r, nsNew, nsm));
+}
+
+
+static boolean updateIP4Tables(Registry regs[], int nreg, IP4Span *changed, int nchg, DBFile *old, DBWriter *db, FILE *chg, int *ip_patched, int *ns_patched)
+{
+   boolean  rc = false;
+   int      ipn, nsn;
+   IP4Set  *ipOld = getDBSection(old, "v4", sizeof(IP4Set), &ipn);
+   IP4Set  *nsOld = getDBSection(old, "s4", sizeof(IP4Set), &nsn);
+   IP4Span *spans = NULL, *regions = NULL;
+   IP4Set **ipNew = NULL, **nsNew = NULL;
+   int     *ipm   = NULL,  *nsm   = NULL;
+   int      i, j, k, q, r = 0, s = 0;
+
+   if (!ipOld || !nsOld)
+      return false;
+
+   if (!nchg)                             // the tables are unchanged
+      return writeIP4Tables(db, chg, old, ipOld, ipn, nsOld, nsn, NULL, 0, NULL, NULL, NULL, NULL);
+
+   for (q = ipn + nsn + nchg, k = 0; k < nreg; k++)
+      q += regs[k].n4;
+
+   if ((spans = allocate(q*(ssize_t)sizeof(IP4Span), default_align, false)) == NULL)
+      goto quit;
+
+   for (i = 0; i < ipn; i++)
+      spans[s++] = (IP4Span){ipOld[i].lo, ipOld[i].hi, 0};
+   for (i = 0; i < nsn; i++)
+      spans[s++] = (IP4Span){nsOld[i].lo, nsOld[i].hi, 0};
+   for (k = 0; k < nreg; k++)
+      for (i = 0; i < regs[k].n4; i++)
+         spans[s++] = (IP4Span){regs[k].d4[i].lo, regs[k].d4[i].hi, 0};
+   for (i = 0; i < nchg; i++)
+      spans[s++] = changed[i];
+   qsort(spans, s, sizeof(IP4Span), cmpIP4Span);
+
+   // sweep the spans into connected regions and keep the dirty ones in place at the beginning of the spans array
+   for (i = 0; i < s; r += spans[r].dirty)
+   {
+      spans[r] = spans[i++];
+      for (; i < s && (!spans[i].lo || spans[i].lo - 1 <= spans[r].hi); i++)
+      {
+         if (spans[i].hi > spans[r].hi)
+            spans[r].hi = spans[i].hi;
+         spans[r].dirty |= spans[i].dirty;
+      }
+   }
+   regions = spans;
+
+   if (r)
+   {
+      if ((ipNew = allocate(r*(ssize_t)sizeof(IP4Set *), default_align, true)) == NULL
+       || (nsNew = allocate(r*(ssize_t)sizeof(IP4Set *), default_align, true)) == NULL
+       || (ipm   = allocate(r*(ssize_t)sizeof(int), default_align, true)) == NULL
+       || (nsm   = allocate(r*(ssize_t)sizeof(int), default_align, true)) == NULL)
+         goto quit;
+
+      for (k = 0; k < r; k++)
+      {
+         IP4Index ipStore = {}, nsStore = {};
+
+         for (j = 0; j < nreg; j++)
+         {
+            IP4Deleg *d = regs[j].d4;
+            int o, p, u;                  // bisection for the first delegation of the region
+            for (p = 0, u = regs[j].n4; p < u;)
+               if (d[o = (p + u) >> 1].lo < regions[k].lo)
+                  p = o+1;
+               else
+                  u = o;
+
+            for (; p < regs[j].n4 && d[p].lo <= regions[k].hi; p++)
+               mergeIP4Deleg(&d[p], &ipStore, &nsStore, &ipm[k], &nsm[k]);
+         }
+
+         boolean ok = (!ipm[k] || (ipNew[k] = allocate(ipm[k]*(ssize_t)sizeof(IP4Set), default_align, false)))
+                   && (!nsm[k] || (nsNew[k] = allocate(nsm[k]*(ssize_t)sizeof(IP4Set), default_align, false)));
+         if (ok)
+         {
+            ipm[k] = collectIP4Index(&ipStore, ipNew[k]);
+            nsm[k] = collectIP4Index(&nsStore, nsNew[k]);
+         }
+
+         releaseIP4Index(&ipStore);
+         releaseIP4Index(&nsStore);
+
+         if (!ok)
+            goto quit;                    // out of memory
+
+         *ip_patched += ipm[k], *ns_patched += nsm[k];
+      }
+
+   }
+
+   rc = writeIP4Tables(db, chg, old, ipOld, ipn, nsOld, nsn, regions, r, ipNew, ipm, nsNew, nsm);
+
+quit:
+   if (ipNew)
+      for (k = 0; k < r; k++)
+         deallocate_batch(false, VPR(ipNew[k]), VPR(nsNew[k]), NULL);
+   deallocate_batch(false, VPR(nsm), VPR(ipm), VPR(nsNew), VPR(ipNew), VPR(spans), NULL);
+   return rc;
+}
+
+static boolean updateIP6Tables(Registry regs[], int nreg, IP6Span *changed, int nchg, DBFile *old, DBWriter *db, FILE *chg, int *ip_patched, int *ns_patched)
+{
+   boolean  rc = false;
+   int      ipn, nsn;
+   IP6Set  *ipOld = getDBSection(old, "v6", sizeof(IP6Set), &ipn);
+   IP6Set  *nsOld = getDBSection(old, "s6", sizeof(IP6Set), &nsn);
+   IP6Span *spans = NULL, *regions = NULL;
+   IP6Set **ipNew = NULL, **nsNew = NULL;
+   int     *ipm   = NULL,  *nsm   = NULL;
+   int      i, j, k, q, r = 0, s = 0;
+
+   if (!ipOld || !nsOld)
+      return false;
+
+   if (!nchg)                             // the tables are unchanged
+      return writeIP6Tables(db, chg, old, ipOld, ipn, nsOld, nsn, NULL, 0, NULL, NULL, NULL, NULL);
+
+   for (q = ipn + nsn + nchg, k = 0; k < nreg; k++)
+      q += regs[k].n6;
+
+   if ((spans = allocate(q*(ssize_t)sizeof(IP6Span), default_align, false)) == NULL)
+      goto quit;
+
+   for (i = 0; i < ipn; i++)
+      spans[s++] = (IP6Span){ipOld[i].lo, ipOld[i].hi, 0};
+   for (i = 0; i < nsn; i++)
+      spans[s++] = (IP6Span){nsOld[i].lo, nsOld[i].hi, 0};
+   for (k = 0; k < nreg; k++)
+      for (i = 0; i < regs[k].n6; i++)
+         spans[s++] = (IP6Span){regs[k].d6[i].lo, regs[k].d6[i].hi, 0};
+   for (i = 0; i < nchg; i++)
+      spans[s++] = changed[i];
+   qsort(spans, s, sizeof(IP6Span), cmpIP6Span);
+
+   // sweep the spans into connected regions and keep the dirty ones in place at the beginning of the spans array
+   for (i = 0; i < s; r += spans[r].dirty)
+   {
+      spans[r] = spans[i++];
+      for (; i < s && (eq_u128(spans[i].lo, u64_to_u128t(0)) || le_u128(sub_u128(spans[i].lo, u64_to_u128t(1)), spans[r].hi)); i++)
+      {
+         if (gt_u128(spans[i].hi, spans[r].hi))
+            spans[r].hi = spans[i].hi;
+         spans[r].dirty |= spans[i].dirty;
+      }
+   }
+   regions = spans;
+
+   if (r)
+   {
+      if ((ipNew = allocate(r*(ssize_t)sizeof(IP6Set *), default_align, true)) == NULL
+       || (nsNew = allocate(r*(ssize_t)sizeof(IP6Set *), default_align, true)) == NULL
+       || (ipm   = allocate(r*(ssize_t)sizeof(int), default_align, true)) == NULL
+       || (nsm   = allocate(r*(ssize_t)sizeof(int), default_align, true)) == NULL)
+         goto quit;
+
+      for (k = 0; k < r; k++)
+      {
+         IP6Index ipStore = {}, nsStore = {};
+
+         for (j = 0; j < nreg; j++)
+         {
+            IP6Deleg *d = regs[j].d6;
+            int o, p, u;                  // bisection for the first delegation of the region
+            for (p = 0, u = regs[j].n6; p < u;)
+               if (lt_u128(d[o = (p + u) >> 1].lo, regions[k].lo))
+                  p = o+1;
+               else
+                  u = o;
+
+            for (; p < regs[j].n6 && le_u128(d[p].lo, regions[k].hi); p++)
+               mergeIP6Deleg(&d[p], &ipStore, &nsStore, &ipm[k], &nsm[k]);
+         }
+
+         boolean ok = (!ipm[k] || (ipNew[k] = allocate(ipm[k]*(ssize_t)sizeof(IP6Set), default_align, false)))
+                   && (!nsm[k] || (nsNew[k] = allocate(nsm[k]*(ssize_t)sizeof(IP6Set), default_align, false)));
+         if (ok)
+         {
+            ipm[k] = collectIP6Index(&ipStore, ipNew[k]);
+            nsm[k] = collectIP6Index(&nsStore, nsNew[k]);
+         }
+
+         releaseIP6Index(&ipStore);
+         releaseIP6Index(&nsStore);
+
+         if (!ok)
+            goto quit;                    // out of memory
+
+         *ip_patched += ipm[k], *ns_patched += nsm[k];
+      }
+
+   }
+
+   rc = writeIP6Tables(db, chg, old, ipOld, ipn, nsOld, nsn, regions, r, ipNew, ipm, nsNew, nsm);
+
+quit:
+   if (ipNew)
+      for (k = 0; k < r; k++)
+         deallocate_batch(false, VPR(ipNew[k]), VPR(nsNew[k]), NULL);
+   deallocate_batch(false, VPR(nsm), VPR(ipm), VPR(nsNew), VPR(ipNew), VPR(spans), NULL);
+   return rc;
+}
+
+
+// Returns -1 if an incremental update is not possible, otherwise 0 on success or 1 on failure. If none of the delegations
+// changed, and the database file holds all of the requested sections, then it is left untouched and *unchanged is set.
+static int updateTables(const char *base, Registry regs[], int nreg, boolean *unchanged)
+{
+   int       rc = -1;
+   int       k, n4 = 0, n6 = 0;
+   size_t    size;
+   IP4Span  *changed4 = NULL;
+   IP6Span  *changed6 = NULL;
+   DBFile   *old = NULL;
+   DBWriter *db  = NULL;
+
+   if ((old = openDB(base)) == NULL)
+      return rc;                          // no usable database file of the previous build
+
+   for (k = 0; k < nreg; k++)
+   {                                      // one registry after the other, so that only one pair of snapshots is held in memory
+      IP4Deleg *old4 = NULL;
+      IP6Deleg *old6 = NULL;
+      int       oldn4 = 0, oldn6 = 0;
+      boolean   diffed = false;
+
+      char *d4n = snapshotName(base, regs[k].reg, ".d4");
+      char *d6n = snapshotName(base, regs[k].reg, ".d6");
+      if (d4n && d6n)
+      {
+         old4 = loadFile(d4n, &size), oldn4 = (int)(size/sizeof(IP4Deleg));
+         old6 = loadFile(d6n, &size), oldn6 = (int)(size/sizeof(IP6Deleg));
+      }
+      deallocate_batch(false, VPR(d6n), VPR(d4n), NULL);
+
+      if (old4 && old6
+       && (changed4 = reallocate(changed4, (n4 + oldn4 + regs[k].n4)*(ssize_t)sizeof(IP4Span), false, true))
+       && (changed6 = reallocate(changed6, (n6 + oldn6 + regs[k].n6)*(ssize_t)sizeof(IP6Span), false, true)))
+      {
+         n4 += diffIP4Delegs(old4, oldn4, regs[k].d4, regs[k].n4, &changed4[n4]);
+         n6 += diffIP6Delegs(old6, oldn6, regs[k].d6, regs[k].n6, &changed6[n6]);
+         diffed = true;
+      }
+      deallocate_batch(false, VPR(old6), VPR(old4), NULL);
+
+      if (!diffed)
+         goto quit;                       // no snapshot of the previous build
+   }
+
+   int   len  = strvlen(base);
+   char *name = strcpy(alloca(OSP(len+5)), base); cpy5(name+len, ".chg");
+   FILE *chg;
+
+   rc = 1;
+   if (!n4 && !n6 && old->head->count == 1 + requestedSections(old))
+   {                                      // nothing to do, except of emptying the changeset of an earlier update
+      if (chg = fopen(name, "w"))
+      {
+         int ipn, nsn;
+         IP4Set *ip4 = getDBSection(old, "v4", sizeof(IP4Set), &ipn), *ns4 = getDBSection(old, "s4", sizeof(IP4Set), &nsn);
+         tallyIP4Table("v4", ip4, ipn), tallyIP4Table("s4", ns4, nsn);
+         IP6Set *ip6 = getDBSection(old, "v6", sizeof(IP6Set), &ipn), *ns6 = getDBSection(old, "s6", sizeof(IP6Set), &nsn);
+         tallyIP6Table("v6", ip6, ipn), tallyIP6Table("s6", ns6, nsn);
+
+         recordSections(old->sect, (int)old->head->count);
+         printf("\n\nNumber of changed delegations = 0\nNumber of patched IP-Ranges   = 0\nNumber of patched Segments    = 0\n");
+         *unchanged = true;
+         rc = (fclose(chg) == no_error) ? 0 : 1;
+      }
+   }
+
+   else if (chg = fopen(name, "w"))
+   {
+      int ip_patched = 0, ns_patched = 0;
+
+      if ((Owners = loadNSODict(old, true)) && (db = createDB(base))
+       && updateIP4Tables(regs, nreg, changed4, n4, old, db, chg, &ip_patched, &ns_patched)
+       && updateIP6Tables(regs, nreg, changed6, n6, old, db, chg, &ip_patched, &ns_patched)
+       && beginDBSection(db, "nso", 1) && appendDBSection(db, Owners->data, Owners->size))
+      {
+         recordSections(db->sect, (int)db->head.count);
+         if (commitDB(db))
+         {
+            printf("\n\nNumber of changed delegations = %d\nNumber of patched IP-Ranges   = %d\nNumber of patched Segments    = %d\n", n4 + n6, ip_patched, ns_patched);
+            rc = 0;
+         }
+         db = NULL;
+      }
+
+      if (fclose(chg) != no_error)
+         rc = 1;
+   }
+
+quit:
+   abortDB(db);
+   deallocate_batch(false, VPR(changed6), VPR(changed4), NULL);
+   closeDB(&old);
+   return rc;
+}
+
+
+int main(int argc, char *argv[])
+{
+   bool incrFlag = false;
+   int  ch, rc = 1;
+   char *cmd = argv[0];
+
+   static struct option longopts[] =
+   {
+      {"profile", no_argument, NULL, 'p'},
+      {"stats",   no_argument, NULL, 's'},
+      {NULL,      0,           NULL,  0 }
+   };
+
+   while ((ch = getopt_long(argc, argv, "izkxjcsph", longopts, NULL)) != -1)
+   {
+      switch (ch)
+      {
+         case 'i':
+            incrFlag = true;
+            break;
+
+         case 'z':
+            Packed = true;
+            break;
+
+         case 'k':
+            Starts = true;
+            break;
+
+         case 'x':
+            Inverted = true;
+            break;
+
+         case 'j':
+            Joined = true;
+            break;
+
+         case 'c':
+            Summed = true;
+            break;
+
+         case 's':
+            Statistics = true;
+            break;
+
+         case 'p':
+            Profile = true;
+            break;
+
+         case 'h':
+         default:
+            usage(cmd);
+            return 1;
+      }
+   }
+
+   argc -= optind;
+   argv += optind;
+
+   if (argc >= 2)
+   {
+      int   namelen = strvlen(argv[0]);
+      int   inc, nreg = argc - 1, nstale = 0;
+      long  delegs = 0;
+      boolean unchanged = false;
+
+      Registry *regs = allocate(nreg*(ssize_t)sizeof(Registry), default_align, true);
+      if (!regs)
+         return 1;
+
+      FILE  *in;
+      struct stat st;
+
+      printf("ipdb v1.2b (" SCMREV "), Copyright © 2016-2018 Dr. Rolf Jansen\nProcessing RIR data files ...\n\n");
+      beginPhase();
+      for (inc = 1; inc < argc; inc++)
+      {
+         if (stat(argv[inc], &st) == no_error && st.st_size && (in = fopen(argv[inc], "r")))
+         {
+            const char *file = strrchr(argv[inc], '/');
+            if (file)
+               file++;
+            else
+               file = argv[inc];
+            printf(" %s ", file);
+            fflush(stdout);
+
+            readRIRStatisticsFormat_v2(in, (size_t)st.st_size, &regs[inc-1]);
+            if (!*regs[inc-1].reg)        // no registry header, key the snapshot by the file name
+               strmlcpy(regs[inc-1].reg, file, 8, NULL);
+            fclose(in);
+            delegs += regs[inc-1].n4 + regs[inc-1].n6;
+         }
+
+         else
+         {
+            printf("\n");
+            goto quit;
+         }
+      }
+
+      endPhase("parse", delegs);
+
+      nstale = staleRegistries(argv[0], &regs, nreg);
+
+      beginPhase();
+      if (incrFlag && (rc = updateTables(argv[0], regs, nreg + nstale, &unchanged)) >= 0)
+         endPhase("update", delegs);
+
+      else
+      {
+         DBWriter *db;
+         int ip_count, ns_count, ip_total = 0, ns_total = 0;
+
+         rc = 1;
+         releaseNSODict(&Owners);
+         if ((Owners = createNSODict(NULL, 0, true))
+          && (db = createDB(argv[0])))
+         {
+            beginPhase();
+            for (inc = 0; inc < nreg; inc++)
+            {
+               ip_count = ns_count = 0;
+               for (int i = 0; i < regs[inc].n4; i++)
+                  mergeIP4Deleg(&regs[inc].d4[i], &IP4Store, &NS4Store, &ip_count, &ns_count);
+               for (int i = 0; i < regs[inc].n6; i++)
+                  mergeIP6Deleg(&regs[inc].d6[i], &IP6Store, &NS6Store, &ip_count, &ns_count);
+               ip_total += ip_count, ns_total += ns_count;
+            }
+            endPhase("merge", delegs);
+
+            beginPhase();
+            if (storeIP4Table(db, "v4", &IP4Store) && storeIP4Table(db, "s4", &NS4Store)
+             && storeIP6Table(db, "v6", &IP6Store) && storeIP6Table(db, "s6", &NS6Store)
+             && beginDBSection(db, "nso", 1) && appendDBSection(db, Owners->data, Owners->size))
+            {
+               recordSections(db->sect, (int)db->head.count);
+               if (commitDB(db))
+               {
+                  endPhase("store", ip_total + ns_total);
+                  printf("\n\nTotal number of processed IP-Ranges = %d\nTotal number of processed Segments  = %d\nTotal number of Segment Owners      = %u\n", ip_total, ns_total, Owners->count);
+                  rc = 0;
+               }
+            }
+            else
+               abortDB(db);
+         }
+
+         if (rc == 0)
+         {                                // a changeset from an earlier incremental update does not apply anymore
+            char *chgName = strcpy(alloca(OSP(namelen+5)), argv[0]); cpy5(chgName+namelen, ".chg");
+            unlink(chgName);
+         }
+      }
+
+      if (rc == 0 && !unchanged)          // the snapshots are still those of the unchanged delegations
+      {
+         beginPhase();
+         for (inc = 0; inc < nreg; inc++)
+            if (!storeSnapshots(argv[0], &regs[inc]))
+               rc = 1;
+         endPhase("snapshots", delegs);
+      }
+
+      if (rc == 0)                        // the rows of the missing registries are gone now
+         for (inc = nreg; inc < nreg + nstale; inc++)
+            removeSnapshots(argv[0], &regs[inc]);
+
+      if (rc == 0)
+      {
+         struct rusage ru;
+         getrusage(RUSAGE_SELF, &ru);
+      #if defined __APPLE__
+         ru.ru_maxrss /= 1024;            // bytes on macOS, kilobytes elsewhere
+      #endif
+         printf("\nPeak resident set size = %ld kB\n", (long)ru.ru_maxrss);
+
+         if (Statistics)
+            printStatistics(regs, nreg);
+
+         if (Profile)
+            printProfile();
+      }
+
+   quit:
+      releaseNSODict(&Owners);
+      releaseIP6Index(&NS6Store);
+      releaseIP4Index(&NS4Store);
+      releaseIP6Index(&IP6Store);
+      releaseIP4Index(&IP4Store);
+      for (inc = 0; inc < nreg; inc++)
+         deallocate_batch(false, VPR(regs[inc].d6), VPR(regs[inc].d4), NULL);
+      deallocate(VPR(regs), false);
+   }
+
+   else
+      usage(cmd);
+
+   return rc;
 }
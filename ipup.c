@@ -37,7 +37,6 @@
 #include <math.h>
 #include <syslog.h>
 #include <unistd.h>
-#include <sys/stat.h>
 #include <sys/time.h>
 
 #include "utils.h"
@@ -48,30 +47,47 @@
 void usage(const char *executable)
 {
    const char *r = executable + strvlen(executable);
-   while (--r >= executable && *r != '/'); r++;
+   while (--r >= executable && *r != '/');
+   r++;
    printf("%s v1.2b (" SCMREV "), Copyright © 2016-2018 Dr. Rolf Jansen\n\n", r);
    printf("Usage:\n\n");
    printf("1) look up the country code and network segment owner ID belonging to an IP address given by the last command line argument:\n\n");
-   printf("   %s [-r bstfiles] [-h] <IP address>\n", r);
+   printf("   %s [-r bstfile] [-h] <IP address>\n", r);
    printf("      <IP address>      IPv4 or IPv6 address of which the country code is to be looked up.\n");
    printf("      -h                Show these usage instructions.\n\n");
    printf("2) generate a sorted list of IP address/masklen pairs per country code or network segment owner, formatted as ipfw table construction directives:\n\n");
-   printf("   %s -t CC:NSo:.. | CC=nnnnn:NSo=mmmmm:.. | \"\" [-n table number] [-v table value] [-x offset] [-p] [-4] [-6] [-r bstfiles]\n\n", r);
+   printf("   %s -t CC:NSo:.. | CC=nnnnn:NSo=mmmmm:.. | \"\" | -e expression [-n table number] [-v table value] [-x offset] [-p] [-a] [-o format] [-4] [-6] [-c] [-d prevbstfile] [-r bstfile]\n\n", r);
    printf("      -t CC:NSo:..      Output all IP address/masklen pairs belonging to the listed countries or network segment owners\n");
    printf("         | CC=nnnnn:..  country codes in capital letters or network segment owner ID's, separated by colon. An empty CC/NSo list means any code/owner.\n");
    printf("           | \"\"         A table value can be assigned per country code or network segment owner in the following manner:\n");
    printf("                        -t BR=10000:DE=10100:US:CA:e162e4f7de39433ca9ff03b85c4caae3=10200. In the case of no assignment,\n");
    printf("                        no value or the global value defined by either the -v or the -x option would be utilized.\n");
+   printf("      -e expression     Select the ranges by an expression of country codes and owner ID's with optional values, combined by\n");
+   printf("                        + (union), - (difference), & (intersection), ~ (complement) and parentheses, e.g.\n");
+   printf("                        -e \"(DE + AT=10100) - e162e4f7de39433ca9ff03b85c4caae3\". Not together with -t.\n");
    printf("      -n table number   The ipfw table number between 0 and 65534 [default: 0].\n");
    printf("      -v table value    A global 32-bit unsigned value for all ipfw table entries [default: 0].\n");
    printf("      -x offset         Decimal encode the given CC and add it to the offset for computing the table value:\n");
    printf("                        value = offset + ((C1 - 'A')*26 + (C2 - 'A'))*10.\n");
    printf("      -p                Plain IP table generation, i.e. without ipfw table construction directives,\n");
    printf("                        and any -n, -v and -x flags are ignored in this mode.\n");
+   printf("      -a                Aggregation mode: adjacent selected ranges with the same table value are merged before\n");
+   printf("                        decomposition into address/masklen pairs. The pair counts before and after are reported on stderr.\n");
+   printf("      -o format         Output format: ipfw [default], nft, ipset, lpm or range. nft generates an 'nft -f' script, which replaces\n");
+   printf("                        the elements of the interval sets ipup4_n and ipup6_n in the table inet ipup, or of the maps of\n");
+   printf("                        the same names with the table values as marks. ipset generates an 'ipset restore' batch, which\n");
+   printf("                        fills new hash:net sets and swaps them with the sets ipup4_n and ipup6_n. The binary formats\n");
+   printf("                        lpm and range write images of {prefixlen, address, value} records in the layout of eBPF\n");
+   printf("                        LPM trie keys and values, or of sorted {lo, hi, value} ranges, for kernel loaders. Not with -d.\n");
    printf("      -4                Process only the IPv4 address ranges.\n");
-   printf("      -6                process only the IPv6 address ranges.\n\n");
+   printf("      -6                process only the IPv6 address ranges.\n");
+   printf("      -c                Instead of the pairs, output the number of rows, address/masklen pairs and addresses of each of\n");
+   printf("                        the listed (-t) countries and owners, and their totals, which are precomputed by 'ipdb -c'.\n");
+   printf("      -d prevbstfile    Delta mode: path to the database file of a previous build. Only the IP address/masklen pairs\n");
+   printf("                        which differ between the previous and the current tables are output as 'table n delete'\n");
+   printf("                        and 'table n add' directives, or as 'delete'/'add' prefixed pairs in plain mode (-p).\n\n");
    printf("   valid argument in usage forms 1+2:\n\n");
-   printf("      -r bstfiles       Base path to the binary sorted tables (.v4, .v6, .s4 and .s6) with the consolidated IP ranges\n");
+   printf("      -r bstfile        Path to the database file with the sorted tables of the consolidated IP ranges and owners\n");
    printf("                        which were generated by the 'ipdb' tool [default: /usr/local/etc/ipdb/IPRanges/ipcc.bst].\n\n");
    printf("3) compute the encoded value of a country code (see -x flag above):\n\n");
    printf("   %s -q CC\n", r);
@@ -79,8 +95,10 @@ void usage(const char *executable)
 }
 
 
-CCNode  **CCTable  = NULL;
-NSONode **NSOTable = NULL;
+CCNode  **CCTable    = NULL;
+NSONode **NSOTable   = NULL;
+NSODict  *Owners     = NULL;
+NSODict  *PrevOwners = NULL;
 
 static inline uint32_t ccv(uint16_t cc, int32_t toff)
 {
@@ -88,25 +106,1980 @@ static inline uint32_t ccv(uint16_t cc, int32_t toff)
    return (0 <= val && val <= 4294967295) ? (uint32_t)val : 0; // the result mut be a 32-bit unsigned value
 }
 
+
+#pragma mark ••• CIDR Lists •••
+
+// The second usage form decomposes the selected IP ranges into lists of address/masklen pairs. In delta mode (-d),
+// the lists of the previous and the current tables are sorted and compared in one merge pass, so that only the
+// changed pairs need to be deleted from or added to the firewall table.
+
+typedef struct
+{
+   uint32_t ip;
+   int32_t  m;                   // number of host bits, masklen = 32 - m
+   int64_t  val;                 // table value, -1 = no value
+   int32_t  seq;                 // generation order, the first of duplicate pairs wins
+} CIDR4;
+
+typedef struct
+{
+   uint128t ip;
+   int32_t  m;                   // number of host bits, masklen = 128 - m
+   int64_t  val;
+   int32_t  seq;
+} CIDR6;
+
+typedef struct
+{
+   CIDR4 *cidr;
+   int    n, c;
+   int    u;                     // number of pairs without aggregation
+} CIDR4List;
+
+typedef struct
+{
+   CIDR6 *cidr;
+   int    n, c;
+   int    u;
+} CIDR6List;
+
+#define EXPR_NODES 256
+
+typedef struct
+{
+   char    op;                   // '+', '-', '&' or '~', 0 for an operand
+   int16_t l, r;                 // operator nodes
+   int16_t leaf;                 // operand nodes
+} ExprNode;
+
+typedef struct
+{
+   ExprNode  node[EXPR_NODES];
+   int       n, root;
+   int       leaves;
+   boolean   valued;             // any operand was given a table value
+   int16_t   ccleaf[ccTableSize];// leaf per country code, -1 if not in the expression
+   NSONode **owners;             // leaf + 1 per owner ID
+   int64_t   leafval[EXPR_NODES];
+} Expr;
+
+typedef struct
+{
+   char    *list;
+   Expr    *expr;                // selection expression (-e), see parseExpr()
+   boolean  valueFlag;
+   uint32_t tval;
+   int32_t  toff;
+   boolean  aggrFlag;
+   boolean  plainFlag;
+   int64_t  ccval[ccTableSize];  // table value per country code, see compileSelection()
+} Selection;
+
+typedef struct
+{
+   uint32_t lo, hi;
+   int64_t  val;
+} Range4;
+
+typedef struct
+{
+   uint128t lo, hi;
+   int64_t  val;
+} Range6;
+
+typedef struct
+{
+   Range4 *range;
+   int     n, c;
+} Range4List;
+
+typedef struct
+{
+   Range6 *range;
+   int     n, c;
+} Range6List;
+
+typedef enum
+{
+   ipfwFormat,                   // ipfw table directives or plain address/masklen pairs
+   nftFormat,                    // nft -f script with interval sets or maps
+   ipsetFormat,                  // ipset restore batch
+   lpmFormat,                    // binary image of LPM trie records
+   rangeFormat                   // binary image of sorted disjoint ranges
+} Format;
+
+typedef struct
+{
+   int64_t *val;                 // table value per owner ID, val[0] for no or unknown owner, see selectOwners()
+   uint32_t count;
+} OwnerValues;
+
+#define NOSEL INT64_MIN          // not selected
+
+
+static CIDR4 *newCIDR4(CIDR4List *list)
+{
+   if (list->n == list->c)
+   {
+      list->c = (list->c) ? 2*list->c : 4096;
+      if ((list->cidr = reallocate(list->cidr, list->c*(ssize_t)sizeof(CIDR4), false, true)) == NULL)
+      {
+         list->n = list->c = 0;
+         return NULL;
+      }
+   }
+
+   CIDR4 *cidr = &list->cidr[list->n];
+   cidr->seq = list->n++;
+   return cidr;
+}
+
+static CIDR6 *newCIDR6(CIDR6List *list)
+{
+   if (list->n == list->c)
+   {
+      list->c = (list->c) ? 2*list->c : 4096;
+      if ((list->cidr = reallocate(list->cidr, list->c*(ssize_t)sizeof(CIDR6), false, true)) == NULL)
+      {
+         list->n = list->c = 0;
+         return NULL;
+      }
+   }
+
+   CIDR6 *cidr = &list->cidr[list->n];
+   cidr->seq = list->n++;
+   return cidr;
+}
+
+static Range4 *newRange4(Range4List *list)
+{
+   if (list->n == list->c)
+   {
+      list->c = (list->c) ? 2*list->c : 4096;
+      if ((list->range = reallocate(list->range, list->c*(ssize_t)sizeof(Range4), false, true)) == NULL)
+      {
+         list->n = list->c = 0;
+         return NULL;
+      }
+   }
+
+   return &list->range[list->n++];
+}
+
+static Range6 *newRange6(Range6List *list)
+{
+   if (list->n == list->c)
+   {
+      list->c = (list->c) ? 2*list->c : 4096;
+      if ((list->range = reallocate(list->range, list->c*(ssize_t)sizeof(Range6), false, true)) == NULL)
+      {
+         list->n = list->c = 0;
+         return NULL;
+      }
+   }
+
+   return &list->range[list->n++];
+}
+
+
+static inline int64_t ccValue(CCNode *ccn, uint16_t cc, Selection *sel)
+{
+   if (ccn && ccn->val != 0)
+      return ccn->val;
+   else if (sel->tval != 0)
+      return sel->tval;
+   else if (ccn && sel->valueFlag)
+      return ccv(cc, sel->toff);
+   else
+      return -1;
+}
+
+static inline int64_t nsoValue(NSONode *nsn, Selection *sel)
+{
+   if (nsn && nsn->val != 0)
+      return nsn->val;
+   else if (sel->tval != 0)
+      return sel->tval;
+   else
+      return -1;
+}
+
+
+// The selector list is compiled once into the table values of all 676 country codes and of all owner IDs of
+// a dictionary, so that the scan over the rows of the tables needs only an array access per row, instead of
+// an AVL tree search by country code or a hash and a string comparing tree search by owner.
+void compileSelection(Selection *sel)
+{
+   CCNode  *ccn;
+   uint32_t cc = 0;
+   uint8_t *ca = (uint8_t *)&cc;
+
+   for (ca[0] = 'A'; ca[0] <= 'Z'; ca[0]++)
+      for (ca[1] = 'A'; ca[1] <= 'Z'; ca[1]++)
+         sel->ccval[cce(cc16(&cc))] = (!*sel->list) ? ccValue(NULL, cc16(&cc), sel)
+                                    : (ccn = findCC(CCTable, cc)) ? ccValue(ccn, cc16(&cc), sel)
+                                                                  : NOSEL;
+}
+
+boolean selectOwners(OwnerValues *own, NSODict *owners, Selection *sel)
+{
+   uint32_t id;
+   NSONode *nsn;
+
+   if (!(own->val = allocate((owners->count + 1)*sizeof(int64_t), default_align, false)))
+   {
+      printf("Not enough memory.\n\n");
+      return false;
+   }
+
+   for (own->count = owners->count, id = 0; id <= own->count; id++)
+      own->val[id] = (!*sel->list) ? nsoValue(NULL, sel)
+                   : (nsn = findNSO(NSOTable, nsoString(owners, id))) ? nsoValue(nsn, sel)
+                                                                      : NOSEL;
+   return true;
+}
+
+static inline int64_t ccSelection(uint32_t cc, Selection *sel)
+{
+   uint32_t k = ccKey(cc);
+   CCNode  *ccn;
+
+   if (k < ccTableSize)
+      return sel->ccval[k];
+   else  // no proper country code
+      return (!*sel->list) ? ccValue(NULL, cc16(&cc), sel)
+           : (ccn = findCC(CCTable, cc)) ? ccValue(ccn, cc16(&cc), sel)
+                                         : NOSEL;
+}
+
+static inline int64_t nsoSelection(uint32_t id, OwnerValues *own)
+{
+   return own->val[(id <= own->count) ? id : 0];
+}
+
+
+static int cmpRow(const void *a, const void *b)
+{
+   uint32_t p = *(uint32_t *)a, q = *(uint32_t *)b;
+   return (p > q) - (p < q);
+}
+
+// The numbers of the rows of a table with the given keys in ascending order, gathered from its posting lists (ipdb -x). Returns
+// NULL, if the table has no posting lists, or if the keys cover so many rows that a scan over the whole table is cheaper anyway.
+static uint32_t *gatherRows(DBFile *db, const char *tab, int n, uint32_t keys[], int k, int *count)
+{
+   PostingIndex index;
+   uint32_t    *rows, *r;
+   int          i, c, lists = 0, total = 0;
+
+   if (!openPostings(db, tab, n, &index))
+      return NULL;
+
+   for (i = 0; i < k; i++)
+   {
+      postingRows(&index, keys[i], &c);
+      total += c, lists += (c > 0);
+   }
+
+   if (total > n/4 || !(rows = allocate((total + 1)*sizeof(uint32_t), default_align, false)))
+      return NULL;
+
+   for (*count = i = 0; i < k; i++)
+      if (r = postingRows(&index, keys[i], &c))
+         memcpy(&rows[*count], r, c*sizeof(uint32_t)), *count += c;
+
+   if (lists > 1)    // keep the order of the table, in which later rows cut earlier ones off
+      qsort(rows, *count, sizeof(uint32_t), cmpRow);
+   return rows;
+}
+
+// The rows of the selected country codes of a v table, or of the selected owners of an s table, or NULL for a scan.
+static uint32_t *selectedRows(DBFile *db, const char *tab, int n, OwnerValues *owners, Selection *sel, int *count)
+{
+   uint32_t *keys, *rows, id;
+   int       k = 0;
+
+   if (!*sel->list || !(keys = allocate(((owners) ? owners->count + 1 : ccTableSize + 1)*sizeof(uint32_t), default_align, false)))
+      return NULL;
+
+   if (owners)
+   {
+      for (id = 0; id <= owners->count; id++)
+         if (owners->val[id] != NOSEL)
+            keys[k++] = id;
+   }
+
+   else
+   {
+      for (id = 0; id < ccTableSize; id++)
+         if (sel->ccval[id] != NOSEL)
+            keys[k++] = id;
+      keys[k++] = ccTableSize;   // the improper codes, which are checked per row
+   }
+
+   rows = gatherRows(db, tab, n, keys, k, count);
+   deallocate(VPR(keys), false);
+   return rows;
+}
+
+
+// Looks up the range of an address in the range starts <tab>k/<tab>v or in the packed copy <tab>p of a table, if present,
+// otherwise in the table itself. Returns the row number, -1 if the address is not in the table, or -2 if the table is missing.
+static int lookupIP4Set(DBFile *db, const char *tab, uint32_t ip4, IP4Set *set)
+{
+   int       o, n;
+   char      name[8];
+   uint32_t *keys;
+   uint32_t *vals;
+   IP4Pack   pack;
+   IP4Set   *sortedIP4Sets;
+
+   snprintf(name, sizeof(name), "%sk", tab);
+   if (keys = getDBSection(db, name, sizeof(uint32_t), &n))
+   {
+      snprintf(name, sizeof(name), "%sv", tab);
+      if ((vals = getDBSection(db, name, sizeof(uint32_t), &o)) && o == n)
+      {
+         if ((o = predecessorIP4Search(ip4, keys, n)) < 0 || vals[o] == 0)
+            return -1;
+
+         set->lo = keys[o];
+         set->hi = (o < n-1) ? keys[o+1] - 1 : UINT32_MAX;
+         set->cc = (*tab == 's') ? 0 : vals[o];
+         set->id = (*tab == 's') ? vals[o] : 0;
+         return o;
+      }
+   }
+
+   snprintf(name, sizeof(name), "%sp", tab);
+   if (openIP4Pack(db, name, &pack))
+      return searchIP4Pack(ip4, &pack, set);
+
+   if ((sortedIP4Sets = getDBSection(db, tab, sizeof(IP4Set), &n)) == NULL)
+      return -2;
+
+   if ((o = bisectionIP4Search(ip4, sortedIP4Sets, n)) >= 0)
+      *set = sortedIP4Sets[o];
+   return o;
+}
+
+static int lookupIP6Set(DBFile *db, const char *tab, uint128t ip6, IP6Set *set)
+{
+   int       o, n;
+   char      name[8];
+   uint128t *keys;
+   uint32_t *vals;
+   IP6Pack   pack;
+   IP6Set   *sortedIP6Sets;
+
+   snprintf(name, sizeof(name), "%sk", tab);
+   if (keys = getDBSection(db, name, sizeof(uint128t), &n))
+   {
+      snprintf(name, sizeof(name), "%sv", tab);
+      if ((vals = getDBSection(db, name, sizeof(uint32_t), &o)) && o == n)
+      {
+         if ((o = predecessorIP6Search(ip6, keys, n)) < 0 || vals[o] == 0)
+            return -1;
+
+         set->lo = keys[o];
+         set->hi = (o < n-1) ? sub_u128(keys[o+1], u64_to_u128t(1)) : sub_u128(u64_to_u128t(0), u64_to_u128t(1));
+         set->cc = (*tab == 's') ? 0 : vals[o];
+         set->id = (*tab == 's') ? vals[o] : 0;
+         return o;
+      }
+   }
+
+   snprintf(name, sizeof(name), "%sp", tab);
+   if (openIP6Pack(db, name, &pack))
+      return searchIP6Pack(ip6, &pack, set);
+
+   if ((sortedIP6Sets = getDBSection(db, tab, sizeof(IP6Set), &n)) == NULL)
+      return -2;
+
+   if ((o = bisectionIP6Search(ip6, sortedIP6Sets, n)) >= 0)
+      *set = sortedIP6Sets[o];
+   return o;
+}
+
+// Looks up the country and the owner of an address by one search in the joined table j4/j6 (ipdb -j). The ranges of both
+// are the runs of adjoining rows around the found one with the same country code, or the same owner ID, respectively.
+// Returns the row number, -1 if the address is in neither table, or -2 if the joined table is missing.
+static int lookupIP4Join(DBFile *db, uint32_t ip4, IP4Set *cset, IP4Set *nset)
+{
+   int     i, k, o, n;
+   IP4Set *join;
+
+   *cset = *nset = (IP4Set){};
+   if ((join = getDBSection(db, "j4", sizeof(IP4Set), &n)) == NULL)
+      return -2;
+
+   if ((o = bisectionIP4Search(ip4, join, n)) >= 0)
+   {
+      for (i = o; i > 0 && join[i-1].hi + 1 == join[i].lo && join[i-1].cc == join[o].cc; i--);
+      for (k = o; k < n-1 && join[k].hi + 1 == join[k+1].lo && join[k+1].cc == join[o].cc; k++);
+      *cset = (IP4Set){join[i].lo, join[k].hi, join[o].cc, 0};
+
+      for (i = o; i > 0 && join[i-1].hi + 1 == join[i].lo && join[i-1].id == join[o].id; i--);
+      for (k = o; k < n-1 && join[k].hi + 1 == join[k+1].lo && join[k+1].id == join[o].id; k++);
+      *nset = (IP4Set){join[i].lo, join[k].hi, 0, join[o].id};
+   }
+
+   return o;
+}
+
+static int lookupIP6Join(DBFile *db, uint128t ip6, IP6Set *cset, IP6Set *nset)
+{
+   int     i, k, o, n;
+   IP6Set *join;
+
+   *cset = *nset = (IP6Set){};
+   if ((join = getDBSection(db, "j6", sizeof(IP6Set), &n)) == NULL)
+      return -2;
+
+   if ((o = bisectionIP6Search(ip6, join, n)) >= 0)
+   {
+      for (i = o; i > 0 && eq_u128(add_u128(join[i-1].hi, u64_to_u128t(1)), join[i].lo) && join[i-1].cc == join[o].cc; i--);
+      for (k = o; k < n-1 && eq_u128(add_u128(join[k].hi, u64_to_u128t(1)), join[k+1].lo) && join[k+1].cc == join[o].cc; k++);
+      *cset = (IP6Set){join[i].lo, join[k].hi, join[o].cc, 0};
+
+      for (i = o; i > 0 && eq_u128(add_u128(join[i-1].hi, u64_to_u128t(1)), join[i].lo) && join[i-1].id == join[o].id; i--);
+      for (k = o; k < n-1 && eq_u128(add_u128(join[k].hi, u64_to_u128t(1)), join[k+1].lo) && join[k+1].id == join[o].id; k++);
+      *nset = (IP6Set){join[i].lo, join[k].hi, 0, join[o].id};
+   }
+
+   return o;
+}
+
+
+// Decompose the range [ip, hi] into aligned blocks of maximal size and append these to the list.
+static boolean decomposeIP4Range(CIDR4List *list, uint32_t ip, uint32_t hi, int64_t val)
+{
+   uint32_t last;
+   int32_t  m;
+   CIDR4   *cidr;
+
+   do
+   {
+      m = cidrIP4(ip, hi);
+
+      if (!(cidr = newCIDR4(list)))
+      {
+         printf("Not enough memory.\n\n");
+         return false;
+      }
+
+      cidr->ip  = ip;
+      cidr->m   = m;
+      cidr->val = val;
+   }
+   while ((last = ip + (uint32_t)(((uint64_t)1<<m) - 1)) < hi && (ip = last + 1, true));
+
+   return true;
+}
+
+static boolean decomposeIP6Range(CIDR6List *list, uint128t ip, uint128t hi, int64_t val)
+{
+   uint128t last;
+   int32_t  m;
+   CIDR6   *cidr;
+
+   do
+   {
+      m = cidrIP6(ip, hi);
+
+      if (!(cidr = newCIDR6(list)))
+      {
+         printf("Not enough memory.\n\n");
+         return false;
+      }
+
+      cidr->ip  = ip;
+      cidr->m   = m;
+      cidr->val = val;
+   }
+   while (lt_u128(last = add_u128(ip, v6[m].number), hi) && (ip = add_u128(last, u64_to_u128t(1)), true));
+
+   return true;
+}
+
+// Number of address/masklen pairs of the range [ip, hi], for the aggregation report.
+static int countIP4CIDRs(uint32_t ip, uint32_t hi)
+{
+   int32_t  m, n = 0;
+   uint32_t last;
+
+   do
+      m = cidrIP4(ip, hi), n++;
+   while ((last = ip + (uint32_t)(((uint64_t)1<<m) - 1)) < hi && (ip = last + 1, true));
+
+   return n;
+}
+
+static int countIP6CIDRs(uint128t ip, uint128t hi)
+{
+   int32_t  m, n = 0;
+   uint128t last;
+
+   do
+      m = cidrIP6(ip, hi), n++;
+   while (lt_u128(last = add_u128(ip, v6[m].number), hi) && (ip = add_u128(last, u64_to_u128t(1)), true));
+
+   return n;
+}
+
+
+// Append the address/masklen pairs of the selected ranges of a table to the list. In aggregation mode (-a), the selected
+// ranges which are adjacent or overlap and have the same table value are merged before decomposition, so that adjacent
+// countries or owners result in fewer and larger blocks. In plain mode the values are not output and are not distinguished.
+boolean appendIP4CIDRs(CIDR4List *list, DBFile *db, const char *tab, OwnerValues *owners, Selection *sel)
+{
+   int     i, j, m, n;
+   IP4Set *sortedIP4Sets = getDBSection(db, tab, sizeof(IP4Set), &n);
+
+   if (sortedIP4Sets)
+   {
+      uint32_t *rows = selectedRows(db, tab, n, owners, sel, &m);
+      boolean  open = false, ok = true;
+      uint32_t lo = 0, hi = 0;
+      int64_t  val = 0, v;
+
+      for (j = 0; ok && j < ((rows) ? m : n); j++)
+      {
+         i = (rows) ? (int)rows[j] : j;
+         if ((v = (owners) ? nsoSelection(sortedIP4Sets[i].id, owners) : ccSelection(sortedIP4Sets[i].cc, sel)) != NOSEL)
+         {
+
+            if (!sel->aggrFlag)
+            {
+               ok = decomposeIP4Range(list, sortedIP4Sets[i].lo, sortedIP4Sets[i].hi, v);
+               continue;
+            }
+
+            list->u += countIP4CIDRs(sortedIP4Sets[i].lo, sortedIP4Sets[i].hi);
+
+            if (open && (v == val || sel->plainFlag) && (sortedIP4Sets[i].lo <= hi || sortedIP4Sets[i].lo - 1 == hi))
+            {
+               if (sortedIP4Sets[i].hi > hi)
+                  hi = sortedIP4Sets[i].hi;
+            }
+
+            else
+            {
+               ok = !open || decomposeIP4Range(list, lo, hi, val);
+
+               lo   = sortedIP4Sets[i].lo;
+               hi   = sortedIP4Sets[i].hi;
+               val  = v;
+               open = true;
+            }
+         }
+      }
+
+      ok = ok && (!open || decomposeIP4Range(list, lo, hi, val));
+      deallocate(VPR(rows), false);
+      return ok;
+   }
+
+   else
+   {
+      printf("IPv4 database table could not be found.\n\n");
+      return false;
+   }
+}
+
+boolean appendIP6CIDRs(CIDR6List *list, DBFile *db, const char *tab, OwnerValues *owners, Selection *sel)
+{
+   int     i, j, m, n;
+   IP6Set *sortedIP6Sets = getDBSection(db, tab, sizeof(IP6Set), &n);
+
+   if (sortedIP6Sets)
+   {
+      uint32_t *rows = selectedRows(db, tab, n, owners, sel, &m);
+      boolean  open = false, ok = true;
+      uint128t lo = u64_to_u128t(0), hi = lo;
+      int64_t  val = 0, v;
+
+      for (j = 0; ok && j < ((rows) ? m : n); j++)
+      {
+         i = (rows) ? (int)rows[j] : j;
+         if ((v = (owners) ? nsoSelection(sortedIP6Sets[i].id, owners) : ccSelection(sortedIP6Sets[i].cc, sel)) != NOSEL)
+         {
+
+            if (!sel->aggrFlag)
+            {
+               ok = decomposeIP6Range(list, sortedIP6Sets[i].lo, sortedIP6Sets[i].hi, v);
+               continue;
+            }
+
+            list->u += countIP6CIDRs(sortedIP6Sets[i].lo, sortedIP6Sets[i].hi);
+
+            if (open && (v == val || sel->plainFlag) && (le_u128(sortedIP6Sets[i].lo, hi)
+                                                     || eq_u128(sub_u128(sortedIP6Sets[i].lo, u64_to_u128t(1)), hi)))
+            {
+               if (gt_u128(sortedIP6Sets[i].hi, hi))
+                  hi = sortedIP6Sets[i].hi;
+            }
+
+            else
+            {
+               ok = !open || decomposeIP6Range(list, lo, hi, val);
+
+               lo   = sortedIP6Sets[i].lo;
+               hi   = sortedIP6Sets[i].hi;
+               val  = v;
+               open = true;
+            }
+         }
+      }
+
+      ok = ok && (!open || decomposeIP6Range(list, lo, hi, val));
+      deallocate(VPR(rows), false);
+      return ok;
+   }
+
+   else
+   {
+      printf("IPv6 database table could not be found.\n\n");
+      return false;
+   }
+}
+
+
+// op == NULL -> plain list or ipfw table construction directives, otherwise "add" or "delete" directives of the delta mode
+void printIP4CIDR(const char *op, CIDR4 *cidr, int32_t tnum, boolean plainFlag)
+{
+   IP4Str ipstr;
+
+   if (plainFlag)
+      if (op)
+         printf("%s %s/%d\n", op, ipv4_bin2str(cidr->ip, ipstr), 32 - cidr->m);
+      else
+         printf("%s/%d\n", ipv4_bin2str(cidr->ip, ipstr), 32 - cidr->m);
+
+   else if (cidr->val >= 0 && (!op || *op == 'a'))
+      printf("table %d %s %s/%d %u\n", tnum, (op) ? op : "add", ipv4_bin2str(cidr->ip, ipstr), 32 - cidr->m, (uint32_t)cidr->val);
+   else
+      printf("table %d %s %s/%d\n",    tnum, (op) ? op : "add", ipv4_bin2str(cidr->ip, ipstr), 32 - cidr->m);
+}
+
+void printIP6CIDR(const char *op, CIDR6 *cidr, int32_t tnum, boolean plainFlag)
+{
+   IP6Str ipstr;
+
+   if (plainFlag)
+      if (op)
+         printf("%s %s/%d\n", op, ipv6_bin2str(cidr->ip, ipstr), 128 - cidr->m);
+      else
+         printf("%s/%d\n", ipv6_bin2str(cidr->ip, ipstr), 128 - cidr->m);
+
+   else if (cidr->val >= 0 && (!op || *op == 'a'))
+      printf("table %d %s %s/%d %u\n", tnum, (op) ? op : "add", ipv6_bin2str(cidr->ip, ipstr), 128 - cidr->m, (uint32_t)cidr->val);
+   else
+      printf("table %d %s %s/%d\n",    tnum, (op) ? op : "add", ipv6_bin2str(cidr->ip, ipstr), 128 - cidr->m);
+}
+
+
+static inline int keyIP4CIDR(const CIDR4 *p, const CIDR4 *q)
+{
+   if (p->ip != q->ip)
+      return (p->ip < q->ip) ? -1 : 1;
+   else if (p->m != q->m)
+      return (p->m > q->m) ? -1 : 1;
+   else
+      return 0;
+}
+
+static inline int keyIP6CIDR(const CIDR6 *p, const CIDR6 *q)
+{
+   if (!eq_u128(p->ip, q->ip))
+      return (lt_u128(p->ip, q->ip)) ? -1 : 1;
+   else if (p->m != q->m)
+      return (p->m > q->m) ? -1 : 1;
+   else
+      return 0;
+}
+
+static int cmpIP4CIDR(const void *a, const void *b)
+{
+   const CIDR4 *p = a, *q = b;
+   int c = keyIP4CIDR(p, q);
+   return (c) ? c : p->seq - q->seq;
+}
+
+static int cmpIP6CIDR(const void *a, const void *b)
+{
+   const CIDR6 *p = a, *q = b;
+   int c = keyIP6CIDR(p, q);
+   return (c) ? c : p->seq - q->seq;
+}
+
+
+// Sort the list and drop duplicate address/masklen pairs. ipfw refuses adding a pair twice,
+// and therefore the table contains only the first generated one.
+void uniqueIP4CIDRs(CIDR4List *list)
+{
+   int i, k;
+
+   qsort(list->cidr, list->n, sizeof(CIDR4), cmpIP4CIDR);
+   for (i = 1, k = (list->n) ? 1 : 0; i < list->n; i++)
+      if (keyIP4CIDR(&list->cidr[k-1], &list->cidr[i]))
+         list->cidr[k++] = list->cidr[i];
+   list->n = k;
+}
+
+void uniqueIP6CIDRs(CIDR6List *list)
+{
+   int i, k;
+
+   qsort(list->cidr, list->n, sizeof(CIDR6), cmpIP6CIDR);
+   for (i = 1, k = (list->n) ? 1 : 0; i < list->n; i++)
+      if (keyIP6CIDR(&list->cidr[k-1], &list->cidr[i]))
+         list->cidr[k++] = list->cidr[i];
+   list->n = k;
+}
+
+
+// Merge pass over the sorted unique lists of the previous and the current tables. Pairs
+// which are present in only one of the lists or whose value has changed are printed as
+// delete/add directives. Returns the number of printed directives.
+int deltaIP4CIDRs(CIDR4List *prev, CIDR4List *curr, int32_t tnum, boolean plainFlag)
+{
+   int c, i = 0, j = 0, count = 0;
+
+   while (i < prev->n || j < curr->n)
+   {
+      c = (i == prev->n) ? 1 : (j == curr->n) ? -1 : keyIP4CIDR(&prev->cidr[i], &curr->cidr[j]);
+      if (c < 0)
+         printIP4CIDR("delete", &prev->cidr[i++], tnum, plainFlag), count++;
+
+      else if (c > 0)
+         printIP4CIDR("add", &curr->cidr[j++], tnum, plainFlag), count++;
+
+      else
+      {
+         if (prev->cidr[i].val != curr->cidr[j].val && !plainFlag)
+         {
+            printIP4CIDR("delete", &prev->cidr[i], tnum, plainFlag);
+            printIP4CIDR("add", &curr->cidr[j], tnum, plainFlag);
+            count += 2;
+         }
+         i++, j++;
+      }
+   }
+
+   return count;
+}
+
+int deltaIP6CIDRs(CIDR6List *prev, CIDR6List *curr, int32_t tnum, boolean plainFlag)
+{
+   int c, i = 0, j = 0, count = 0;
+
+   while (i < prev->n || j < curr->n)
+   {
+      c = (i == prev->n) ? 1 : (j == curr->n) ? -1 : keyIP6CIDR(&prev->cidr[i], &curr->cidr[j]);
+      if (c < 0)
+         printIP6CIDR("delete", &prev->cidr[i++], tnum, plainFlag), count++;
+
+      else if (c > 0)
+         printIP6CIDR("add", &curr->cidr[j++], tnum, plainFlag), count++;
+
+      else
+      {
+         if (prev->cidr[i].val != curr->cidr[j].val && !plainFlag)
+         {
+            printIP6CIDR("delete", &prev->cidr[i], tnum, plainFlag);
+            printIP6CIDR("add", &curr->cidr[j], tnum, plainFlag);
+            count += 2;
+         }
+         i++, j++;
+      }
+   }
+
+   return count;
+}
+
+#pragma mark ••• Interval Sets •••
+
+// nftables stores the selected ranges as intervals without any decomposition, but the intervals of a set or map must not
+// overlap. Therefore, of overlapping ranges in a table a later one cuts the earlier one off, as for the range start tables,
+// unless both have the same value and are merged in aggregation mode. The ranges of the countries take precedence over the
+// net segments of the owners, like in the ipfw tables, where the pairs of the countries are added first and the segments
+// of the owners are mostly congruent with them.
+
+// Append a range in the order of the rows of a table, which may overlap the preceding range.
+static boolean appendIP4Range(Range4List *list, uint32_t lo, uint32_t hi, int64_t val, boolean aggregate)
+{
+   Range4 *r;
+
+   if (list->n && ((r = &list->range[list->n-1])->hi >= lo || r->hi + 1 == lo))
+   {
+      if (aggregate && r->val == val)
+      {
+         if (hi > r->hi)
+            r->hi = hi;
+         return true;
+      }
+
+      else if (r->hi >= lo)
+         if (r->lo == lo)
+            list->n--;
+         else
+            r->hi = lo - 1;
+   }
+
+   if (!(r = newRange4(list)))
+   {
+      printf("Not enough memory.\n\n");
+      return false;
+   }
+
+   r->lo  = lo;
+   r->hi  = hi;
+   r->val = val;
+   return true;
+}
+
+static boolean appendIP6Range(Range6List *list, uint128t lo, uint128t hi, int64_t val, boolean aggregate)
+{
+   Range6 *r;
+
+   if (list->n && (ge_u128((r = &list->range[list->n-1])->hi, lo) || eq_u128(add_u128(r->hi, u64_to_u128t(1)), lo)))
+   {
+      if (aggregate && r->val == val)
+      {
+         if (gt_u128(hi, r->hi))
+            r->hi = hi;
+         return true;
+      }
+
+      else if (ge_u128(r->hi, lo))
+         if (eq_u128(r->lo, lo))
+            list->n--;
+         else
+            r->hi = sub_u128(lo, u64_to_u128t(1));
+   }
+
+   if (!(r = newRange6(list)))
+   {
+      printf("Not enough memory.\n\n");
+      return false;
+   }
+
+   r->lo  = lo;
+   r->hi  = hi;
+   r->val = val;
+   return true;
+}
+
+static boolean collectIP4Ranges(Range4List *list, DBFile *db, const char *tab, OwnerValues *owners, Selection *sel)
+{
+   int     i, j, m, n;
+   IP4Set *sortedIP4Sets = getDBSection(db, tab, sizeof(IP4Set), &n);
+
+   if (sortedIP4Sets)
+   {
+      uint32_t *rows = selectedRows(db, tab, n, owners, sel, &m);
+      boolean   ok = true;
+      int64_t   v;
+
+      for (j = 0; ok && j < ((rows) ? m : n); j++)
+      {
+         i = (rows) ? (int)rows[j] : j;
+         if ((v = (owners) ? nsoSelection(sortedIP4Sets[i].id, owners) : ccSelection(sortedIP4Sets[i].cc, sel)) != NOSEL)
+            ok = appendIP4Range(list, sortedIP4Sets[i].lo, sortedIP4Sets[i].hi, v, sel->aggrFlag);
+      }
+
+      deallocate(VPR(rows), false);
+      return ok;
+   }
+
+   else
+   {
+      printf("IPv4 database table could not be found.\n\n");
+      return false;
+   }
+}
+
+static boolean collectIP6Ranges(Range6List *list, DBFile *db, const char *tab, OwnerValues *owners, Selection *sel)
+{
+   int     i, j, m, n;
+   IP6Set *sortedIP6Sets = getDBSection(db, tab, sizeof(IP6Set), &n);
+
+   if (sortedIP6Sets)
+   {
+      uint32_t *rows = selectedRows(db, tab, n, owners, sel, &m);
+      boolean   ok = true;
+      int64_t   v;
+
+      for (j = 0; ok && j < ((rows) ? m : n); j++)
+      {
+         i = (rows) ? (int)rows[j] : j;
+         if ((v = (owners) ? nsoSelection(sortedIP6Sets[i].id, owners) : ccSelection(sortedIP6Sets[i].cc, sel)) != NOSEL)
+            ok = appendIP6Range(list, sortedIP6Sets[i].lo, sortedIP6Sets[i].hi, v, sel->aggrFlag);
+      }
+
+      deallocate(VPR(rows), false);
+      return ok;
+   }
+
+   else
+   {
+      printf("IPv6 database table could not be found.\n\n");
+      return false;
+   }
+}
+
+
+// Append a range in ascending order, which does not overlap the preceding range.
+static boolean putIP4Range(Range4List *list, uint32_t lo, uint32_t hi, int64_t val, boolean aggregate)
+{
+   Range4 *r;
+
+   if (aggregate && list->n && (r = &list->range[list->n-1])->val == val && r->hi + 1 == lo)
+      r->hi = hi;
+
+   else if (r = newRange4(list))
+      r->lo = lo, r->hi = hi, r->val = val;
+
+   else
+   {
+      printf("Not enough memory.\n\n");
+      return false;
+   }
+
+   return true;
+}
+
+static boolean putIP6Range(Range6List *list, uint128t lo, uint128t hi, int64_t val, boolean aggregate)
+{
+   Range6 *r;
+
+   if (aggregate && list->n && (r = &list->range[list->n-1])->val == val && eq_u128(add_u128(r->hi, u64_to_u128t(1)), lo))
+      r->hi = hi;
+
+   else if (r = newRange6(list))
+      r->lo = lo, r->hi = hi, r->val = val;
+
+   else
+   {
+      printf("Not enough memory.\n\n");
+      return false;
+   }
+
+   return true;
+}
+
+
+#pragma mark ••• Range Set Algebra •••
+
+// Operators on sorted lists of disjoint ranges, each of which is a single merge pass over its operands. The ranges of the
+// result carry the values of the left operand, and of the union, the left operand takes precedence where both overlap.
+
+// out = a - b
+boolean subtractIP4Ranges(Range4List *out, Range4List *a, Range4List *b, boolean aggregate)
+{
+   int      i, j, k;
+   uint32_t lo;
+   boolean  covered;
+
+   for (i = j = 0; i < a->n; i++)
+   {
+      Range4 *r = &a->range[i];
+
+      for (lo = r->lo; j < b->n && b->range[j].hi < lo; j++);
+      for (covered = false, k = j; !covered && k < b->n && b->range[k].lo <= r->hi; k++)
+      {
+         if (b->range[k].lo > lo && !putIP4Range(out, lo, b->range[k].lo - 1, r->val, aggregate))
+            return false;
+
+         if (!(covered = b->range[k].hi >= r->hi))
+            lo = b->range[k].hi + 1;
+      }
+
+      if (!covered && !putIP4Range(out, lo, r->hi, r->val, aggregate))
+         return false;
+   }
+
+   return true;
+}
+
+boolean subtractIP6Ranges(Range6List *out, Range6List *a, Range6List *b, boolean aggregate)
+{
+   int      i, j, k;
+   uint128t lo;
+   boolean  covered;
+
+   for (i = j = 0; i < a->n; i++)
+   {
+      Range6 *r = &a->range[i];
+
+      for (lo = r->lo; j < b->n && lt_u128(b->range[j].hi, lo); j++);
+      for (covered = false, k = j; !covered && k < b->n && le_u128(b->range[k].lo, r->hi); k++)
+      {
+         if (gt_u128(b->range[k].lo, lo) && !putIP6Range(out, lo, sub_u128(b->range[k].lo, u64_to_u128t(1)), r->val, aggregate))
+            return false;
+
+         if (!(covered = ge_u128(b->range[k].hi, r->hi)))
+            lo = add_u128(b->range[k].hi, u64_to_u128t(1));
+      }
+
+      if (!covered && !putIP6Range(out, lo, r->hi, r->val, aggregate))
+         return false;
+   }
+
+   return true;
+}
+
+// out = a & b
+boolean intersectIP4Ranges(Range4List *out, Range4List *a, Range4List *b, boolean aggregate)
+{
+   int      i, j;
+   uint32_t lo, hi;
+
+   for (i = j = 0; i < a->n && j < b->n;)
+   {
+      lo = (a->range[i].lo > b->range[j].lo) ? a->range[i].lo : b->range[j].lo;
+      hi = (a->range[i].hi < b->range[j].hi) ? a->range[i].hi : b->range[j].hi;
+      if (lo <= hi && !putIP4Range(out, lo, hi, a->range[i].val, aggregate))
+         return false;
+
+      if (a->range[i].hi < b->range[j].hi)
+         i++;
+      else
+         j++;
+   }
+
+   return true;
+}
+
+boolean intersectIP6Ranges(Range6List *out, Range6List *a, Range6List *b, boolean aggregate)
+{
+   int      i, j;
+   uint128t lo, hi;
+
+   for (i = j = 0; i < a->n && j < b->n;)
+   {
+      lo = (gt_u128(a->range[i].lo, b->range[j].lo)) ? a->range[i].lo : b->range[j].lo;
+      hi = (lt_u128(a->range[i].hi, b->range[j].hi)) ? a->range[i].hi : b->range[j].hi;
+      if (le_u128(lo, hi) && !putIP6Range(out, lo, hi, a->range[i].val, aggregate))
+         return false;
+
+      if (lt_u128(a->range[i].hi, b->range[j].hi))
+         i++;
+      else
+         j++;
+   }
+
+   return true;
+}
+
+// out = a + b, i.e. a merged with b - a
+boolean uniteIP4Ranges(Range4List *out, Range4List *a, Range4List *b, boolean aggregate)
+{
+   int        i, j;
+   Range4     *r;
+   Range4List d = {};
+   boolean    ok = subtractIP4Ranges(&d, b, a, false);
+
+   for (i = j = 0; ok && (i < a->n || j < d.n);)
+   {
+      r = (j == d.n || i < a->n && a->range[i].lo < d.range[j].lo) ? &a->range[i++] : &d.range[j++];
+      ok = putIP4Range(out, r->lo, r->hi, r->val, aggregate);
+   }
+
+   deallocate(VPR(d.range), false);
+   return ok;
+}
+
+boolean uniteIP6Ranges(Range6List *out, Range6List *a, Range6List *b, boolean aggregate)
+{
+   int        i, j;
+   Range6     *r;
+   Range6List d = {};
+   boolean    ok = subtractIP6Ranges(&d, b, a, false);
+
+   for (i = j = 0; ok && (i < a->n || j < d.n);)
+   {
+      r = (j == d.n || i < a->n && lt_u128(a->range[i].lo, d.range[j].lo)) ? &a->range[i++] : &d.range[j++];
+      ok = putIP6Range(out, r->lo, r->hi, r->val, aggregate);
+   }
+
+   deallocate(VPR(d.range), false);
+   return ok;
+}
+
+// out = ~a, the gaps of a, with the given value
+boolean complementIP4Ranges(Range4List *out, Range4List *a, int64_t val)
+{
+   int      i;
+   uint32_t lo = 0;
+
+   for (i = 0; i < a->n; i++)
+   {
+      if (a->range[i].lo > lo && !putIP4Range(out, lo, a->range[i].lo - 1, val, false))
+         return false;
+
+      if (a->range[i].hi == UINT32_MAX)
+         return true;
+      lo = a->range[i].hi + 1;
+   }
+
+   return putIP4Range(out, lo, UINT32_MAX, val, false);
+}
+
+boolean complementIP6Ranges(Range6List *out, Range6List *a, int64_t val)
+{
+   int      i;
+   uint128t lo = u64_to_u128t(0), top = sub_u128(lo, u64_to_u128t(1));
+
+   for (i = 0; i < a->n; i++)
+   {
+      if (gt_u128(a->range[i].lo, lo) && !putIP6Range(out, lo, sub_u128(a->range[i].lo, u64_to_u128t(1)), val, false))
+         return false;
+
+      if (eq_u128(a->range[i].hi, top))
+         return true;
+      lo = add_u128(a->range[i].hi, u64_to_u128t(1));
+   }
+
+   return putIP6Range(out, lo, top, val, false);
+}
+
+
+// Sweep over the disjoint ranges of the country and the owner tables, the former taking precedence.
+boolean overlayIP4Ranges(Range4List *list, DBFile *db, OwnerValues *owners, Selection *sel)
+{
+   Range4List tr = {}, br = {};   // top and bottom layer
+   boolean    ok = collectIP4Ranges(&tr, db, "v4", NULL, sel) && collectIP4Ranges(&br, db, "s4", owners, sel)
+                && uniteIP4Ranges(list, &tr, &br, sel->aggrFlag);
+
+   deallocate_batch(false, VPR(br.range), VPR(tr.range), NULL);
+   return ok;
+}
+
+boolean overlayIP6Ranges(Range6List *list, DBFile *db, OwnerValues *owners, Selection *sel)
+{
+   Range6List tr = {}, br = {};
+   boolean    ok = collectIP6Ranges(&tr, db, "v6", NULL, sel) && collectIP6Ranges(&br, db, "s6", owners, sel)
+                && uniteIP6Ranges(list, &tr, &br, sel->aggrFlag);
+
+   deallocate_batch(false, VPR(br.range), VPR(tr.range), NULL);
+   return ok;
+}
+
+
+#pragma mark ••• Selection Expressions •••
+
+// A selection expression (-e) combines sets of ranges of countries and owners by the operators of the range set algebra:
+//    expr   := term {('+' | '-') term}       union and difference
+//    term   := factor {'&' factor}           intersection
+//    factor := '~' factor | '(' expr ')' | operand
+//    operand:= CC['=' value] | NSo['=' value]
+// e.g. -e "(DE + FR + AT=10100) & ~e162e4f7de39433ca9ff03b85c4caae3". Each distinct operand
+// is a leaf, whose ranges are collected from the v and s tables in one pass, and the expression is then evaluated bottom-up.
+
+static int parseSum(Expr *ex, char **s, Selection *sel);
+
+static int exprNode(Expr *ex, char op, int l, int r)
+{
+   if (ex->n == EXPR_NODES)
+      return -1;
+
+   ex->node[ex->n] = (ExprNode){op, l, r, -1};
+   return ex->n++;
+}
+
+static int parseOperand(Expr *ex, char **s, Selection *sel)
+{
+   char     *name = *s, c;
+   int       k, leaf = -1, nl;
+   uint32_t  val = 0;
+   NSONode  *nsn;
+
+   for (nl = 0; 'a' <= (c = name[nl]) && c <= 'z' || 'A' <= c && c <= 'Z' || '0' <= c && c <= '9' || c == '_'; nl++);
+   if (!nl || ex->leaves == EXPR_NODES || (k = exprNode(ex, 0, -1, -1)) < 0)
+      return -1;
+
+   *s += nl;
+   if (**s == '=')
+   {
+      val = (uint32_t)strtoul(*s + 1, s, 10);
+      ex->valued = ex->valued || val != 0;
+   }
+
+   if (nl == 2)
+   {
+      uint32_t cc = 0, k;
+      memcpy(&cc, uppercase(name, 2), 2);
+      if ((k = ccKey(cc)) == ccTableSize)
+         return -1;
+
+      if ((leaf = ex->ccleaf[k]) < 0)
+      {
+         ex->ccleaf[k] = leaf = ex->leaves++;
+         ex->leafval[leaf] = ccValue(&(CCNode){.val = val}, cc16(&cc), sel);
+      }
+   }
+
+   else
+   {
+      c = name[nl], name[nl] = '\0';
+      if (nsn = findNSO(ex->owners, name))
+         leaf = nsn->val - 1;
+      else
+      {
+         storeNSO(ex->owners, name, nl, (leaf = ex->leaves++) + 1);
+         ex->leafval[leaf] = nsoValue(&(NSONode){.val = val}, sel);
+      }
+      name[nl] = c;
+   }
+
+   ex->node[k].leaf = leaf;
+   return k;
+}
+
+static int parseFactor(Expr *ex, char **s, Selection *sel)
+{
+   int k;
+
+   *s += blanklen(*s);
+   if (**s == '~')
+   {
+      (*s)++;
+      return ((k = parseFactor(ex, s, sel)) < 0) ? -1 : exprNode(ex, '~', k, -1);
+   }
+
+   else if (**s == '(')
+   {
+      (*s)++;
+      if ((k = parseSum(ex, s, sel)) < 0 || *(*s += blanklen(*s)) != ')')
+         return -1;
+      (*s)++;
+      return k;
+   }
+
+   else
+      return parseOperand(ex, s, sel);
+}
+
+static int parseTerm(Expr *ex, char **s, Selection *sel)
+{
+   int k, r;
+
+   if ((k = parseFactor(ex, s, sel)) < 0)
+      return -1;
+
+   while (*(*s += blanklen(*s)) == '&')
+   {
+      (*s)++;
+      if ((r = parseFactor(ex, s, sel)) < 0 || (k = exprNode(ex, '&', k, r)) < 0)
+         return -1;
+   }
+
+   return k;
+}
+
+static int parseSum(Expr *ex, char **s, Selection *sel)
+{
+   int  k, r;
+   char op;
+
+   if ((k = parseTerm(ex, s, sel)) < 0)
+      return -1;
+
+   while ((op = *(*s += blanklen(*s))) == '+' || op == '-')
+   {
+      (*s)++;
+      if ((r = parseTerm(ex, s, sel)) < 0 || (k = exprNode(ex, op, k, r)) < 0)
+         return -1;
+   }
+
+   return k;
+}
+
+// Returns the parsed expression, or NULL, in which case *s points to the position of the syntax error.
+Expr *parseExpr(char **s, Selection *sel)
+{
+   Expr *ex;
+
+   if (ex = allocate(sizeof(Expr), default_align, true))
+   {
+      memset(ex->ccleaf, 0xFF, sizeof(ex->ccleaf));
+      if ((ex->owners = createNSOTable(64)) == NULL
+       || (ex->root = parseSum(ex, s, sel)) < 0 || *(*s += blanklen(*s)) != '\0')
+      {
+         if (ex->owners)
+            releaseNSOTable(ex->owners);
+         deallocate(VPR(ex), false);
+      }
+   }
+
+   return ex;
+}
+
+void releaseExpr(Expr **ex)
+{
+   if (ex && *ex)
+   {
+      releaseNSOTable((*ex)->owners);
+      deallocate(VPR(*ex), false);
+   }
+}
+
+
+// The leaf of each owner ID of the dictionary, -1 for none.
+static int16_t *ownerLeaves(Expr *ex, NSODict *owners)
+{
+   uint32_t id;
+   NSONode *nsn;
+   int16_t *leaf;
+
+   if (leaf = allocate((owners->count + 1)*sizeof(int16_t), default_align, false))
+      for (leaf[0] = -1, id = 1; id <= owners->count; id++)
+         leaf[id] = (nsn = findNSO(ex->owners, nsoString(owners, id))) ? nsn->val - 1 : -1;
+   return leaf;
+}
+
+// The rows of the country codes of the expression in a v table, or of its owners in an s table, or NULL for a scan.
+static uint32_t *leafRows(DBFile *db, const char *tab, int n, Expr *ex, int16_t *ownleaf, uint32_t nowners, int *count)
+{
+   uint32_t *keys, *rows, id;
+   int       k = 0;
+
+   if (!(keys = allocate(((ownleaf) ? nowners + 1 : ccTableSize)*sizeof(uint32_t), default_align, false)))
+      return NULL;
+
+   if (ownleaf)
+   {
+      for (id = 0; id <= nowners; id++)
+         if (ownleaf[id] >= 0)
+            keys[k++] = id;
+   }
+
+   else
+   {
+      for (id = 0; id < ccTableSize; id++)
+         if (ex->ccleaf[id] >= 0)
+            keys[k++] = id;
+   }
+
+   rows = gatherRows(db, tab, n, keys, k, count);
+   deallocate(VPR(keys), false);
+   return rows;
+}
+
+static inline int ccLeaf(Expr *ex, uint32_t cc)
+{
+   uint32_t k = ccKey(cc);
+   return (k < ccTableSize) ? ex->ccleaf[k] : -1;
+}
+
+static boolean evalIP4Node(Range4List *out, Expr *ex, int k, Range4List leaf[], Selection *sel)
+{
+   ExprNode  *nd = &ex->node[k];
+   Range4List a = {}, b = {};
+   boolean    ok;
+   int        i;
+
+   if (!nd->op)
+      for (ok = true, i = 0; ok && i < leaf[nd->leaf].n; i++)
+         ok = putIP4Range(out, leaf[nd->leaf].range[i].lo, leaf[nd->leaf].range[i].hi, leaf[nd->leaf].range[i].val, sel->aggrFlag);
+
+   else if (nd->op == '~')
+      ok = evalIP4Node(&a, ex, nd->l, leaf, sel) && complementIP4Ranges(out, &a, (sel->tval) ? (int64_t)sel->tval : -1);
+
+   else
+      ok = evalIP4Node(&a, ex, nd->l, leaf, sel) && evalIP4Node(&b, ex, nd->r, leaf, sel)
+        && ((nd->op == '+') ? uniteIP4Ranges(out, &a, &b, sel->aggrFlag)
+          : (nd->op == '&') ? intersectIP4Ranges(out, &a, &b, sel->aggrFlag)
+                            : subtractIP4Ranges(out, &a, &b, sel->aggrFlag));
+
+   deallocate_batch(false, VPR(b.range), VPR(a.range), NULL);
+   return ok;
+}
+
+static boolean evalIP6Node(Range6List *out, Expr *ex, int k, Range6List leaf[], Selection *sel)
+{
+   ExprNode  *nd = &ex->node[k];
+   Range6List a = {}, b = {};
+   boolean    ok;
+   int        i;
+
+   if (!nd->op)
+      for (ok = true, i = 0; ok && i < leaf[nd->leaf].n; i++)
+         ok = putIP6Range(out, leaf[nd->leaf].range[i].lo, leaf[nd->leaf].range[i].hi, leaf[nd->leaf].range[i].val, sel->aggrFlag);
+
+   else if (nd->op == '~')
+      ok = evalIP6Node(&a, ex, nd->l, leaf, sel) && complementIP6Ranges(out, &a, (sel->tval) ? (int64_t)sel->tval : -1);
+
+   else
+      ok = evalIP6Node(&a, ex, nd->l, leaf, sel) && evalIP6Node(&b, ex, nd->r, leaf, sel)
+        && ((nd->op == '+') ? uniteIP6Ranges(out, &a, &b, sel->aggrFlag)
+          : (nd->op == '&') ? intersectIP6Ranges(out, &a, &b, sel->aggrFlag)
+                            : subtractIP6Ranges(out, &a, &b, sel->aggrFlag));
+
+   deallocate_batch(false, VPR(b.range), VPR(a.range), NULL);
+   return ok;
+}
+
+boolean evaluateIP4Expr(Range4List *out, Expr *ex, DBFile *db, NSODict *owners, Selection *sel)
+{
+   int         i, j, k, n, m, c;
+   boolean     ok = false;
+   uint32_t   *rows;
+   IP4Set     *sortedIP4Sets, *sortedNS4Sets;
+   Range4List *leaf = allocate(ex->leaves*sizeof(Range4List), default_align, true);
+   int16_t    *ownleaf = ownerLeaves(ex, owners);
+
+   if (!leaf || !ownleaf)
+      printf("Not enough memory.\n\n");
+
+   else if (!(sortedIP4Sets = getDBSection(db, "v4", sizeof(IP4Set), &n)) || !(sortedNS4Sets = getDBSection(db, "s4", sizeof(IP4Set), &m)))
+      printf("IPv4 database table could not be found.\n\n");
+
+   else
+   {
+      rows = leafRows(db, "v4", n, ex, NULL, 0, &c);
+      for (ok = true, j = 0; ok && j < ((rows) ? c : n); j++)
+      {
+         i = (rows) ? (int)rows[j] : j;
+         if ((k = ccLeaf(ex, sortedIP4Sets[i].cc)) >= 0)
+            ok = appendIP4Range(&leaf[k], sortedIP4Sets[i].lo, sortedIP4Sets[i].hi, ex->leafval[k], sel->aggrFlag);
+      }
+      deallocate(VPR(rows), false);
+
+      rows = leafRows(db, "s4", m, ex, ownleaf, owners->count, &c);
+      for (j = 0; ok && j < ((rows) ? c : m); j++)
+      {
+         i = (rows) ? (int)rows[j] : j;
+         if ((k = ownleaf[(sortedNS4Sets[i].id <= owners->count) ? sortedNS4Sets[i].id : 0]) >= 0)
+            ok = appendIP4Range(&leaf[k], sortedNS4Sets[i].lo, sortedNS4Sets[i].hi, ex->leafval[k], sel->aggrFlag);
+      }
+      deallocate(VPR(rows), false);
+
+      ok = ok && evalIP4Node(out, ex, ex->root, leaf, sel);
+   }
+
+   for (k = 0; leaf && k < ex->leaves; k++)
+      deallocate(VPR(leaf[k].range), false);
+   deallocate_batch(false, VPR(ownleaf), VPR(leaf), NULL);
+   return ok;
+}
+
+boolean evaluateIP6Expr(Range6List *out, Expr *ex, DBFile *db, NSODict *owners, Selection *sel)
+{
+   int         i, j, k, n, m, c;
+   boolean     ok = false;
+   uint32_t   *rows;
+   IP6Set     *sortedIP6Sets, *sortedNS6Sets;
+   Range6List *leaf = allocate(ex->leaves*sizeof(Range6List), default_align, true);
+   int16_t    *ownleaf = ownerLeaves(ex, owners);
+
+   if (!leaf || !ownleaf)
+      printf("Not enough memory.\n\n");
+
+   else if (!(sortedIP6Sets = getDBSection(db, "v6", sizeof(IP6Set), &n)) || !(sortedNS6Sets = getDBSection(db, "s6", sizeof(IP6Set), &m)))
+      printf("IPv6 database table could not be found.\n\n");
+
+   else
+   {
+      rows = leafRows(db, "v6", n, ex, NULL, 0, &c);
+      for (ok = true, j = 0; ok && j < ((rows) ? c : n); j++)
+      {
+         i = (rows) ? (int)rows[j] : j;
+         if ((k = ccLeaf(ex, sortedIP6Sets[i].cc)) >= 0)
+            ok = appendIP6Range(&leaf[k], sortedIP6Sets[i].lo, sortedIP6Sets[i].hi, ex->leafval[k], sel->aggrFlag);
+      }
+      deallocate(VPR(rows), false);
+
+      rows = leafRows(db, "s6", m, ex, ownleaf, owners->count, &c);
+      for (j = 0; ok && j < ((rows) ? c : m); j++)
+      {
+         i = (rows) ? (int)rows[j] : j;
+         if ((k = ownleaf[(sortedNS6Sets[i].id <= owners->count) ? sortedNS6Sets[i].id : 0]) >= 0)
+            ok = appendIP6Range(&leaf[k], sortedNS6Sets[i].lo, sortedNS6Sets[i].hi, ex->leafval[k], sel->aggrFlag);
+      }
+      deallocate(VPR(rows), false);
+
+      ok = ok && evalIP6Node(out, ex, ex->root, leaf, sel);
+   }
+
+   for (k = 0; leaf && k < ex->leaves; k++)
+      deallocate(VPR(leaf[k].range), false);
+   deallocate_batch(false, VPR(ownleaf), VPR(leaf), NULL);
+   return ok;
+}
+
+
+// The ranges of the selection, either of the -t list or of the -e expression.
+boolean selectIP4Ranges(Range4List *list, DBFile *db, OwnerValues *ownvals, NSODict *owners, Selection *sel)
+{
+   return (sel->expr) ? evaluateIP4Expr(list, sel->expr, db, owners, sel) : overlayIP4Ranges(list, db, ownvals, sel);
+}
+
+boolean selectIP6Ranges(Range6List *list, DBFile *db, OwnerValues *ownvals, NSODict *owners, Selection *sel)
+{
+   return (sel->expr) ? evaluateIP6Expr(list, sel->expr, db, owners, sel) : overlayIP6Ranges(list, db, ownvals, sel);
+}
+
+// The address/masklen pairs of the selection. Returns 2 if both tables could be loaded, like the pair of appendIP4CIDRs() calls.
+int selectIP4CIDRs(CIDR4List *list, DBFile *db, OwnerValues *ownvals, NSODict *owners, Selection *sel)
+{
+   if (sel->expr)
+   {
+      Range4List ranges = {};
+      int        i, n = list->n;
+      boolean    ok = evaluateIP4Expr(&ranges, sel->expr, db, owners, sel);
+
+      for (i = 0; ok && i < ranges.n; i++)
+         ok = decomposeIP4Range(list, ranges.range[i].lo, ranges.range[i].hi, ranges.range[i].val);
+      list->u += list->n - n;
+
+      deallocate(VPR(ranges.range), false);
+      return (ok) ? 2 : 0;
+   }
+
+   else
+      return appendIP4CIDRs(list, db, "v4", NULL, sel) + appendIP4CIDRs(list, db, "s4", ownvals, sel);
+}
+
+int selectIP6CIDRs(CIDR6List *list, DBFile *db, OwnerValues *ownvals, NSODict *owners, Selection *sel)
+{
+   if (sel->expr)
+   {
+      Range6List ranges = {};
+      int        i, n = list->n;
+      boolean    ok = evaluateIP6Expr(&ranges, sel->expr, db, owners, sel);
+
+      for (i = 0; ok && i < ranges.n; i++)
+         ok = decomposeIP6Range(list, ranges.range[i].lo, ranges.range[i].hi, ranges.range[i].val);
+      list->u += list->n - n;
+
+      deallocate(VPR(ranges.range), false);
+      return (ok) ? 2 : 0;
+   }
+
+   else
+      return appendIP6CIDRs(list, db, "v6", NULL, sel) + appendIP6CIDRs(list, db, "s6", ownvals, sel);
+}
+
+
+#pragma mark ••• nft Scripts •••
+
+#define NFT_BATCH 1024
+
+// Output an nft -f script which atomically replaces the elements of the interval set ipup4_<tnum> or ipup6_<tnum> in the table
+// inet ipup, or of the map of the same name with the table values as marks. Returns the number of printed elements.
+int printIP4Ranges(Range4List *list, int32_t tnum, boolean map)
+{
+   int    i;
+   IP4Str lostr, histr;
+
+   printf("add table inet ipup\n");
+   if (map)
+      printf("add map inet ipup ipup4_%d { type ipv4_addr : mark; flags interval; }\nflush map inet ipup ipup4_%d\n", tnum, tnum);
+   else
+      printf("add set inet ipup ipup4_%d { type ipv4_addr; flags interval; }\nflush set inet ipup ipup4_%d\n", tnum, tnum);
+
+   for (i = 0; i < list->n; i++)
+   {
+      if (i % NFT_BATCH == 0)
+         printf("add element inet ipup ipup4_%d {\n", tnum);
+
+      if (list->range[i].lo == list->range[i].hi)
+         printf("   %s", ipv4_bin2str(list->range[i].lo, lostr));
+      else
+         printf("   %s-%s", ipv4_bin2str(list->range[i].lo, lostr), ipv4_bin2str(list->range[i].hi, histr));
+
+      if (map)
+         printf(" : %u", (list->range[i].val >= 0) ? (uint32_t)list->range[i].val : 0);
+
+      printf((i % NFT_BATCH == NFT_BATCH-1 || i == list->n-1) ? "\n}\n" : ",\n");
+   }
+
+   return list->n;
+}
+
+int printIP6Ranges(Range6List *list, int32_t tnum, boolean map)
+{
+   int    i;
+   IP6Str lostr, histr;
+
+   printf("add table inet ipup\n");
+   if (map)
+      printf("add map inet ipup ipup6_%d { type ipv6_addr : mark; flags interval; }\nflush map inet ipup ipup6_%d\n", tnum, tnum);
+   else
+      printf("add set inet ipup ipup6_%d { type ipv6_addr; flags interval; }\nflush set inet ipup ipup6_%d\n", tnum, tnum);
+
+   for (i = 0; i < list->n; i++)
+   {
+      if (i % NFT_BATCH == 0)
+         printf("add element inet ipup ipup6_%d {\n", tnum);
+
+      if (eq_u128(list->range[i].lo, list->range[i].hi))
+         printf("   %s", ipv6_bin2str(list->range[i].lo, lostr));
+      else
+         printf("   %s-%s", ipv6_bin2str(list->range[i].lo, lostr), ipv6_bin2str(list->range[i].hi, histr));
+
+      if (map)
+         printf(" : %u", (list->range[i].val >= 0) ? (uint32_t)list->range[i].val : 0);
+
+      printf((i % NFT_BATCH == NFT_BATCH-1 || i == list->n-1) ? "\n}\n" : ",\n");
+   }
+
+   return list->n;
+}
+
+
+#pragma mark ••• ipset Batches •••
+
+#define IPSET_MAXELEM 16777216   // far more than the pairs of all delegations, only a limit, the hash grows as needed
+
+// Output an ipset restore batch, which fills the new hash:net set ipup4_<tnum>.new or ipup6_<tnum>.new with the sorted unique
+// address/masklen pairs, swaps it with the live set ipup4_<tnum> or ipup6_<tnum>, and destroys the former content. A set .new,
+// which was left over by an aborted restore, is flushed before. With marks, the sets are created with the skbinfo extension
+// and the table values are stored as skbmarks. A hash:net set cannot hold a /0, which is added as its two halves instead.
+// create -exist fails, if an existing set has other parameters, and so maxelem must not depend on the number of pairs.
+// Returns the number of added pairs.
+static int addIP4IPSet(int32_t tnum, uint32_t ip, int32_t m, int64_t val, boolean marks)
+{
+   IP4Str ipstr;
+
+   if (m == 32)
+      return addIP4IPSet(tnum, 0, 31, val, marks) + addIP4IPSet(tnum, 0x80000000, 31, val, marks);
+
+   if (marks && val >= 0)
+      printf("add ipup4_%d.new %s/%d skbmark 0x%x\n", tnum, ipv4_bin2str(ip, ipstr), 32 - m, (uint32_t)val);
+   else
+      printf("add ipup4_%d.new %s/%d\n", tnum, ipv4_bin2str(ip, ipstr), 32 - m);
+   return 1;
+}
+
+static int addIP6IPSet(int32_t tnum, uint128t ip, int32_t m, int64_t val, boolean marks)
+{
+   IP6Str ipstr;
+
+   if (m == 128)
+      return addIP6IPSet(tnum, u64_to_u128t(0), 127, val, marks) + addIP6IPSet(tnum, shl_u128(u64_to_u128t(1), 127), 127, val, marks);
+
+   if (marks && val >= 0)
+      printf("add ipup6_%d.new %s/%d skbmark 0x%x\n", tnum, ipv6_bin2str(ip, ipstr), 128 - m, (uint32_t)val);
+   else
+      printf("add ipup6_%d.new %s/%d\n", tnum, ipv6_bin2str(ip, ipstr), 128 - m);
+   return 1;
+}
+
+int printIP4IPSet(CIDR4List *list, int32_t tnum, boolean marks)
+{
+   int i, n = 0;
+
+   printf("create ipup4_%d hash:net family inet maxelem %d%s -exist\n", tnum, IPSET_MAXELEM, (marks) ? " skbinfo" : "");
+   printf("create ipup4_%d.new hash:net family inet maxelem %d%s -exist\nflush ipup4_%d.new\n", tnum, IPSET_MAXELEM, (marks) ? " skbinfo" : "", tnum);
+   for (i = 0; i < list->n; i++)
+      n += addIP4IPSet(tnum, list->cidr[i].ip, list->cidr[i].m, list->cidr[i].val, marks);
+   printf("swap ipup4_%d.new ipup4_%d\ndestroy ipup4_%d.new\n", tnum, tnum, tnum);
+
+   return n;
+}
+
+int printIP6IPSet(CIDR6List *list, int32_t tnum, boolean marks)
+{
+   int i, n = 0;
+
+   printf("create ipup6_%d hash:net family inet6 maxelem %d%s -exist\n", tnum, IPSET_MAXELEM, (marks) ? " skbinfo" : "");
+   printf("create ipup6_%d.new hash:net family inet6 maxelem %d%s -exist\nflush ipup6_%d.new\n", tnum, IPSET_MAXELEM, (marks) ? " skbinfo" : "", tnum);
+   for (i = 0; i < list->n; i++)
+      n += addIP6IPSet(tnum, list->cidr[i].ip, list->cidr[i].m, list->cidr[i].val, marks);
+   printf("swap ipup6_%d.new ipup6_%d\ndestroy ipup6_%d.new\n", tnum, tnum, tnum);
+
+   return n;
+}
+
+
+#pragma mark ••• Binary Images •••
+
+// The binary formats are images for kernel loaders, e.g. for populating an eBPF map by bulk copy. Each address family forms
+// a block of a header and the records, and the blocks of both families are written to stdout at once. The integers are in host
+// byte order, the addresses in network byte order, and pairs or ranges without a table value get the value 0.
+//   lpm:   the unique address/masklen pairs as {prefixlen, address, value}, the first 8 or 20 bytes of which
+//          are the key of a BPF_MAP_TYPE_LPM_TRIE map (struct bpf_lpm_trie_key), and the last 4 bytes its value
+//   range: the sorted and disjoint ranges as {lo, hi, value}, the same ranges as of the nft format
+typedef struct
+{
+   char     magic[4];            // "ipup"
+   uint8_t  format;              // 1 = lpm, 2 = range
+   uint8_t  family;              // 4 or 6
+   uint8_t  recsize;             // size of a record
+   uint8_t  zero;
+   uint32_t count;               // number of records
+} ImageHeader;
+
+typedef struct { uint32_t prefixlen; uint8_t addr[4];  uint32_t val; } LPM4Record;
+typedef struct { uint32_t prefixlen; uint8_t addr[16]; uint32_t val; } LPM6Record;
+typedef struct { uint8_t lo[4],  hi[4];  uint32_t val; } Range4Record;
+typedef struct { uint8_t lo[16], hi[16]; uint32_t val; } Range6Record;
+
+typedef struct
+{
+   char   *data;
+   size_t  size;
+   boolean failed;
+} Image;
+
+
+static inline void ipv4_bin2net(uint32_t bin, uint8_t net[4])
+{
+   bin = htonl(bin);
+   memcpy(net, &bin, 4);
+}
+
+static inline void ipv6_bin2net(uint128t bin, uint8_t net[16])
+{
+   IP6Desc  ipdsc = {.number = bin};
+   uint64_t quad[2];
+   quad[b2_1] = SwapInt64(ipdsc.quad[0]);
+   quad[b2_0] = SwapInt64(ipdsc.quad[1]);
+   memcpy(net, quad, 16);
+}
+
+// Append a block to the image, returns the address of its records or NULL.
+static void *appendImage(Image *img, uint8_t format, uint8_t family, uint8_t recsize, uint32_t count)
+{
+   ImageHeader hdr = {{'i', 'p', 'u', 'p'}, format, family, recsize, 0, count};
+   char       *data;
+
+   if (img->failed)
+      return NULL;
+
+   if (!(data = reallocate(img->data, img->size + sizeof(ImageHeader) + (size_t)count*recsize, false, true)))
+   {
+      img->data   = NULL;
+      img->size   = 0;
+      img->failed = true;
+      printf("Not enough memory.\n\n");
+      return NULL;
+   }
+
+   memcpy(data + img->size, &hdr, sizeof(ImageHeader));
+   img->data  = data;
+   img->size += sizeof(ImageHeader) + (size_t)count*recsize;
+   return data + img->size - (size_t)count*recsize;
+}
+
+int imageIP4CIDRs(Image *img, CIDR4List *list)
+{
+   int         i;
+   LPM4Record *rec;
+
+   if (!(rec = appendImage(img, 1, 4, sizeof(LPM4Record), list->n)))
+      return -1;
+
+   for (i = 0; i < list->n; i++)
+   {
+      rec[i].prefixlen = 32 - list->cidr[i].m;
+      ipv4_bin2net(list->cidr[i].ip, rec[i].addr);
+      rec[i].val = (list->cidr[i].val >= 0) ? (uint32_t)list->cidr[i].val : 0;
+   }
+
+   return list->n;
+}
+
+int imageIP6CIDRs(Image *img, CIDR6List *list)
+{
+   int         i;
+   LPM6Record *rec;
+
+   if (!(rec = appendImage(img, 1, 6, sizeof(LPM6Record), list->n)))
+      return -1;
+
+   for (i = 0; i < list->n; i++)
+   {
+      rec[i].prefixlen = 128 - list->cidr[i].m;
+      ipv6_bin2net(list->cidr[i].ip, rec[i].addr);
+      rec[i].val = (list->cidr[i].val >= 0) ? (uint32_t)list->cidr[i].val : 0;
+   }
+
+   return list->n;
+}
+
+int imageIP4Ranges(Image *img, Range4List *list)
+{
+   int           i;
+   Range4Record *rec;
+
+   if (!(rec = appendImage(img, 2, 4, sizeof(Range4Record), list->n)))
+      return -1;
+
+   for (i = 0; i < list->n; i++)
+   {
+      ipv4_bin2net(list->range[i].lo, rec[i].lo);
+      ipv4_bin2net(list->range[i].hi, rec[i].hi);
+      rec[i].val = (list->range[i].val >= 0) ? (uint32_t)list->range[i].val : 0;
+   }
+
+   return list->n;
+}
+
+int imageIP6Ranges(Image *img, Range6List *list)
+{
+   int           i;
+   Range6Record *rec;
+
+   if (!(rec = appendImage(img, 2, 6, sizeof(Range6Record), list->n)))
+      return -1;
+
+   for (i = 0; i < list->n; i++)
+   {
+      ipv6_bin2net(list->range[i].lo, rec[i].lo);
+      ipv6_bin2net(list->range[i].hi, rec[i].hi);
+      rec[i].val = (list->range[i].val >= 0) ? (uint32_t)list->range[i].val : 0;
+   }
+
+   return list->n;
+}
+
+// A single write, which is only repeated for the remainder if a pipe accepted less.
+boolean writeImage(Image *img)
+{
+   ssize_t n;
+   size_t  k;
+
+   fflush(stdout);
+   for (k = 0; k < img->size; k += n)
+      if ((n = write(STDOUT_FILENO, img->data + k, img->size - k)) < 0)
+         if (errno == EINTR)
+            n = 0;
+         else
+            return false;
+
+   return true;
+}
+
+
+#pragma mark ••• Summaries •••
+
+static const char *u128_to_dec(uint128t n, char dec[40])
+{
+   IP6Desc d;
+   char   *p = &dec[39];
+
+   *p = '\0';
+   do
+   {
+      d.number = rem_u128(n, u64_to_u128t(10));
+      *--p = '0' + (char)d.quad[b2_0];
+   }
+   while (gt_u128(n = div_u128(n, u64_to_u128t(10)), u64_to_u128t(0)));
+
+   return p;
+}
+
+static void printSummary(const char *name, Summary *s4, Summary *s6, boolean only4Flag, boolean only6Flag)
+{
+   IP6Desc d = {.number = s4->addrs};
+   char    dec[40];
+
+   printf("%-32s", name);
+   if (!only6Flag)
+      printf(" %8u %10llu %12llu", s4->rows, (unsigned long long)s4->cidrs, (unsigned long long)d.quad[b2_0]);
+   if (!only4Flag)
+      printf(" %8u %10llu %40s", s6->rows, (unsigned long long)s6->cidrs, u128_to_dec(s6->addrs, dec));
+   printf("\n");
+}
+
+// Print and add up the summaries of a country code or owner, either of which may be NULL, returns false if both are.
+static boolean addSummary(const char *name, Summary *s4, Summary *s6, Summary total[2], boolean only4Flag, boolean only6Flag)
+{
+   Summary none = {};
+   int     i;
+
+   if (!s4 && !s6)
+      return false;
+
+   s4 = (s4) ?: &none, s6 = (s6) ?: &none;
+   printSummary(name, s4, s6, only4Flag, only6Flag);
+
+   for (i = 0; i < 2; i++)
+   {
+      Summary *sum = (i) ? s6 : s4;
+      total[i].rows  += sum->rows;
+      total[i].cidrs += sum->cidrs;
+      total[i].addrs  = add_u128(total[i].addrs, sum->addrs);
+   }
+
+   return true;
+}
+
+// Print the numbers of rows, address/masklen pairs and addresses of the selected country codes and owners from the summaries
+// of the tables (sections v4c, v6c, s4c and s6c, see ipdb -c), together with their totals. The pairs are those which -t outputs
+// without -a, so that the size of a firewall table is known without generating it.
+boolean printSummaries(DBFile *db, OwnerValues *owners, Selection *sel, boolean only4Flag, boolean only6Flag)
+{
+   static const char *tabs[4] = {"v4c", "v6c", "s4c", "s6c"};
+
+   Summary *sums[4], total[2] = {};
+   int      counts[4], t;
+   uint32_t k;
+   char     cc[3] = {};
+
+   for (t = 0; t < 4; t++)
+      if (!(sums[t] = getDBSection(db, tabs[t], sizeof(Summary), &counts[t])))
+      {
+         printf("The summaries could not be found, the database file must be generated by 'ipdb -c'.\n\n");
+         return false;
+      }
+
+   printf("%-32s", "CC/NSo");
+   if (!only6Flag)
+      printf(" %8s %10s %12s", "v4 rows", "v4 pairs", "v4 addresses");
+   if (!only4Flag)
+      printf(" %8s %10s %40s", "v6 rows", "v6 pairs", "v6 addresses");
+   printf("\n");
+
+   // the key ccTableSize collects the rows without a proper country code, which only the empty list selects
+   for (k = 0; k <= ccTableSize; k++)
+      if ((k < ccTableSize) ? sel->ccval[k] != NOSEL : !*sel->list)
+      {
+         cc[0] = (k < ccTableSize) ? 'A' + k/26 : '?', cc[1] = (k < ccTableSize) ? 'A' + k%26 : '?';
+         addSummary(cc, (only6Flag) ? NULL : findSummary(sums[0], counts[0], k),
+                        (only4Flag) ? NULL : findSummary(sums[1], counts[1], k), total, only4Flag, only6Flag);
+      }
+
+   for (k = 1; k <= owners->count; k++)
+      if (owners->val[k] != NOSEL)
+         addSummary(nsoString(Owners, k), (only6Flag) ? NULL : findSummary(sums[2], counts[2], k),
+                                          (only4Flag) ? NULL : findSummary(sums[3], counts[3], k), total, only4Flag, only6Flag);
+
+   printSummary("total", &total[0], &total[1], only4Flag, only6Flag);
+   return true;
+}
+
+
 int main(int argc, char *argv[])
 {
    bool plainFlag = false,
         valueFlag = false,
+        aggrFlag  = false,
+        valued    = false,
         only4Flag = false,
-        only6Flag = false;
+        only6Flag = false,
+        sumFlag   = false;
 
    int32_t  ch,
             rc    = 1,
             tnum  = 0,
             toff  = 0;
    uint32_t tval  = 0;
+   Format   format = ipfwFormat;
 
    char *selList  = NULL,
-        *bstname  = "/usr/local/etc/ipdb/IPRanges/ipcc.bst",   // actually 2 files *.v4 and *.v6
+        *selExpr  = NULL,
+        *bstname  = "/usr/local/etc/ipdb/IPRanges/ipcc.bst",
+        *prvname  = NULL,
         *cmd      = argv[0],
         *lastopt  = "";
 
-   while ((ch = getopt(argc, argv, "t:n:pv:x:46r:h:q:")) != -1)
+   while ((ch = getopt(argc, argv, "t:e:n:pao:v:x:46cd:r:h:q:")) != -1)
    {
       switch (ch)
       {
@@ -114,6 +2087,10 @@ int main(int argc, char *argv[])
             selList = optarg;
             break;
 
+         case 'e':
+            selExpr = optarg;
+            break;
+
          case 'n':
             tnum = (int32_t)strtol(optarg, NULL, 10);
             if (tnum < 0 || 65534 < tnum || tnum == 0 && errno == EINVAL)
@@ -127,6 +2104,28 @@ int main(int argc, char *argv[])
             plainFlag = true;
             break;
 
+         case 'a':
+            aggrFlag = true;
+            break;
+
+         case 'o':
+            if (strcmp(optarg, "nft") == 0)
+               format = nftFormat;
+            else if (strcmp(optarg, "ipset") == 0)
+               format = ipsetFormat;
+            else if (strcmp(optarg, "lpm") == 0)
+               format = lpmFormat;
+            else if (strcmp(optarg, "range") == 0)
+               format = rangeFormat;
+            else if (strcmp(optarg, "ipfw") == 0)
+               format = ipfwFormat;
+            else
+            {
+               lastopt = optarg;
+               goto arg_err;
+            }
+            break;
+
          case 'v':
             if (valueFlag || (tval = (uint32_t)strtol(optarg, NULL, 10)) == 0 && errno == EINVAL)
             {
@@ -166,6 +2165,14 @@ int main(int argc, char *argv[])
             printf("%s encodes to %u\n", optarg, ccv(*(uint16_t *)optarg, 0));
             return 0;
 
+         case 'c':
+            sumFlag = true;
+            break;
+
+         case 'd':
+            prvname = optarg;
+            break;
+
          case 'r':
             bstname = optarg;
             break;
@@ -183,7 +2190,28 @@ int main(int argc, char *argv[])
    argc -= optind;
    argv += optind;
 
-   if (argc != 1 && !selList)
+   if (prvname && format != ipfwFormat)
+   {
+      printf("The delta mode is not available for the nft, ipset and binary formats, which replace the whole set.\n\n");
+      usage(cmd);
+      return 1;
+   }
+
+   if (selList && selExpr)
+   {
+      printf("Either a selection list (-t) or a selection expression (-e) can be given.\n\n");
+      usage(cmd);
+      return 1;
+   }
+
+   if (sumFlag && !selList)
+   {
+      printf("The summaries (-c) are given per country code and owner of a selection list (-t).\n\n");
+      usage(cmd);
+      return 1;
+   }
+
+   if (argc != 1 && !selList && !selExpr)
    {
       printf("Wrong number of arguments:\n %s, ...\n\n", argv[0]);
       usage(cmd);
@@ -191,137 +2219,75 @@ int main(int argc, char *argv[])
    }
 
 
-   int    namlen = strvlen(bstname);
-   char  *inName = strcpy(alloca(OSP(namlen+4)), bstname);
-   FILE  *in;
-   struct stat st;
+   DBFile  *db = NULL, *prev = NULL;
+   NSODict *owners;
 
    rc = 1;
 
 //
 // first usage form -- lookup the country code and the unique owner ID of the net segment for a given IPv4 or IPv6 address
 //
-   if (selList == NULL)
+   if (selList == NULL && selExpr == NULL)
    {
       int      o;
       uint32_t ipv4;
       uint128t ipv6;
-      if (ipv4 = ipv4_str2bin(argv[0]))
-      {
-         cpy4(inName+namlen, ".v4");
-         if (stat(inName, &st) == no_error && st.st_size && (in = fopen(inName, "r")))
-         {
-            IP4Str ipstr_lo, ipstr_hi;
-            IP4Set *sortedIP4Sets = allocate((ssize_t)st.st_size, default_align, false);
-            if (sortedIP4Sets)
-            {
-               if (fread(sortedIP4Sets, (ssize_t)st.st_size, 1, in))
-               {
-                  if ((o = bisectionIP4Search(ipv4, sortedIP4Sets, (int)(st.st_size/sizeof(IP4Set)))) >= 0)
-                     printf("%s -> %s - %s in %s\n", argv[0], ipv4_bin2str(sortedIP4Sets[o].lo, ipstr_lo), ipv4_bin2str(sortedIP4Sets[o].hi, ipstr_hi), (char *)&sortedIP4Sets[o].cc);
-                  else
-                     printf("%s not found.\n", argv[0]);
-                  rc = 0;
-               }
-               else
-                  printf("IPv4 database file could not be loaded.\n");
 
-               deallocate(VPR(sortedIP4Sets), false);
-            }
-            else
-               printf("Not enough memory for loading the IPv4 database.\n");
+      if ((db = openDB(bstname)) == NULL)
+         printf("Database file could not be loaded.\n");
 
-            fclose(in);
-         }
+      else if (ipv4 = ipv4_str2bin(argv[0]))
+      {
+         IP4Str  ipstr_lo, ipstr_hi;
+         IP4Set  set, seg;
+         int     j = lookupIP4Join(db, ipv4, &set, &seg);   // -2 without joined table, then one search per table
+
+         if ((o = (j != -2) ? ((set.cc) ? j : -1) : lookupIP4Set(db, "v4", ipv4, &set)) >= 0)
+            printf("%s -> %s - %s in %s\n", argv[0], ipv4_bin2str(set.lo, ipstr_lo), ipv4_bin2str(set.hi, ipstr_hi), (char *)&set.cc);
+         else if (o == -1)
+            printf("%s not found.\n", argv[0]);
          else
-            printf("IPv4 database file could not be found.\n");
+            printf("IPv4 database table could not be found.\n");
+         rc = (o == -2);
 
-         cpy4(inName+namlen, ".s4");
-         if (stat(inName, &st) == no_error && st.st_size && (in = fopen(inName, "r")))
+         if ((o = (j != -2) ? ((seg.id) ? j : -1) : lookupIP4Set(db, "s4", ipv4, &seg)) >= 0)
          {
-            IP4Str ipstr_lo, ipstr_hi;
-            IP4Set *sortedIP4Sets = allocate((ssize_t)st.st_size, default_align, false);
-            if (sortedIP4Sets)
-            {
-               if (fread(sortedIP4Sets, (ssize_t)st.st_size, 1, in))
-               {
-                  if ((o = bisectionIP4Search(ipv4, sortedIP4Sets, (int)(st.st_size/sizeof(IP4Set)))) >= 0)
-                     printf("%*snet segment %s - %s owned by %s\n", strvlen(argv[0]) - 8, " ", ipv4_bin2str(sortedIP4Sets[o].lo, ipstr_lo), ipv4_bin2str(sortedIP4Sets[o].hi, ipstr_hi), sortedIP4Sets[o].nso);
-                  else
-                     printf("%s not found.\n", argv[0]);
-                  rc = 0;
-               }
-               else
-                  printf("NSv4 database file could not be loaded.\n");
-
-               deallocate(VPR(sortedIP4Sets), false);
-            }
-            else
-               printf("Not enough memory for loading the NSv4 database.\n");
-
-            fclose(in);
+            owners = loadNSODict(db, false);
+            printf("%*snet segment %s - %s owned by %s\n", strvlen(argv[0]) - 8, " ", ipv4_bin2str(seg.lo, ipstr_lo), ipv4_bin2str(seg.hi, ipstr_hi), nsoString(owners, seg.id));
+            releaseNSODict(&owners);
          }
+         else if (o == -1)
+            printf("%s not found.\n", argv[0]);
          else
-            printf("NSv4 database file could not be found.\n");
+            printf("NSv4 database table could not be found.\n");
+         rc = rc && (o == -2);
       }
 
       else if (gt_u128(ipv6 = ipv6_str2bin(argv[0]), u64_to_u128t(0)))
       {
-         cpy4(inName+namlen, ".v6");
-         if (stat(inName, &st) == no_error && st.st_size && (in = fopen(inName, "r")))
-         {
-            IP6Str ipstr_lo, ipstr_hi;
-            IP6Set *sortedIP6Sets = allocate((ssize_t)st.st_size, default_align, false);
-            if (sortedIP6Sets)
-            {
-               if (fread(sortedIP6Sets, (ssize_t)st.st_size, 1, in))
-               {
-                  if ((o = bisectionIP6Search(ipv6, sortedIP6Sets, (int)(st.st_size/sizeof(IP6Set)))) >= 0)
-                     printf("%s -> %s - %s in %s\n", argv[0], ipv6_bin2str(sortedIP6Sets[o].lo, ipstr_lo), ipv6_bin2str(sortedIP6Sets[o].hi, ipstr_hi), (char *)&sortedIP6Sets[o].cc);
-                  else
-                     printf("%s not found.\n\n", argv[0]);
-                  rc = 0;
-               }
-               else
-                  printf("IPv6 database file could not be loaded.\n");
-
-               deallocate(VPR(sortedIP6Sets), false);
-            }
-            else
-               printf("Not enough memory for loading the IPv6 database.\n");
-
-            fclose(in);
-         }
+         IP6Str  ipstr_lo, ipstr_hi;
+         IP6Set  set, seg;
+         int     j = lookupIP6Join(db, ipv6, &set, &seg);   // -2 without joined table, then one search per table
+
+         if ((o = (j != -2) ? ((set.cc) ? j : -1) : lookupIP6Set(db, "v6", ipv6, &set)) >= 0)
+            printf("%s -> %s - %s in %s\n", argv[0], ipv6_bin2str(set.lo, ipstr_lo), ipv6_bin2str(set.hi, ipstr_hi), (char *)&set.cc);
+         else if (o == -1)
+            printf("%s not found.\n\n", argv[0]);
          else
-            printf("IPv6 database file could not be found.\n");
+            printf("IPv6 database table could not be found.\n");
+         rc = (o == -2);
 
-         cpy4(inName+namlen, ".s6");
-         if (stat(inName, &st) == no_error && st.st_size && (in = fopen(inName, "r")))
+         if ((o = (j != -2) ? ((seg.id) ? j : -1) : lookupIP6Set(db, "s6", ipv6, &seg)) >= 0)
          {
-            IP6Str ipstr_lo, ipstr_hi;
-            IP6Set *sortedIP6Sets = allocate((ssize_t)st.st_size, default_align, false);
-            if (sortedIP6Sets)
-            {
-               if (fread(sortedIP6Sets, (ssize_t)st.st_size, 1, in))
-               {
-                  if ((o = bisectionIP6Search(ipv6, sortedIP6Sets, (int)(st.st_size/sizeof(IP6Set)))) >= 0)
-                     printf("%*snet segment %s - %s owned by %s\n", strvlen(argv[0]) - 8, " ", ipv6_bin2str(sortedIP6Sets[o].lo, ipstr_lo), ipv6_bin2str(sortedIP6Sets[o].hi, ipstr_hi), sortedIP6Sets[o].nso);
-                  else
-                     printf("%s not found.\n\n", argv[0]);
-                  rc = 0;
-               }
-               else
-                  printf("NSv6 database file could not be loaded.\n");
-
-               deallocate(VPR(sortedIP6Sets), false);
-            }
-            else
-               printf("Not enough memory for loading the NSv6 database.\n");
-
-            fclose(in);
+            owners = loadNSODict(db, false);
+            printf("%*snet segment %s - %s owned by %s\n", strvlen(argv[0]) - 8, " ", ipv6_bin2str(seg.lo, ipstr_lo), ipv6_bin2str(seg.hi, ipstr_hi), nsoString(owners, seg.id));
+            releaseNSODict(&owners);
          }
+         else if (o == -1)
+            printf("%s not found.\n\n", argv[0]);
          else
-            printf("NSv6 database file could not be found.\n");
+            printf("NSv6 database table could not be found.\n");
+         rc = rc && (o == -2);
       }
 
       else
@@ -334,14 +2300,22 @@ int main(int argc, char *argv[])
 //
 // second usage form -- generate ipfw table construction directives
 //
-   else // (selList != NULL)
+   else // (selList != NULL || selExpr != NULL)
    {
-      if ((CCTable  = createCCTable())
-       && (NSOTable = createNSOTable(64)))
+      if ((db = openDB(bstname)) == NULL)
+         printf("Database file could not be loaded.\n\n");
+
+      else if (prvname && (prev = openDB(prvname)) == NULL)
+         printf("Previous database file could not be loaded.\n\n");
+
+      else if ((CCTable  = createCCTable())
+            && (NSOTable = createNSOTable(64))
+            && (Owners   = loadNSODict(db, false))
+            && (!prev || (PrevOwners = loadNSODict(prev, false))))
       {
          int count = 0;
 
-         char *sel = selList;
+         char *sel = (selList) ?: "";
          while (*sel)
          {
             int sl = collen(sel);
@@ -357,6 +2331,7 @@ int main(int argc, char *argv[])
                val = (uint32_t)strtoul(sel+vl+1, NULL, 10);
             }
 
+            valued = valued || val != 0;
             if (vl == 2)
                storeCC(CCTable, *(uint16_t *)uppercase(sel, 2), val);
             else
@@ -365,252 +2340,205 @@ int main(int argc, char *argv[])
             sel += sl;
          }
 
+         Selection   selection = {(selList) ?: "", NULL, valueFlag, tval, toff, aggrFlag, plainFlag};
+         OwnerValues currOwners = {}, prevOwners = {};
+         Image       image = {};
+         boolean     selected = true;
+
+         if (selExpr && (selection.expr = parseExpr(&selExpr, &selection)) == NULL)
+         {
+            printf("Invalid selection expression at: %s\n\n", (*selExpr) ? selExpr : "end");
+            selected = false;
+         }
+
+         else if (selExpr)
+            valued = selection.expr->valued;
+
+         compileSelection(&selection);
+         selected = selected && selectOwners(&currOwners, Owners, &selection) && (!prev || selectOwners(&prevOwners, PrevOwners, &selection));
+         valued = !plainFlag && (valued || tval || valueFlag);
+
+      //
+      // summaries instead of table generation
+      //
+         if (sumFlag)
+         {
+            rc = (selected && printSummaries(db, &currOwners, &selection, only4Flag, only6Flag)) ? 0 : 1;
+            selected = false;
+         }
+
       //
       // IPv4 table generation
       //
-         if (!only6Flag)
+         if (selected && !only6Flag && (format == nftFormat || format == rangeFormat))
+         {
+            Range4List ranges = {};
+            int        n;
+
+            if (selectIP4Ranges(&ranges, db, &currOwners, Owners, &selection)
+             && (n = (format == nftFormat) ? printIP4Ranges(&ranges, tnum, valued) : imageIP4Ranges(&image, &ranges)) >= 0)
+            {
+               count += n;
+               rc = 0;
+            }
+
+            deallocate(VPR(ranges.range), false);
+         }
+
+         else if (selected && !only6Flag)
          {
-            cpy4(inName+namlen, ".v4");
-            if (stat(inName, &st) == no_error && st.st_size && (in = fopen(inName, "r")))
+            CIDR4List curr = {}, last = {};
+            int       loaded;
+
+            loaded = selectIP4CIDRs(&curr, db, &currOwners, Owners, &selection);
+
+            if (!prev)
             {
-               CCNode *ccn = NULL;
+               if (format == ipsetFormat)
+               {
+                  uniqueIP4CIDRs(&curr);
+                  count += printIP4IPSet(&curr, tnum, valued);
+               }
 
-               IP4Str  ipstr;
-               IP4Set *sortedIP4Sets = allocate((ssize_t)st.st_size, default_align, false);
-               if (sortedIP4Sets)
+               else if (format == lpmFormat)
                {
-                  if (fread(sortedIP4Sets, (ssize_t)st.st_size, 1, in))
-                  {
-                     int i, n = (int)(st.st_size/sizeof(IP4Set));
-                     for (i = 0; i < n; i++)
-                     {
-                        if (!*selList || (ccn = findCC(CCTable, sortedIP4Sets[i].cc)))
-                        {
-                           uint32_t ip  = sortedIP4Sets[i].lo;
-                           uint32_t val = (ccn) ? ccn->val : 0;
-                           int32_t  m;
-                           do
-                           {
-                              m = intlb4_1p(sortedIP4Sets[i].hi - ip);
-                              while (ip - (ip >> m << m))
-                                 m--;
-
-                              if (plainFlag)
-                                 printf("%s/%d\n", ipv4_bin2str(ip, ipstr), 32 - m);
-                              else if (val != 0)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv4_bin2str(ip, ipstr), 32 - m, val);
-                              else if (tval != 0)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv4_bin2str(ip, ipstr), 32 - m, tval);
-                              else if (ccn && valueFlag)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv4_bin2str(ip, ipstr), 32 - m, ccv((uint16_t)sortedIP4Sets[i].cc, toff));
-                              else
-                                 printf("table %d add %s/%d\n",    tnum, ipv4_bin2str(ip, ipstr), 32 - m);
-
-                              count++;
-                           }
-                           while ((ip += (uint32_t)1<<m) < sortedIP4Sets[i].hi);
-                        }
-                     }
-
-                     rc = 0;
-                  }
-                  else
-                     printf("IPv4 database file could not be loaded.\n\n");
-
-                  deallocate(VPR(sortedIP4Sets), false);
+                  uniqueIP4CIDRs(&curr);
+                  if (imageIP4CIDRs(&image, &curr) < 0)
+                     loaded = 0;
+                  count += curr.n;
                }
+
                else
-                  printf("Not enough memory for loading the IPv4 database.\n\n");
+               {
+                  for (int i = 0; i < curr.n; i++)
+                     printIP4CIDR(NULL, &curr.cidr[i], tnum, plainFlag);
+                  count += curr.n;
+               }
 
-               fclose(in);
+               if (loaded)
+                  rc = 0;
             }
-            else
-               printf("IPv4 database file could not be found.\n\n");
 
-
-            cpy4(inName+namlen, ".s4");
-            if (stat(inName, &st) == no_error && st.st_size && (in = fopen(inName, "r")))
+            else if (loaded == 2)      // never compute a delta against incompletely loaded tables
             {
-               NSONode *nsn = NULL;
+               loaded = selectIP4CIDRs(&last, prev, &prevOwners, PrevOwners, &selection);
 
-               IP4Str  ipstr;
-               IP4Set *sortedIP4Sets = allocate((ssize_t)st.st_size, default_align, false);
-               if (sortedIP4Sets)
+               if (loaded == 2)
                {
-                  if (fread(sortedIP4Sets, (ssize_t)st.st_size, 1, in))
-                  {
-                     int i, n = (int)(st.st_size/sizeof(IP4Set));
-                     for (i = 0; i < n; i++)
-                     {
-                        if (!*selList || (nsn = findNSO(NSOTable, sortedIP4Sets[i].nso)))
-                        {
-                           uint32_t ip  = sortedIP4Sets[i].lo;
-                           uint32_t val = (nsn) ? nsn->val : 0;
-                           int32_t  m;
-                           do
-                           {
-                              m = intlb4_1p(sortedIP4Sets[i].hi - ip);
-                              while (ip - (ip >> m << m))
-                                 m--;
-
-                              if (plainFlag)
-                                 printf("%s/%d\n", ipv4_bin2str(ip, ipstr), 32 - m);
-                              else if (val != 0)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv4_bin2str(ip, ipstr), 32 - m, val);
-                              else if (tval != 0)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv4_bin2str(ip, ipstr), 32 - m, tval);
-                              else
-                                 printf("table %d add %s/%d\n",    tnum, ipv4_bin2str(ip, ipstr), 32 - m);
-
-                              count++;
-                           }
-                           while ((ip += (uint32_t)1<<m) < sortedIP4Sets[i].hi);
-                        }
-                     }
-
-                     rc = 0;
-                  }
-                  else
-                     printf("IPv4 database file could not be loaded.\n\n");
-
-                  deallocate(VPR(sortedIP4Sets), false);
+                  uniqueIP4CIDRs(&last);
+                  uniqueIP4CIDRs(&curr);
+                  count += deltaIP4CIDRs(&last, &curr, tnum, plainFlag);
+                  rc = 0;
                }
-               else
-                  printf("Not enough memory for loading the IPv4 database.\n\n");
-
-               fclose(in);
             }
-            else
-               printf("IPv4 database file could not be found.\n\n");
+
+            if (aggrFlag)
+               fprintf(stderr, "IPv4: %d address/masklen pairs aggregated to %d.\n", curr.u, curr.n);
+
+            deallocate(VPR(last.cidr), false);
+            deallocate(VPR(curr.cidr), false);
          }
 
       //
       // IPv6 table generation
       //
-         if (!only4Flag)
+         if (selected && !only4Flag && (format == nftFormat || format == rangeFormat))
+         {
+            Range6List ranges = {};
+            int        n;
+
+            if (selectIP6Ranges(&ranges, db, &currOwners, Owners, &selection)
+             && (n = (format == nftFormat) ? printIP6Ranges(&ranges, tnum, valued) : imageIP6Ranges(&image, &ranges)) >= 0)
+            {
+               count += n;
+               rc = 0;
+            }
+
+            deallocate(VPR(ranges.range), false);
+         }
+
+         else if (selected && !only4Flag)
          {
-            cpy4(inName+namlen, ".v6");
-            if (stat(inName, &st) == no_error && st.st_size && (in = fopen(inName, "r")))
+            CIDR6List curr = {}, last = {};
+            int       loaded;
+
+            loaded = selectIP6CIDRs(&curr, db, &currOwners, Owners, &selection);
+
+            if (!prev)
             {
-               CCNode *ccn = NULL;
+               if (format == ipsetFormat)
+               {
+                  uniqueIP6CIDRs(&curr);
+                  count += printIP6IPSet(&curr, tnum, valued);
+               }
 
-               IP6Str  ipstr;
-               IP6Set *sortedIP6Sets = allocate((ssize_t)st.st_size, default_align, false);
-               if (sortedIP6Sets)
+               else if (format == lpmFormat)
                {
-                  if (fread(sortedIP6Sets, (ssize_t)st.st_size, 1, in))
-                  {
-                     int i, n = (int)(st.st_size/sizeof(IP6Set));
-                     for (i = 0; i < n; i++)
-                     {
-                        if (!*selList || (ccn = findCC(CCTable, sortedIP6Sets[i].cc)))
-                        {
-                           uint128t ip = sortedIP6Sets[i].lo;
-                           uint32_t val = (ccn) ? ccn->val : 0;
-                           int32_t  m;
-                           do
-                           {
-                              m = intlb6_1p(sub_u128(sortedIP6Sets[i].hi, ip));
-                              while (gt_u128(sub_u128(ip, shl_u128(shr_u128(ip, m), m)), u64_to_u128t(0)))
-                                 m--;
-
-                              if (plainFlag)
-                                 printf("%s/%d\n", ipv6_bin2str(ip, ipstr), 128 - m);
-                              else if (val != 0)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv6_bin2str(ip, ipstr), 128 - m, val);
-                              else if (tval != 0)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv6_bin2str(ip, ipstr), 128 - m, tval);
-                              else if (ccn && valueFlag)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv6_bin2str(ip, ipstr), 128 - m, ccv(*(uint16_t*)&sortedIP6Sets[i].cc, toff));
-                              else
-                                 printf("table %d add %s/%d\n",    tnum, ipv6_bin2str(ip, ipstr), 128 - m);
-
-                              count++;
-                           }
-                           while (lt_u128(ip = add_u128(ip, shl_u128(u64_to_u128t(1), m)), sortedIP6Sets[i].hi));
-                        }
-                     }
-
-                     rc = 0;
-                  }
-                  else
-                     printf("IPv6 database file could not be loaded.\n\n");
-
-                  deallocate(VPR(sortedIP6Sets), false);
+                  uniqueIP6CIDRs(&curr);
+                  if (imageIP6CIDRs(&image, &curr) < 0)
+                     loaded = 0;
+                  count += curr.n;
                }
+
                else
-                  printf("Not enough memory for loading the IPv6 database.\n\n");
+               {
+                  for (int i = 0; i < curr.n; i++)
+                     printIP6CIDR(NULL, &curr.cidr[i], tnum, plainFlag);
+                  count += curr.n;
+               }
 
-               fclose(in);
+               if (loaded)
+                  rc = 0;
             }
-            else
-               printf("IPv6 database file could not be found.\n\n");
 
-            cpy4(inName+namlen, ".s6");
-            if (stat(inName, &st) == no_error && st.st_size && (in = fopen(inName, "r")))
+            else if (loaded == 2)      // never compute a delta against incompletely loaded tables
             {
-               NSONode *nsn = NULL;
+               loaded = selectIP6CIDRs(&last, prev, &prevOwners, PrevOwners, &selection);
 
-               IP6Str  ipstr;
-               IP6Set *sortedIP6Sets = allocate((ssize_t)st.st_size, default_align, false);
-               if (sortedIP6Sets)
+               if (loaded == 2)
                {
-                  if (fread(sortedIP6Sets, (ssize_t)st.st_size, 1, in))
-                  {
-                     int i, n = (int)(st.st_size/sizeof(IP6Set));
-                     for (i = 0; i < n; i++)
-                     {
-                        if (!*selList || (nsn = findNSO(NSOTable, sortedIP6Sets[i].nso)))
-                        {
-                           uint128t ip = sortedIP6Sets[i].lo;
-                           uint32_t val = (nsn) ? nsn->val : 0;
-                           int32_t  m;
-                           do
-                           {
-                              m = intlb6_1p(sub_u128(sortedIP6Sets[i].hi, ip));
-                              while (gt_u128(sub_u128(ip, shl_u128(shr_u128(ip, m), m)), u64_to_u128t(0)))
-                                 m--;
-
-                              if (plainFlag)
-                                 printf("%s/%d\n", ipv6_bin2str(ip, ipstr), 128 - m);
-                              else if (val != 0)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv6_bin2str(ip, ipstr), 128 - m, val);
-                              else if (tval != 0)
-                                 printf("table %d add %s/%d %u\n", tnum, ipv6_bin2str(ip, ipstr), 128 - m, tval);
-                              else
-                                 printf("table %d add %s/%d\n",    tnum, ipv6_bin2str(ip, ipstr), 128 - m);
-
-                              count++;
-                           }
-                           while (lt_u128(ip = add_u128(ip, shl_u128(u64_to_u128t(1), m)), sortedIP6Sets[i].hi));
-                        }
-                     }
-
-                     rc = 0;
-                  }
-                  else
-                     printf("IPv6 database file could not be loaded.\n\n");
-
-                  deallocate(VPR(sortedIP6Sets), false);
+                  uniqueIP6CIDRs(&last);
+                  uniqueIP6CIDRs(&curr);
+                  count += deltaIP6CIDRs(&last, &curr, tnum, plainFlag);
+                  rc = 0;
                }
-               else
-                  printf("Not enough memory for loading the IPv6 database.\n\n");
+            }
 
-               fclose(in);
+            if (aggrFlag)
+               fprintf(stderr, "IPv6: %d address/masklen pairs aggregated to %d.\n", curr.u, curr.n);
+
+            deallocate(VPR(last.cidr), false);
+            deallocate(VPR(curr.cidr), false);
+         }
+
+         if (image.data)
+         {
+            if (rc == 0 && !image.failed && !writeImage(&image))
+            {
+               fprintf(stderr, "The binary image could not be written.\n");
+               rc = 1;
             }
-            else
-               printf("IPv6 database file could not be found.\n\n");
+            deallocate(VPR(image.data), false);
          }
 
-         if (!count)
+         else if (!count && format < lpmFormat)
             printf("\n");
 
+         deallocate(VPR(prevOwners.val), false);
+         deallocate(VPR(currOwners.val), false);
+         releaseExpr(&selection.expr);
+
          releaseNSOTable(NSOTable);
          releaseCCTable(CCTable);
       }
       else
          printf("Not enough memory.\n\n");
+
+      releaseNSODict(&PrevOwners);
+      releaseNSODict(&Owners);
    }
 
+   closeDB(&prev);
+   closeDB(&db);
    return rc;
 }
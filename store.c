@@ -39,367 +39,242 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 
 #include "utils.h"
 #include "uint128t.h"
 #include "store.h"
 
 
-#pragma mark ••• AVL Tree of IPv4-Ranges •••
+#pragma mark ••• Database File •••
 
-static int balanceIP4Node(IP4Node **node)
+static const uint8_t zeroPage[DB_PAGE_SIZE] = {};
+
+DBWriter *createDB(const char *name)
 {
-   int change = 0;
-   IP4Node *o = *node;
-   IP4Node *p, *q;
+   int       len = strvlen(name);
+   DBWriter *db  = allocate(sizeof(DBWriter) + 2*(len+5), default_align, true);
 
-   if (o->B == -2)
+   if (db)
    {
-      if (p = o->L)                    // make the static analyzer happy
-         if (p->B == +1)
-         {
-            change = 1;                // double left-right rotation
-            q      = p->R;             // left rotation
-            p->R   = q->L;
-            q->L   = p;
-            o->L   = q->R;             // right rotation
-            q->R   = o;
-            o->B   = +(q->B < 0);
-            p->B   = -(q->B > 0);
-            q->B   = 0;
-            *node  = q;
-         }
-
-         else
-         {
-            change = p->B;             // single right rotation
-            o->L   = p->R;
-            p->R   = o;
-            o->B   = -(++p->B);
-            *node  = p;
-         }
-   }
+      db->name = (char *)&db[1];
+      db->temp = db->name + len+5;
+      strcpy(db->name, name);
+      strcpy(db->temp, name); cpy5(db->temp+len, ".tmp");
 
-   else if (o->B == +2)
-   {
-      if (q = o->R)                    // make the static analyzer happy
-         if (q->B == -1)
-         {
-            change = 1;                // double right-left rotation
-            p      = q->L;             // right rotation
-            q->L   = p->R;
-            p->R   = q;
-            o->R   = p->L;             // left rotation
-            p->L   = o;
-            o->B   = -(p->B > 0);
-            q->B   = +(p->B < 0);
-            p->B   = 0;
-            *node  = p;
-         }
+      if ((db->out = fopen(db->temp, "w")) != NULL
+       && fwrite(zeroPage, DB_PAGE_SIZE, 1, db->out) == 1)   // header and directory are written by commitDB()
+      {
+         db->head.magic   = DB_MAGIC;
+         db->head.version = DB_VERSION;
+         db->head.bom     = DB_BOM;
+         db->head.size    = DB_PAGE_SIZE;
+         return db;
+      }
 
-         else
-         {
-            change = q->B;             // single left rotation
-            o->R   = q->L;
-            q->L   = o;
-            o->B   = -(--q->B);
-            *node  = q;
-         }
+      abortDB(db);
    }
 
-   return change != 0;
+   return NULL;
 }
 
 
-static int pickPrevIP4Node(IP4Node **node, IP4Node **exch)
-{                                             // *exch on entry = parent node
-   IP4Node *o = *node;                        // *exch on exit  = picked previous value node
-
-   if (o->R)
+boolean beginDBSection(DBWriter *db, const char *name, uint32_t rowsize)
+{
+   if (db->head.count < DB_MAX_SECTIONS)
    {
-      *exch = o;
-      int change = -pickPrevIP4Node(&o->R, exch);
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceIP4Node(node);
-         else
-            return o->B == 0;
-      else
-         return 0;
-   }
+      uint64_t   pad  = -db->head.size & (DB_PAGE_SIZE-1);
+      DBSection *sect = &db->sect[db->head.count];
 
-   else if (o->L)
-   {
-      IP4Node *p = o->L;
-      o->L = NULL;
-      (*exch)->R = p;
-      *exch = o;
-      return p->B == 0;
+      if (pad == 0 || fwrite(zeroPage, pad, 1, db->out) == 1)
+      {
+         snprintf(sect->name, sizeof(sect->name), "%s", name);   // bounded, strmlcpy() would load 16 bytes of the name
+         sect->offset  = db->head.size += pad;
+         sect->size    = 0;
+         sect->rowsize = rowsize;
+         sect->crc     = 0;
+         db->head.count++;
+         return true;
+      }
    }
 
-   else
-   {
-      (*exch)->R = NULL;
-      *exch = o;
-      return 1;
-   }
+   return false;
 }
 
 
-static int pickNextIP4Node(IP4Node **node, IP4Node **exch)
-{                                             // *exch on entry = parent node
-   IP4Node *o = *node;                        // *exch on exit  = picked next value node
+boolean appendDBSection(DBWriter *db, const void *data, size_t size)
+{
+   DBSection *sect = &db->sect[db->head.count-1];
 
-   if (o->L)
-   {
-      *exch = o;
-      int change = +pickNextIP4Node(&o->L, exch);
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceIP4Node(node);
-         else
-            return o->B == 0;
-      else
-         return 0;
-   }
+   if (size == 0)
+      return true;
 
-   else if (o->R)
+   else if (fwrite(data, size, 1, db->out) == 1)
    {
-      IP4Node *q = o->R;
-      o->R = NULL;
-      (*exch)->L = q;
-      *exch = o;
-      return q->B == 0;
+      sect->crc        = crc32c(sect->crc, data, size);
+      sect->size      += size;
+      db->head.size   += size;
+      return true;
    }
 
    else
-   {
-      (*exch)->L = NULL;
-      *exch = o;
-      return 1;
-   }
+      return false;
 }
 
 
-IP4Node *findIP4Node(uint32_t ip, IP4Node  *node)
+boolean commitDB(DBWriter *db)
 {
-   if (node)
-   {
-      if (node->lo <= ip && ip <= node->hi)
-         return node;
+   boolean rc;
+
+   db->head.dircrc = crc32c(0, db->sect, db->head.count*sizeof(DBSection));
+   db->head.hdrcrc = crc32c(0, &db->head, offsetof(DBHeader, hdrcrc));
 
-      else if (ip < node->lo)
-         return findIP4Node(ip, node->L);
+   rc = fseek(db->out, 0, SEEK_SET) == no_error
+     && fwrite(&db->head, sizeof(DBHeader), 1, db->out) == 1
+     && fwrite(db->sect, sizeof(DBSection), db->head.count, db->out) == db->head.count;
+   rc = (fclose(db->out) == no_error) && rc;
+   db->out = NULL;
 
-      else // (ip > node->hi)
-         return findIP4Node(ip, node->R);
+   if (rc && rename(db->temp, db->name) == no_error)
+   {
+      deallocate(VPR(db), false);
+      return true;
    }
-   else
-      return NULL;
+
+   abortDB(db);
+   return false;
 }
 
 
-IP4Node *findNet4Node(uint32_t lo, uint32_t hi, uint32_t cc, char *nso, IP4Node  *node)
+void abortDB(DBWriter *db)
 {
-   if (node)
+   if (db)
    {
-      int ofs = ((cc) ? cc == node->cc : !strcmp(nso, node->nso));
-
-      if (node->lo <= lo && lo-ofs <= node->hi || node->lo <= hi+ofs && hi <= node->hi || lo <= node->lo && node->hi <= hi)
-         return node;
-
-      else if (lo < node->lo)
-         return findNet4Node(lo, hi, cc, nso, node->L);
-
-      else // ([lo|hi] > node->hi)
-         return findNet4Node(lo, hi, cc, nso, node->R);
+      if (db->out)
+         fclose(db->out);
+      unlink(db->temp);
+      deallocate(VPR(db), false);
    }
-   else
-      return NULL;
 }
 
 
-int addIP4Node(uint32_t lo, uint32_t hi, uint32_t cc, char *nso, IP4Node **node)
+DBFile *openDB(const char *name)
 {
-   IP4Node *o = *node;
-
-   if (o != NULL)
-   {
-      int change;
-
-      if (lo < o->lo)
-         change = -addIP4Node(lo, hi, cc, nso, &o->L);
+   DBFile *db = NULL;
+   void   *base;
+   int     fd;
+   struct stat st;
 
-      else if (lo > o->lo)
-         change = +addIP4Node(lo, hi, cc, nso, &o->R);
-
-      else // (lo == o->lo)               // this case must not happen !!!
-         return 0;
-
-      if (change)
-         if (abs(o->B += change) > 1)
-            return 1 - balanceIP4Node(node);
-         else
-            return o->B != 0;
-      else
-         return 0;
-   }
+   if ((fd = open(name, O_RDONLY)) < 0)
+      return NULL;
 
-   else // (o == NULL)                    // if the IP4Node is not in the tree
-   {                                      // then add it into a new leaf
-      if (o = allocate(sizeof(IP4Node), default_align, true))
+   if (fstat(fd, &st) == no_error && st.st_size >= DB_PAGE_SIZE
+    && (base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED)
+   {
+      DBHeader  *head = base;
+      DBSection *sect = (DBSection *)&head[1];
+      boolean    ok;
+      uint32_t   k;
+
+      ok = head->magic == DB_MAGIC && head->version == DB_VERSION && head->bom == DB_BOM
+        && head->size == (uint64_t)st.st_size && head->count <= DB_MAX_SECTIONS
+        && head->hdrcrc == crc32c(0, head, offsetof(DBHeader, hdrcrc))
+        && head->dircrc == crc32c(0, sect, head->count*sizeof(DBSection));
+
+      for (k = 0; ok && k < head->count; k++)
+         ok = sect[k].offset % DB_PAGE_SIZE == 0 && sect[k].offset <= head->size && sect[k].size <= head->size - sect[k].offset
+           && sect[k].rowsize && sect[k].size % sect[k].rowsize == 0
+           && sect[k].crc == crc32c(0, base + sect[k].offset, sect[k].size);
+
+      if (ok && (db = allocate(sizeof(DBFile), default_align, false)))
       {
-         o->lo = lo;
-         o->hi = hi;
-         o->cc = cc;
-         if(nso) switch(strvlen(nso))
-         {
-            default: // len < 32
-               strmlcpy(o->nso, nso, 32, NULL);
-               break;
-
-            case 32:
-               memvcpy(o->nso, nso, 32);
-               break;
-
-            case 36:
-            {
-               char *p = nso, *q = o->nso;
-                cpy8(q, p); p += 9, q += 8;
-                cpy4(q, p); p += 5, q += 4;
-                cpy4(q, p); p += 5, q += 4;
-                cpy4(q, p); p += 5, q += 4;
-               cpy12(q, p);
-               break;
-            }
-         }
-         *node = o;                       // report back the new node
-         return 1;                        // add the weight of 1 leaf onto the balance
+         db->base = base;
+         db->size = (size_t)st.st_size;
+         db->head = head;
+         db->sect = sect;
       }
-
-      return 0;                           // Out of Memory situation, nothing changed
+      else
+         munmap(base, (size_t)st.st_size);
    }
+
+   close(fd);
+   return db;
 }
 
 
-int removeIP4Node(uint32_t ip, IP4Node **node)
+DBSection *findDBSection(DBFile *db, const char *name)
 {
-   IP4Node *o = *node;
+   for (uint32_t k = 0; k < db->head->count; k++)
+      if (!strcmp(db->sect[k].name, name))
+         return &db->sect[k];
 
-   if (o != NULL)
-   {
-      int change;
+   return NULL;
+}
 
-      if (ip < o->lo)
-         change = +removeIP4Node(ip, &o->L);
 
-      else if (ip > o->lo)
-         change = -removeIP4Node(ip, &o->R);
+void *getDBSection(DBFile *db, const char *name, uint32_t rowsize, int *count)
+{
+   DBSection *sect = findDBSection(db, name);
 
-      else // (o->lo <= ip && ip <= o->lo)
-      {
-         int      b = o->B;
-         IP4Node *p = o->L;
-         IP4Node *q = o->R;
+   if (sect && sect->rowsize == rowsize)
+   {
+      *count = (int)(sect->size/rowsize);
+      return db->base + sect->offset;
+   }
 
-         if (!p || !q)
-         {
-            deallocate(VPR(*node), false);
-            *node = (p > q) ? p : q;
-            return 1;                     // remove the weight of 1 leaf from the balance
-         }
+   *count = 0;
+   return NULL;
+}
 
-         else
-         {
-            if (b == -1)
-            {
-               if (!p->R)
-               {
-                  change = +1;
-                  o      =  p;
-                  o->R   =  q;
-               }
-               else
-               {
-                  change = +pickPrevIP4Node(&p, &o);
-                  o->L   =  p;
-                  o->R   =  q;
-               }
-            }
-
-            else
-            {
-               if (!q->L)
-               {
-                  change = -1;
-                  o      =  q;
-                  o->L   =  p;
-               }
-               else
-               {
-                  change = -pickNextIP4Node(&q, &o);
-                  o->L   =  p;
-                  o->R   =  q;
-               }
-            }
-
-            o->B = b;
-            deallocate(VPR(*node), false);
-            *node = o;
-         }
-      }
 
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceIP4Node(node);
-         else
-            return o->B == 0;
-      else
-         return 0;
+boolean copyDBSection(DBWriter *db, DBFile *src, const char *name)
+{
+   DBSection *sect = findDBSection(src, name);
+
+   if (sect && beginDBSection(db, name, sect->rowsize)
+    && (sect->size == 0 || fwrite(src->base + sect->offset, sect->size, 1, db->out) == 1))
+   {
+      db->sect[db->head.count-1].size = sect->size;
+      db->sect[db->head.count-1].crc  = sect->crc;
+      db->head.size += sect->size;
+      return true;
    }
 
-   else // (o == NULL)
-      return 0;                           // not found -> recursively do nothing
+   return false;
 }
 
 
-void serializeIP4Tree(FILE *out, IP4Node *node)
+void closeDB(DBFile **db)
 {
-   if (node)
+   if (db && *db)
    {
-      if (node->L)
-         serializeIP4Tree(out, node->L);
-
-      fwrite(node, sizeof(IP4Set), 1, out);
-
-      if (node->R)
-         serializeIP4Tree(out, node->R);
+      munmap((*db)->base, (*db)->size);
+      deallocate(VPR(*db), false);
    }
 }
 
 
-void releaseIP4Tree(IP4Node *node)
-{
-   if (node)
-   {
-      if (node->L)
-         releaseIP4Tree(node->L);
+#pragma mark ••• Generic AVL Tree •••
 
-      if (node->R)
-         releaseIP4Tree(node->R);
+// The tree operations are iterative. The paths from the roots down to the nodes are kept on fixed size stacks,
+// since the height of an AVL tree is less than 1.45*log2(n+2), this is sufficient for up to 2^44 nodes.
+#define maxTreeDepth 64
 
-      deallocate(VPR(node), false);
-   }
-}
+typedef struct
+{
+   avlnode **link[maxTreeDepth];      // the links from the root down to the current node
+   int       dir[maxTreeDepth];       // the direction taken at each level, -1 = left, +1 = right
+   int       d;                       // the depth of the current node
+} avlpath;
 
+typedef int (*avlcmp)(const void *key, const avlnode *node);
 
-#pragma mark ••• AVL Tree of IPv6-Ranges •••
 
-static int balanceIP6Node(IP6Node **node)
+static int avlBalance(avlnode **node)
 {
    int change = 0;
-   IP6Node *o = *node;
-   IP6Node *p, *q;
+   avlnode *o = *node;
+   avlnode *p, *q;
 
    if (o->B == -2)
    {
@@ -459,579 +334,1625 @@ static int balanceIP6Node(IP6Node **node)
 }
 
 
-static int pickPrevIP6Node(IP6Node **node, IP6Node **exch)
-{                                             // *exch on entry = parent node
-   IP6Node *o = *node;                        // *exch on exit  = picked previous value node
-
-   if (o->R)
-   {
-      *exch = o;
-      int change = -pickPrevIP6Node(&o->R, exch);
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceIP6Node(node);
-         else
-            return o->B == 0;
-      else
-         return 0;
-   }
+// Descend to the node matching the key, or to the empty link at which a node with the key would be inserted,
+// and record the path. avlSearch() is always inlined, and so the comparison function, which is a constant at
+// each call site, gets inlined as well and the search is specialized for the key type of the tree.
+static inline __attribute__((always_inline)) avlnode **avlSearch(avlnode **node, const void *key, avlcmp cmp, avlpath *path)
+{
+   avlnode *o;
+   int      ord;
 
-   else if (o->L)
+   path->d = 0;
+   while ((o = *node) && (ord = cmp(key, o)) != 0)
    {
-      IP6Node *p = o->L;
-      o->L = NULL;
-      (*exch)->R = p;
-      *exch = o;
-      return p->B == 0;
+      path->link[path->d] = node;
+      if (ord < 0)
+         path->dir[path->d++] = -1, node = &o->L;
+      else // (ord > 0)
+         path->dir[path->d++] = +1, node = &o->R;
    }
 
-   else
-   {
-      (*exch)->R = NULL;
-      *exch = o;
-      return 1;
-   }
+   return node;
 }
 
 
-static int pickNextIP6Node(IP6Node **node, IP6Node **exch)
-{                                             // *exch on entry = parent node
-   IP6Node *o = *node;                        // *exch on exit  = picked next value node
+// Link the new node o into the empty link which was found by avlSearch(), and rebalance along the path.
+static int avlInsert(avlnode **node, avlnode *o, avlpath *path)
+{
+   int change, d = path->d;
 
-   if (o->L)
-   {
-      *exch = o;
-      int change = +pickNextIP6Node(&o->L, exch);
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceIP6Node(node);
-         else
-            return o->B == 0;
+   o->L = o->R = NULL;
+   o->B = 0;
+   *node = o;
+
+   for (change = 1; change && d--;)    // retrace the path, the subtree in direction dir[d] did grow
+      if (abs((o = *path->link[d])->B += path->dir[d]) > 1)
+         change = 1 - avlBalance(path->link[d]);
       else
-         return 0;
-   }
+         change = o->B != 0;
 
-   else if (o->R)
-   {
-      IP6Node *q = o->R;
-      o->R = NULL;
-      (*exch)->L = q;
-      *exch = o;
-      return q->B == 0;
-   }
+   return change;
+}
+
+
+// Unlink the node which was found by avlSearch(), and rebalance along the path. A node with two
+// children is replaced by its previous or next node, depending on its balance. The unlinked node
+// is returned to the caller for disposal.
+static avlnode *avlRemove(avlnode **node, avlpath *path)
+{
+   avlnode *o = *node, *p = o->L, *q = o->R;
+   int      change, d = path->d;
+
+   if (!p || !q)
+      *node = (p > q) ? p : q;
 
    else
    {
-      (*exch)->L = NULL;
-      *exch = o;
-      return 1;
+      avlnode **link;
+
+      path->link[d] = node;
+      if (o->B == -1)
+      {
+         path->dir[d++] = -1;
+         for (link = &o->L; (p = *link)->R; link = &p->R)
+            path->dir[d] = +1, path->link[d++] = link;
+         *link = p->L;
+      }
+      else
+      {
+         path->dir[d++] = +1;
+         for (link = &o->R; (p = *link)->L; link = &p->L)
+            path->dir[d] = -1, path->link[d++] = link;
+         *link = p->R;
+      }
+
+      p->L = o->L;
+      p->R = o->R;
+      p->B = o->B;
+      *node = p;
+      if (d > path->d+1)               // the link below the replaced node moved into p
+         path->link[path->d+1] = (path->dir[path->d] < 0) ? &p->L : &p->R;
    }
+
+   for (change = 1; change && d--;)    // retrace the path, the subtree in direction dir[d] did shrink
+      if (abs((p = *path->link[d])->B -= path->dir[d]) > 1)
+         change = avlBalance(path->link[d]);
+      else
+         change = p->B == 0;
+
+   return o;
 }
 
 
-IP6Node *findIP6Node(uint128t ip, IP6Node  *node)
+// In-order iteration with an explicit stack.
+typedef struct
 {
-   if (node)
-   {
-      if (le_u128(node->lo, ip) && le_u128(ip, node->hi))
-         return node;
+   avlnode *stack[maxTreeDepth];
+   avlnode *node;
+   int      s;
+} avliter;
 
-      else if (lt_u128(ip, node->lo))
-         return findIP6Node(ip, node->L);
+static inline avlnode *avlNext(avliter *it)
+{
+   avlnode *o;
+
+   for (o = it->node; o; o = o->L)
+      it->stack[it->s++] = o;
 
-      else // (gt_u128(ip, node->hi))
-         return findIP6Node(ip, node->R);
+   if (it->s)
+   {
+      o = it->stack[--it->s];
+      it->node = o->R;
    }
-   else
-      return NULL;
+
+   return o;
+}
+
+static inline avlnode *avlFirst(avliter *it, avlnode *root)
+{
+   it->node = root;
+   it->s    = 0;
+   return avlNext(it);
 }
 
 
-IP6Node *findNet6Node(uint128t lo, uint128t hi, uint32_t cc, char *nso, IP6Node  *node)
+// Release all nodes of a tree, either into the free list of the arena or by deallocation.
+static void avlRelease(avlnode *node, arena *arena)
 {
-   if (node)
-   {
-      uint128t ofs = u64_to_u128t((cc) ? cc == node->cc : !strcmp(node->nso, nso));
+   avlnode *stack[maxTreeDepth];
+   int      s = 0;
 
-      if (le_u128(node->lo, lo) && le_u128(sub_u128(lo,ofs), node->hi) || le_u128(node->lo, add_u128(hi,ofs)) && le_u128(hi, node->hi) || le_u128(lo, node->lo) && le_u128(node->hi, hi))
-         return node;
+   if (node)
+      stack[s++] = node;
 
-      else if (lt_u128(lo, node->lo))
-         return findNet6Node(lo, hi, cc, nso, node->L);
+   while (s)
+   {
+      node = stack[--s];
+      if (node->L)
+         stack[s++] = node->L;
+      if (node->R)
+         stack[s++] = node->R;
 
-      else // (gt_u128([lo|hi], node->hi))
-         return findNet6Node(lo, hi, cc, nso, node->R);
+      if (arena)
+         arenaFree(arena, node);
+      else
+         deallocate(VPR(node), false);
    }
-   else
-      return NULL;
 }
 
 
-int addIP6Node(uint128t lo, uint128t hi, uint32_t cc, char *nso, IP6Node **node)
+#pragma mark ••• Sorted Index of IPv4-Ranges •••
+
+static inline IP4Set *atIP4Index(IP4Index *index, int i)
 {
-   IP6Node *o = *node;
+   return &index->set[(i < index->gap) ? i : i + index->cap - index->count];
+}
 
-   if (o != NULL)
-   {
-      int change;
+static inline int posIP4Index(IP4Index *index, IP4Set *set)
+{
+   int i = (int)(set - index->set);
+   return (i < index->gap) ? i : i - (index->cap - index->count);
+}
 
-      if (lt_u128(lo, o->lo))
-         change = -addIP6Node(lo, hi, cc, nso, &o->L);
+// Move the gap to the index i, the ranges in between are moved over the gap.
+static void moveIP4Gap(IP4Index *index, int i)
+{
+   int w = index->cap - index->count;
 
-      else if (gt_u128(lo, o->lo))
-         change = +addIP6Node(lo, hi, cc, nso, &o->R);
+   if (i < index->gap)
+      memmove(&index->set[i + w], &index->set[i], (index->gap - i)*sizeof(IP4Set));
+   else if (i > index->gap)
+      memmove(&index->set[index->gap], &index->set[index->gap + w], (i - index->gap)*sizeof(IP4Set));
 
-      else // (eq_u128(lo, o->lo))               // this case must not happen !!!
-         return 0;
+   index->gap = i;
+}
 
-      if (change)
-         if (abs(o->B += change) > 1)
-            return 1 - balanceIP6Node(node);
-         else
-            return o->B != 0;
+// Index of the first range with a lower boundary greater than lo.
+static inline int upperIP4Bound(uint32_t lo, IP4Index *index)
+{
+   int o, p, q;
+   for (p = 0, q = index->count; p < q;)
+      if (atIP4Index(index, o = (p + q) >> 1)->lo <= lo)
+         p = o+1;
       else
-         return 0;
-   }
+         q = o;
+   return p;
+}
 
-   else // (o == NULL)                    // if the IP6Node is not in the tree
-   {                                      // then add it into a new leaf
-      if (o = allocate(sizeof(IP6Node), default_align, true))
-      {
-         o->lo = lo;
-         o->hi = hi;
-         o->cc = cc;
-         if(nso) switch(strvlen(nso))
-         {
-            default: // len < 32
-               strmlcpy(o->nso, nso, 32, NULL);
-               break;
-
-            case 32:
-               memvcpy(o->nso, nso, 32);
-               break;
-
-            case 36:
-            {
-               char *p = nso, *q = o->nso;
-                cpy8(q, p); p += 9, q += 8;
-                cpy4(q, p); p += 5, q += 4;
-                cpy4(q, p); p += 5, q += 4;
-                cpy4(q, p); p += 5, q += 4;
-               cpy12(q, p);
-               break;
-            }
-         }
-         *node = o;                       // report back the new node
-         return 1;                        // add the weight of 1 leaf onto the balance
-      }
 
-      return 0;                           // Out of Memory situation, nothing changed
-   }
+static inline boolean netIP4Overlap(IP4Set *set, uint32_t lo, uint32_t hi, uint32_t cc, uint32_t id)
+{
+   int ofs = ((cc) ? cc == set->cc : id == set->id);
+   return set->lo <= lo && lo-ofs <= set->hi || set->lo <= hi+ofs && hi <= set->hi || lo <= set->lo && set->hi <= hi;
+}
+
+// Adjacent ranges count as overlapping, if they have the same country code or, if cc is 0, the same owner ID.
+// ipdb consolidates overlapping ranges, only EU ranges are added without consolidation. So usually, only the last
+// range starting at or below lo and the next one need to be checked. Ranges further down may still contain lo, if
+// they take part in an overlap, and then these start at most index->reach below lo.
+IP4Set *findNet4Range(uint32_t lo, uint32_t hi, uint32_t cc, uint32_t id, IP4Index *index)
+{
+   int     i, p = upperIP4Bound(lo, index);
+   IP4Set *set;
+
+   for (i = (p) ? p-1 : p; i <= p && i < index->count; i++)
+      if (netIP4Overlap(set = atIP4Index(index, i), lo, hi, cc, id))
+         return set;
+
+   if (index->reach)
+      for (i = p-2; i >= 0 && lo - (set = atIP4Index(index, i))->lo - 1 <= index->reach; i--)
+         if (netIP4Overlap(set, lo, hi, cc, id))
+            return set;
+
+   return NULL;
 }
 
 
-int removeIP6Node(uint128t ip, IP6Node **node)
+int addIP4Range(uint32_t lo, uint32_t hi, uint32_t cc, uint32_t id, IP4Index *index)
 {
-   IP6Node *o = *node;
+   int     p = upperIP4Bound(lo, index);
+   IP4Set *set;
 
-   if (o != NULL)
+   if (p && atIP4Index(index, p-1)->lo == lo)   // this case must not happen !!!
+      return 0;
+
+   if (index->count == index->cap)
    {
-      int change;
+      int cap = (index->cap) ? 2*index->cap : 4096;
+      if ((set = reallocate(index->set, cap*(ssize_t)sizeof(IP4Set), false, false)) == NULL)
+         return 0;                              // Out of Memory situation, nothing changed
 
-      if (lt_u128(ip, o->lo))
-         change = +removeIP6Node(ip, &o->L);
+      index->set = set;
+      index->gap = index->count;                // the array was full, and so the gap was empty
+      index->cap = cap;
+   }
 
-      else if (gt_u128(ip, o->lo))
-         change = -removeIP6Node(ip, &o->R);
+   uint32_t w = hi - lo;
+   if (p && (set = atIP4Index(index, p-1))->hi >= lo && set->hi - set->lo > w)
+      w = set->hi - set->lo;
+   if (p && set->hi >= lo || p < index->count && atIP4Index(index, p)->lo <= hi)
+      if (index->reach < w)                     // an overlap, the longer of the two ranges must be seen from
+         index->reach = w;                      // the ranges behind it, see findNet4Range()
+
+   moveIP4Gap(index, p);
+   set = memset(&index->set[index->gap++], 0, sizeof(IP4Set));
+   set->lo = lo;
+   set->hi = hi;
+   set->cc = cc;
+   set->id = id;
+   index->count++;
+   return 1;
+}
 
-      else // (le_u128(o->lo, ip) && le_u128(ip, o->lo))
-      {
-         int      b = o->B;
-         IP6Node *p = o->L;
-         IP6Node *q = o->R;
 
-         if (!p || !q)
-         {
-            deallocate(VPR(*node), false);
-            *node = (p > q) ? p : q;
-            return 1;                     // remove the weight of 1 leaf from the balance
-         }
+void removeIP4Range(IP4Set *set, IP4Index *index)
+{
+   moveIP4Gap(index, posIP4Index(index, set));
+   index->count--;                              // the range after the gap becomes part of the gap
+}
 
-         else
-         {
-            if (b == -1)
-            {
-               if (!p->R)
-               {
-                  change = +1;
-                  o      =  p;
-                  o->R   =  q;
-               }
-               else
-               {
-                  change = +pickPrevIP6Node(&p, &o);
-                  o->L   =  p;
-                  o->R   =  q;
-               }
-            }
-
-            else
-            {
-               if (!q->L)
-               {
-                  change = -1;
-                  o      =  q;
-                  o->L   =  p;
-               }
-               else
-               {
-                  change = -pickNextIP6Node(&q, &o);
-                  o->L   =  p;
-                  o->R   =  q;
-               }
-            }
-
-            o->B = b;
-            deallocate(VPR(*node), false);
-            *node = o;
-         }
-      }
 
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceIP6Node(node);
-         else
-            return o->B == 0;
-      else
-         return 0;
-   }
+boolean serializeIP4Index(DBWriter *db, IP4Index *index)
+{
+   return appendDBSection(db, index->set, index->gap*sizeof(IP4Set))
+       && appendDBSection(db, &index->set[index->gap + index->cap - index->count], (index->count - index->gap)*sizeof(IP4Set));
+}
+
 
-   else // (o == NULL)
-      return 0;                           // not found -> recursively do nothing
+int collectIP4Index(IP4Index *index, IP4Set sets[])
+{
+   if (index->gap)
+      memcpy(sets, index->set, index->gap*sizeof(IP4Set));
+   if (index->count > index->gap)
+      memcpy(&sets[index->gap], &index->set[index->gap + index->cap - index->count], (index->count - index->gap)*sizeof(IP4Set));
+   return index->count;
 }
 
 
-void serializeIP6Tree(FILE *out, IP6Node *node)
+void releaseIP4Index(IP4Index *index)
 {
-   if (node)
-   {
-      if (node->L)
-         serializeIP6Tree(out, node->L);
+   deallocate(VPR(index->set), false);
+   index->count = index->cap = index->gap = 0;
+   index->reach = 0;
+}
 
-      fwrite(node, sizeof(IP6Set), 1, out);
 
-      if (node->R)
-         serializeIP6Tree(out, node->R);
-   }
+#pragma mark ••• Sorted Index of IPv6-Ranges •••
+
+static inline IP6Set *atIP6Index(IP6Index *index, int i)
+{
+   return &index->set[(i < index->gap) ? i : i + index->cap - index->count];
 }
 
+static inline int posIP6Index(IP6Index *index, IP6Set *set)
+{
+   int i = (int)(set - index->set);
+   return (i < index->gap) ? i : i - (index->cap - index->count);
+}
 
-void releaseIP6Tree(IP6Node *node)
+// Move the gap to the index i, the ranges in between are moved over the gap.
+static void moveIP6Gap(IP6Index *index, int i)
 {
-   if (node)
-   {
-      if (node->L)
-         releaseIP6Tree(node->L);
+   int w = index->cap - index->count;
 
-      if (node->R)
-         releaseIP6Tree(node->R);
+   if (i < index->gap)
+      memmove(&index->set[i + w], &index->set[i], (index->gap - i)*sizeof(IP6Set));
+   else if (i > index->gap)
+      memmove(&index->set[index->gap], &index->set[index->gap + w], (i - index->gap)*sizeof(IP6Set));
 
-      deallocate(VPR(node), false);
-   }
+   index->gap = i;
 }
 
+// Index of the first range with a lower boundary greater than lo.
+static inline int upperIP6Bound(uint128t lo, IP6Index *index)
+{
+   int o, p, q;
+   for (p = 0, q = index->count; p < q;)
+      if (le_u128(atIP6Index(index, o = (p + q) >> 1)->lo, lo))
+         p = o+1;
+      else
+         q = o;
+   return p;
+}
 
-#pragma mark ••• AVL Tree of Country Codes •••
 
-static int balanceCCNode(CCNode **node)
+static inline boolean netIP6Overlap(IP6Set *set, uint128t lo, uint128t hi, uint32_t cc, uint32_t id)
 {
-   int change = 0;
-   CCNode  *o = *node;
-   CCNode  *p, *q;
+   uint128t ofs = u64_to_u128t((cc) ? cc == set->cc : id == set->id);
+   return le_u128(set->lo, lo) && le_u128(sub_u128(lo,ofs), set->hi) || le_u128(set->lo, add_u128(hi,ofs)) && le_u128(hi, set->hi) || le_u128(lo, set->lo) && le_u128(set->hi, hi);
+}
 
-   if (o->B == -2)
-   {
-      if (p = o->L)                    // make the static analyzer happy
-         if (p->B == +1)
-         {
-            change = 1;                // double left-right rotation
-            q      = p->R;             // left rotation
-            p->R   = q->L;
-            q->L   = p;
-            o->L   = q->R;             // right rotation
-            q->R   = o;
-            o->B   = +(q->B < 0);
-            p->B   = -(q->B > 0);
-            q->B   = 0;
-            *node  = q;
-         }
+// see findNet4Range()
+IP6Set *findNet6Range(uint128t lo, uint128t hi, uint32_t cc, uint32_t id, IP6Index *index)
+{
+   int     i, p = upperIP6Bound(lo, index);
+   IP6Set *set;
 
-         else
-         {
-            change = p->B;             // single right rotation
-            o->L   = p->R;
-            p->R   = o;
-            o->B   = -(++p->B);
-            *node  = p;
-         }
+   for (i = (p) ? p-1 : p; i <= p && i < index->count; i++)
+      if (netIP6Overlap(set = atIP6Index(index, i), lo, hi, cc, id))
+         return set;
+
+   if (!eq_u128(index->reach, u64_to_u128t(0)))
+      for (i = p-2; i >= 0 && le_u128(sub_u128(sub_u128(lo, (set = atIP6Index(index, i))->lo), u64_to_u128t(1)), index->reach); i--)
+         if (netIP6Overlap(set, lo, hi, cc, id))
+            return set;
+
+   return NULL;
+}
+
+
+int addIP6Range(uint128t lo, uint128t hi, uint32_t cc, uint32_t id, IP6Index *index)
+{
+   int     p = upperIP6Bound(lo, index);
+   IP6Set *set;
+
+   if (p && eq_u128(atIP6Index(index, p-1)->lo, lo))   // this case must not happen !!!
+      return 0;
+
+   if (index->count == index->cap)
+   {
+      int cap = (index->cap) ? 2*index->cap : 4096;
+      if ((set = reallocate(index->set, cap*(ssize_t)sizeof(IP6Set), false, false)) == NULL)
+         return 0;                              // Out of Memory situation, nothing changed
+
+      index->set = set;
+      index->gap = index->count;                // the array was full, and so the gap was empty
+      index->cap = cap;
    }
 
-   else if (o->B == +2)
+   uint128t w = sub_u128(hi, lo);
+   if (p && le_u128(lo, (set = atIP6Index(index, p-1))->hi) && gt_u128(sub_u128(set->hi, set->lo), w))
+      w = sub_u128(set->hi, set->lo);
+   if (p && le_u128(lo, set->hi) || p < index->count && le_u128(atIP6Index(index, p)->lo, hi))
+      if (gt_u128(w, index->reach))
+         index->reach = w;
+
+   moveIP6Gap(index, p);
+   set = memset(&index->set[index->gap++], 0, sizeof(IP6Set));
+   set->lo = lo;
+   set->hi = hi;
+   set->cc = cc;
+   set->id = id;
+   index->count++;
+   return 1;
+}
+
+
+void removeIP6Range(IP6Set *set, IP6Index *index)
+{
+   moveIP6Gap(index, posIP6Index(index, set));
+   index->count--;                              // the range after the gap becomes part of the gap
+}
+
+
+boolean serializeIP6Index(DBWriter *db, IP6Index *index)
+{
+   return appendDBSection(db, index->set, index->gap*sizeof(IP6Set))
+       && appendDBSection(db, &index->set[index->gap + index->cap - index->count], (index->count - index->gap)*sizeof(IP6Set));
+}
+
+
+int collectIP6Index(IP6Index *index, IP6Set sets[])
+{
+   if (index->gap)
+      memcpy(sets, index->set, index->gap*sizeof(IP6Set));
+   if (index->count > index->gap)
+      memcpy(&sets[index->gap], &index->set[index->gap + index->cap - index->count], (index->count - index->gap)*sizeof(IP6Set));
+   return index->count;
+}
+
+
+void releaseIP6Index(IP6Index *index)
+{
+   deallocate(VPR(index->set), false);
+   index->count = index->cap = index->gap = 0;
+   index->reach = u64_to_u128t(0);
+}
+
+
+#pragma mark ••• Block Compressed Range Tables •••
+
+static inline uint32_t byteWidth(uint64_t v)
+{
+   return (v) ? (71 - __builtin_clzll(v))/8 : 0;
+}
+
+static inline uint8_t *putLE(uint8_t *p, uint64_t v, uint32_t w)
+{
+   for (; w; w--, v >>= 8)
+      *p++ = (uint8_t)v;
+   return p;
+}
+
+// The encoded blocks are followed by PACK_PADDING zero bytes, so that 8 bytes can be loaded at once.
+#define PACK_PADDING 8
+
+static inline uint64_t getLE(const uint8_t *p, uint32_t w)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   uint64_t v;
+   memcpy(&v, p, sizeof(uint64_t));
+   return (w < 8) ? v & ((1ULL << 8*w) - 1) : v;
+#else
+   uint64_t v = 0;
+   while (w)
+      v = v << 8 | p[--w];
+   return v;
+#endif
+}
+
+// The 128 bit values are processed in two 64 bit halves, so that this works also with the uint128s struct.
+static inline uint32_t byteWidth128(uint128t v)
+{
+   IP6Desc d = {.number = v};
+   return (d.quad[b2_1]) ? 8 + byteWidth(d.quad[b2_1]) : byteWidth(d.quad[b2_0]);
+}
+
+static inline uint8_t *putLE128(uint8_t *p, uint128t v, uint32_t w)
+{
+   IP6Desc d = {.number = v};
+   p = putLE(p, d.quad[b2_0], (w < 8) ? w : 8);
+   return (w > 8) ? putLE(p, d.quad[b2_1], w - 8) : p;
+}
+
+static inline uint128t getLE128(const uint8_t *p, uint32_t w)
+{
+   IP6Desc d;
+   d.quad[b2_0] = getLE(p, (w < 8) ? w : 8);
+   d.quad[b2_1] = (w > 8) ? getLE(p + 8, w - 8) : 0;
+   return d.number;
+}
+
+static inline uint128t or128(uint128t a, uint128t b)
+{
+   IP6Desc c = {.number = a}, d = {.number = b};
+   c.quad[0] |= d.quad[0], c.quad[1] |= d.quad[1];
+   return c.number;
+}
+
+static inline uint32_t tz128(uint128t v)
+{
+   IP6Desc d = {.number = v};
+   return (d.quad[b2_0]) ? __builtin_ctzll(d.quad[b2_0])
+        : (d.quad[b2_1]) ? __builtin_ctzll(d.quad[b2_1]) + 64 : 0;
+}
+
+
+static boolean growPacker(PackHead *head, uint32_t need, uint8_t **data, uint32_t *dcap, void **keys, size_t ksize, uint32_t **offs, uint32_t *kcap)
+{
+   if (head->size + need > *dcap)
    {
-      if (q = o->R)                    // make the static analyzer happy
-         if (q->B == -1)
-         {
-            change = 1;                // double right-left rotation
-            p      = q->L;             // right rotation
-            q->L   = p->R;
-            p->R   = q;
-            o->R   = p->L;             // left rotation
-            p->L   = o;
-            o->B   = -(p->B > 0);
-            q->B   = +(p->B < 0);
-            p->B   = 0;
-            *node  = p;
-         }
+      uint32_t cap = (*dcap + need)*2;
+      uint8_t *p   = reallocate(*data, cap, false, false);
+      if (!p)
+         return false;
+      *data = p, *dcap = cap;
+   }
 
-         else
-         {
-            change = q->B;             // single left rotation
-            o->R   = q->L;
-            q->L   = o;
-            o->B   = -(--q->B);
-            *node  = q;
-         }
+   if (head->blocks + 2 > *kcap)
+   {
+      uint32_t cap = *kcap*2 + 256;
+      void     *k  = reallocate(*keys, cap*(ssize_t)ksize, false, false);
+      uint32_t *o  = (k) ? reallocate(*offs, cap*(ssize_t)sizeof(uint32_t), false, false) : NULL;
+      if (k)
+         *keys = k;
+      if (!o)
+         return false;
+      *offs = o, *kcap = cap;
    }
 
-   return change != 0;
+   return true;
+}
+
+
+IP4Packer *createIP4Packer(void)
+{
+   IP4Packer *pack = allocate(sizeof(IP4Packer), default_align, true);
+   if (pack)
+      pack->head.rows = PACK_BLOCK_ROWS;
+   return pack;
 }
 
 
-static int pickPrevCCNode(CCNode **node, CCNode **exch)
-{                                             // *exch on entry = parent node
-   CCNode *o = *node;                         // *exch on exit  = picked previous value node
+static boolean flushIP4Block(IP4Packer *pack)
+{
+   IP4Set  *blk = pack->block;
+   int      i, n = pack->fill;
+   uint32_t key = blk[0].lo, lor = 0, spr = 0, smax = 0, cmax = 0, imax = 0, span;
+   uint32_t lsh, lw, ssh, sw, cw, iw;
+   uint8_t *p;
 
-   if (o->R)
+   for (i = 0; i < n; i++)
    {
-      *exch = o;
-      int change = -pickPrevCCNode(&o->R, exch);
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceCCNode(node);
-         else
-            return o->B == 0;
+      lor |= blk[i].lo - key;
+      spr |= span = blk[i].hi - blk[i].lo + 1;
+      if (span > smax)
+         smax = span;
+      if (blk[i].cc > cmax)
+         cmax = blk[i].cc;
+      if (blk[i].id > imax)
+         imax = blk[i].id;
+   }
+
+   lsh = (lor) ? __builtin_ctz(lor) : 0;
+   ssh = (spr) ? __builtin_ctz(spr) : 0;
+   lw  = byteWidth((blk[n-1].lo - key) >> lsh);
+   sw  = byteWidth(smax >> ssh);
+   cw  = byteWidth(cmax);
+   iw  = byteWidth(imax);
+
+   if (!growPacker(&pack->head, 6 + n*(lw + sw + cw + iw), &pack->data, &pack->dcap, (void **)&pack->keys, sizeof(uint32_t), &pack->offs, &pack->kcap))
+      return false;
+
+   pack->keys[pack->head.blocks]   = key;
+   pack->offs[pack->head.blocks++] = pack->head.size;
+
+   p = pack->data + pack->head.size;
+   *p++ = lsh, *p++ = lw, *p++ = ssh, *p++ = sw, *p++ = cw, *p++ = iw;
+   for (i = 0; i < n; i++)
+      p = putLE(p, (blk[i].lo - key) >> lsh, lw);
+   for (i = 0; i < n; i++)
+      p = putLE(p, (blk[i].hi - blk[i].lo + 1) >> ssh, sw);
+   for (i = 0; i < n; i++)
+      p = putLE(p, blk[i].cc, cw);
+   for (i = 0; i < n; i++)
+      p = putLE(p, blk[i].id, iw);
+
+   pack->head.size = (uint32_t)(p - pack->data);
+   pack->fill = 0;
+   return true;
+}
+
+
+boolean packIP4Sets(IP4Packer *pack, IP4Set sets[], int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      pack->block[pack->fill++] = sets[i];
+      pack->head.count++;
+      if (pack->fill == PACK_BLOCK_ROWS && !flushIP4Block(pack))
+         return false;
+   }
+
+   return true;
+}
+
+
+boolean packIP4Index(IP4Packer *pack, IP4Index *index)
+{
+   return packIP4Sets(pack, index->set, index->gap)
+       && packIP4Sets(pack, &index->set[index->gap + index->cap - index->count], index->count - index->gap);
+}
+
+
+boolean serializeIP4Packer(DBWriter *db, IP4Packer *pack)
+{
+   if (pack->fill && !flushIP4Block(pack)
+    || !growPacker(&pack->head, 0, &pack->data, &pack->dcap, (void **)&pack->keys, sizeof(uint32_t), &pack->offs, &pack->kcap))
+      return false;
+
+   pack->offs[pack->head.blocks] = pack->head.size;
+   return appendDBSection(db, &pack->head, sizeof(PackHead))
+       && appendDBSection(db, pack->keys, pack->head.blocks*sizeof(uint32_t))
+       && appendDBSection(db, pack->offs, (pack->head.blocks + 1)*sizeof(uint32_t))
+       && appendDBSection(db, pack->data, pack->head.size)
+       && appendDBSection(db, zeroPage, PACK_PADDING);
+}
+
+
+void releaseIP4Packer(IP4Packer **pack)
+{
+   if (pack && *pack)
+   {
+      deallocate_batch(false, VPR((*pack)->data), VPR((*pack)->offs), VPR((*pack)->keys), NULL);
+      deallocate(VPR(*pack), false);
+   }
+}
+
+
+IP6Packer *createIP6Packer(void)
+{
+   IP6Packer *pack = allocate(sizeof(IP6Packer), default_align, true);
+   if (pack)
+      pack->head.rows = PACK_BLOCK_ROWS;
+   return pack;
+}
+
+
+static boolean flushIP6Block(IP6Packer *pack)
+{
+   IP6Set  *blk = pack->block;
+   int      i, n = pack->fill;
+   uint128t key = blk[0].lo, lor = u64_to_u128t(0), spr = u64_to_u128t(0), smax = u64_to_u128t(0), span;
+   uint32_t cmax = 0, imax = 0;
+   uint32_t lsh, lw, ssh, sw, cw, iw;
+   uint8_t *p;
+
+   for (i = 0; i < n; i++)
+   {
+      span = sub_u128(blk[i].hi, blk[i].lo);
+      inc_u128(&span);
+      lor = or128(lor, sub_u128(blk[i].lo, key));
+      spr = or128(spr, span);
+      if (gt_u128(span, smax))
+         smax = span;
+      if (blk[i].cc > cmax)
+         cmax = blk[i].cc;
+      if (blk[i].id > imax)
+         imax = blk[i].id;
+   }
+
+   lsh = tz128(lor);
+   ssh = tz128(spr);
+   lw  = byteWidth128(shr_u128(sub_u128(blk[n-1].lo, key), lsh));
+   sw  = byteWidth128(shr_u128(smax, ssh));
+   cw  = byteWidth(cmax);
+   iw  = byteWidth(imax);
+
+   if (!growPacker(&pack->head, 6 + n*(lw + sw + cw + iw), &pack->data, &pack->dcap, (void **)&pack->keys, sizeof(uint128t), &pack->offs, &pack->kcap))
+      return false;
+
+   pack->keys[pack->head.blocks]   = key;
+   pack->offs[pack->head.blocks++] = pack->head.size;
+
+   p = pack->data + pack->head.size;
+   *p++ = lsh, *p++ = lw, *p++ = ssh, *p++ = sw, *p++ = cw, *p++ = iw;
+   for (i = 0; i < n; i++)
+      p = putLE128(p, shr_u128(sub_u128(blk[i].lo, key), lsh), lw);
+   for (i = 0; i < n; i++)
+   {
+      span = sub_u128(blk[i].hi, blk[i].lo);
+      inc_u128(&span);
+      p = putLE128(p, shr_u128(span, ssh), sw);
+   }
+   for (i = 0; i < n; i++)
+      p = putLE(p, blk[i].cc, cw);
+   for (i = 0; i < n; i++)
+      p = putLE(p, blk[i].id, iw);
+
+   pack->head.size = (uint32_t)(p - pack->data);
+   pack->fill = 0;
+   return true;
+}
+
+
+boolean packIP6Sets(IP6Packer *pack, IP6Set sets[], int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      pack->block[pack->fill++] = sets[i];
+      pack->head.count++;
+      if (pack->fill == PACK_BLOCK_ROWS && !flushIP6Block(pack))
+         return false;
+   }
+
+   return true;
+}
+
+
+boolean packIP6Index(IP6Packer *pack, IP6Index *index)
+{
+   return packIP6Sets(pack, index->set, index->gap)
+       && packIP6Sets(pack, &index->set[index->gap + index->cap - index->count], index->count - index->gap);
+}
+
+
+boolean serializeIP6Packer(DBWriter *db, IP6Packer *pack)
+{
+   if (pack->fill && !flushIP6Block(pack)
+    || !growPacker(&pack->head, 0, &pack->data, &pack->dcap, (void **)&pack->keys, sizeof(uint128t), &pack->offs, &pack->kcap))
+      return false;
+
+   pack->offs[pack->head.blocks] = pack->head.size;
+   return appendDBSection(db, &pack->head, sizeof(PackHead))
+       && appendDBSection(db, pack->keys, pack->head.blocks*sizeof(uint128t))
+       && appendDBSection(db, pack->offs, (pack->head.blocks + 1)*sizeof(uint32_t))
+       && appendDBSection(db, pack->data, pack->head.size)
+       && appendDBSection(db, zeroPage, PACK_PADDING);
+}
+
+
+void releaseIP6Packer(IP6Packer **pack)
+{
+   if (pack && *pack)
+   {
+      deallocate_batch(false, VPR((*pack)->data), VPR((*pack)->offs), VPR((*pack)->keys), NULL);
+      deallocate(VPR(*pack), false);
+   }
+}
+
+
+// The block layouts are checked once on opening, so that the lookups may rely on them.
+static boolean checkPack(PackHead *head, uint32_t *offs, uint8_t *data, size_t size, uint32_t maxw)
+{
+   uint32_t b, n;
+
+   if (head->rows == 0 || head->blocks != head->count/head->rows + (head->count % head->rows != 0)
+    || size != head->size + PACK_PADDING || offs[0] != 0 || offs[head->blocks] != head->size)
+      return false;
+
+   for (b = 0; b < head->blocks; b++)
+   {
+      uint8_t *p = data + offs[b];
+      n = (b < head->blocks-1) ? head->rows : head->count - b*head->rows;
+      if (offs[b] > offs[b+1] || offs[b+1] - offs[b] < 6
+       || p[0] >= 8*maxw || p[1] > maxw || p[2] >= 8*maxw || p[3] > maxw || p[4] > 4 || p[5] > 4
+       || offs[b+1] - offs[b] != 6 + n*(p[1] + p[3] + p[4] + p[5]))
+         return false;
+   }
+
+   return true;
+}
+
+
+boolean openIP4Pack(DBFile *db, const char *name, IP4Pack *pack)
+{
+   int       n;
+   size_t    size;
+   PackHead *head;
+   uint32_t *keys;
+   uint32_t *offs;
+
+   pack->head = NULL;
+   if ((head = getDBSection(db, name, 1, &n)) == NULL || n < sizeof(PackHead) || head->blocks > n/sizeof(uint32_t))
+      return false;
+
+   size = n - sizeof(PackHead) - head->blocks*sizeof(uint32_t) - (head->blocks + 1)*sizeof(uint32_t);
+   keys = (uint32_t *)&head[1];
+   offs = (uint32_t *)&keys[head->blocks];
+   if ((ssize_t)size < 0 || !checkPack(head, offs, (uint8_t *)&offs[head->blocks + 1], size, sizeof(uint32_t)))
+      return false;
+
+   pack->head = head;
+   pack->keys = keys;
+   pack->offs = offs;
+   pack->data = (uint8_t *)&offs[head->blocks + 1];
+   return true;
+}
+
+
+int searchIP4Pack(uint32_t ip4, IP4Pack *pack, IP4Set *set)
+{
+   int o, p, q;
+   for (p = 0, q = (int)pack->head->blocks-1; p <= q;)   // the last block whose key is not greater than ip4
+   {
+      o = (p + q) >> 1;
+      if (pack->keys[o] <= ip4)
+         p = o+1;
+      else
+         q = o-1;
+   }
+
+   if (q < 0)
+      return -1;
+
+   uint8_t *b   = pack->data + pack->offs[q];
+   uint32_t lw  = b[1], sw = b[3], cw = b[4], iw = b[5];
+   uint32_t key = pack->keys[q], ofs = (ip4 - key) >> b[0], lo, span;
+   int      n   = (q < pack->head->blocks-1) ? pack->head->rows : pack->head->count - q*pack->head->rows;
+   uint8_t *col = b + 6;
+
+   for (p = 1, o = n-1; p <= o;)          // the last row of the block, which begins not after ip4
+   {
+      int m = (p + o) >> 1;
+      if (getLE(col + m*lw, lw) <= ofs)
+         p = m+1;
+      else
+         o = m-1;
+   }
+
+   lo   = key + ((uint32_t)getLE(col + o*lw, lw) << b[0]);
+   span = (uint32_t)getLE(col + n*lw + o*sw, sw) << b[2];
+   if (ip4 - lo > span - 1)
+      return -1;
+
+   col += n*(lw + sw);
+   *set = (IP4Set){lo, lo + span - 1, (uint32_t)getLE(col + o*cw, cw), (uint32_t)getLE(col + n*cw + o*iw, iw)};
+   return q*pack->head->rows + o;
+}
+
+
+boolean openIP6Pack(DBFile *db, const char *name, IP6Pack *pack)
+{
+   int       n;
+   size_t    size;
+   PackHead *head;
+   uint128t *keys;
+   uint32_t *offs;
+
+   pack->head = NULL;
+   if ((head = getDBSection(db, name, 1, &n)) == NULL || n < sizeof(PackHead) || head->blocks > n/sizeof(uint128t))
+      return false;
+
+   size = n - sizeof(PackHead) - head->blocks*sizeof(uint128t) - (head->blocks + 1)*sizeof(uint32_t);
+   keys = (uint128t *)&head[1];
+   offs = (uint32_t *)&keys[head->blocks];
+   if ((ssize_t)size < 0 || !checkPack(head, offs, (uint8_t *)&offs[head->blocks + 1], size, sizeof(uint128t)))
+      return false;
+
+   pack->head = head;
+   pack->keys = keys;
+   pack->offs = offs;
+   pack->data = (uint8_t *)&offs[head->blocks + 1];
+   return true;
+}
+
+
+int searchIP6Pack(uint128t ip6, IP6Pack *pack, IP6Set *set)
+{
+   int o, p, q;
+   for (p = 0, q = (int)pack->head->blocks-1; p <= q;)
+   {
+      o = (p + q) >> 1;
+      if (le_u128(pack->keys[o], ip6))
+         p = o+1;
       else
-         return 0;
+         q = o-1;
    }
 
-   else if (o->L)
-   {
-      CCNode *p = o->L;
-      o->L = NULL;
-      (*exch)->R = p;
-      *exch = o;
-      return p->B == 0;
-   }
+   if (q < 0)
+      return -1;
+
+   uint8_t *b   = pack->data + pack->offs[q];
+   uint32_t lw  = b[1], sw = b[3], cw = b[4], iw = b[5];
+   uint128t key = pack->keys[q], ofs = shr_u128(sub_u128(ip6, key), b[0]), lo, hi;
+   int      n   = (q < pack->head->blocks-1) ? pack->head->rows : pack->head->count - q*pack->head->rows;
+   uint8_t *col = b + 6;
+
+   for (p = 1, o = n-1; p <= o;)
+   {
+      int m = (p + o) >> 1;
+      if (le_u128(getLE128(col + m*lw, lw), ofs))
+         p = m+1;
+      else
+         o = m-1;
+   }
+
+   lo = add_u128(key, shl_u128(getLE128(col + o*lw, lw), b[0]));
+   hi = add_u128(lo, shl_u128(getLE128(col + n*lw + o*sw, sw), b[2]));
+   dec_u128(&hi);
+   if (gt_u128(sub_u128(ip6, lo), sub_u128(hi, lo)))
+      return -1;
+
+   col += n*(lw + sw);
+   *set = (IP6Set){lo, hi, (uint32_t)getLE(col + o*cw, cw), (uint32_t)getLE(col + n*cw + o*iw, iw)};
+   return q*pack->head->rows + o;
+}
+
+
+#pragma mark ••• Range Start Tables •••
+
+IP4Starts *createIP4Starts(boolean owners)
+{
+   IP4Starts *starts = allocate(sizeof(IP4Starts), default_align, true);
+   if (starts)
+      starts->owners = owners;
+   return starts;
+}
+
+
+static boolean pushIP4Start(IP4Starts *starts, uint32_t key, uint32_t val)
+{
+   if (starts->count && starts->keys[starts->count-1] == key)
+   {
+      starts->vals[starts->count-1] = val;   // a later range with the same start takes precedence
+      return true;
+   }
+
+   if (starts->count == starts->cap)
+   {
+      int       cap  = starts->cap*2 + 4096;
+      uint32_t *keys = reallocate(starts->keys, cap*(ssize_t)sizeof(uint32_t), false, false);
+      uint32_t *vals = (keys) ? reallocate(starts->vals, cap*(ssize_t)sizeof(uint32_t), false, false) : NULL;
+      if (keys)
+         starts->keys = keys;
+      if (!vals)
+         return false;
+      starts->vals = vals, starts->cap = cap;
+   }
+
+   starts->keys[starts->count]   = key;
+   starts->vals[starts->count++] = val;
+   return true;
+}
+
+
+boolean appendIP4Starts(IP4Starts *starts, IP4Set sets[], int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      if (starts->pending && sets[i].lo > starts->next && !pushIP4Start(starts, starts->next, 0)
+       || !pushIP4Start(starts, sets[i].lo, (starts->owners) ? sets[i].id : sets[i].cc))
+         return false;
+
+      starts->next    = sets[i].hi + 1;
+      starts->pending = starts->next != 0;   // no gap after the end of the address space
+   }
+
+   return true;
+}
+
+
+boolean collectIP4Starts(IP4Starts *starts, IP4Index *index)
+{
+   return appendIP4Starts(starts, index->set, index->gap)
+       && appendIP4Starts(starts, &index->set[index->gap + index->cap - index->count], index->count - index->gap);
+}
+
+
+boolean serializeIP4Starts(DBWriter *db, const char *tab, IP4Starts *starts)
+{
+   char name[8];
+
+   if (starts->pending && !pushIP4Start(starts, starts->next, 0))
+      return false;
+   starts->pending = false;
+
+   snprintf(name, sizeof(name), "%sk", tab);
+   if (!beginDBSection(db, name, sizeof(uint32_t)) || !appendDBSection(db, starts->keys, starts->count*sizeof(uint32_t)))
+      return false;
+
+   snprintf(name, sizeof(name), "%sv", tab);
+   return beginDBSection(db, name, sizeof(uint32_t)) && appendDBSection(db, starts->vals, starts->count*sizeof(uint32_t));
+}
+
+
+void releaseIP4Starts(IP4Starts **starts)
+{
+   if (starts && *starts)
+   {
+      deallocate_batch(false, VPR((*starts)->vals), VPR((*starts)->keys), NULL);
+      deallocate(VPR(*starts), false);
+   }
+}
+
+
+IP6Starts *createIP6Starts(boolean owners)
+{
+   IP6Starts *starts = allocate(sizeof(IP6Starts), default_align, true);
+   if (starts)
+      starts->owners = owners;
+   return starts;
+}
+
+
+static boolean pushIP6Start(IP6Starts *starts, uint128t key, uint32_t val)
+{
+   if (starts->count && eq_u128(starts->keys[starts->count-1], key))
+   {
+      starts->vals[starts->count-1] = val;
+      return true;
+   }
+
+   if (starts->count == starts->cap)
+   {
+      int       cap  = starts->cap*2 + 1024;
+      uint128t *keys = reallocate(starts->keys, cap*(ssize_t)sizeof(uint128t), false, false);
+      uint32_t *vals = (keys) ? reallocate(starts->vals, cap*(ssize_t)sizeof(uint32_t), false, false) : NULL;
+      if (keys)
+         starts->keys = keys;
+      if (!vals)
+         return false;
+      starts->vals = vals, starts->cap = cap;
+   }
+
+   starts->keys[starts->count]   = key;
+   starts->vals[starts->count++] = val;
+   return true;
+}
+
+
+boolean appendIP6Starts(IP6Starts *starts, IP6Set sets[], int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      if (starts->pending && gt_u128(sets[i].lo, starts->next) && !pushIP6Start(starts, starts->next, 0)
+       || !pushIP6Start(starts, sets[i].lo, (starts->owners) ? sets[i].id : sets[i].cc))
+         return false;
+
+      starts->next = sets[i].hi;
+      inc_u128(&starts->next);
+      starts->pending = gt_u128(starts->next, u64_to_u128t(0));
+   }
+
+   return true;
+}
+
+
+boolean collectIP6Starts(IP6Starts *starts, IP6Index *index)
+{
+   return appendIP6Starts(starts, index->set, index->gap)
+       && appendIP6Starts(starts, &index->set[index->gap + index->cap - index->count], index->count - index->gap);
+}
+
+
+boolean serializeIP6Starts(DBWriter *db, const char *tab, IP6Starts *starts)
+{
+   char name[8];
+
+   if (starts->pending && !pushIP6Start(starts, starts->next, 0))
+      return false;
+   starts->pending = false;
+
+   snprintf(name, sizeof(name), "%sk", tab);
+   if (!beginDBSection(db, name, sizeof(uint128t)) || !appendDBSection(db, starts->keys, starts->count*sizeof(uint128t)))
+      return false;
+
+   snprintf(name, sizeof(name), "%sv", tab);
+   return beginDBSection(db, name, sizeof(uint32_t)) && appendDBSection(db, starts->vals, starts->count*sizeof(uint32_t));
+}
+
+
+void releaseIP6Starts(IP6Starts **starts)
+{
+   if (starts && *starts)
+   {
+      deallocate_batch(false, VPR((*starts)->vals), VPR((*starts)->keys), NULL);
+      deallocate(VPR(*starts), false);
+   }
+}
+
+
+#define JOIN_BATCH 1024
+
+boolean serializeIP4Join(DBWriter *db, IP4Starts *ip, IP4Starts *ns)
+{
+   IP4Set   rows[JOIN_BATCH], row = {};
+   int      i = 0, j = 0, k = 0;
+   uint32_t lo, cc = 0, id = 0;
+   boolean  open = false;
+
+   if (ip->pending && !pushIP4Start(ip, ip->next, 0) || ns->pending && !pushIP4Start(ns, ns->next, 0)
+    || !beginDBSection(db, "j4", sizeof(IP4Set)))
+      return false;
+   ip->pending = ns->pending = false;
+
+   // at each start of either table, the row of the preceding values is closed, if they change
+   while (i < ip->count || j < ns->count)
+   {
+      lo = (j == ns->count || i < ip->count && ip->keys[i] <= ns->keys[j]) ? ip->keys[i] : ns->keys[j];
+      if (i < ip->count && ip->keys[i] == lo)
+         cc = ip->vals[i++];
+      if (j < ns->count && ns->keys[j] == lo)
+         id = ns->vals[j++];
+
+      if (open && row.cc == cc && row.id == id)
+         continue;
+
+      if (open)
+      {
+         row.hi = lo - 1, rows[k++] = row;
+         if (k == JOIN_BATCH && !appendDBSection(db, rows, k*sizeof(IP4Set)))
+            return false;
+         k %= JOIN_BATCH;
+      }
+
+      if (open = cc || id)
+         row.lo = lo, row.cc = cc, row.id = id;
+   }
+
+   if (open)
+      row.hi = UINT32_MAX, rows[k++] = row;
+   return appendDBSection(db, rows, k*sizeof(IP4Set));
+}
+
+boolean serializeIP6Join(DBWriter *db, IP6Starts *ip, IP6Starts *ns)
+{
+   IP6Set   rows[JOIN_BATCH], row = {};
+   int      i = 0, j = 0, k = 0;
+   uint128t lo;
+   uint32_t cc = 0, id = 0;
+   boolean  open = false;
+
+   memset(&row, 0, sizeof(IP6Set));   // no garbage in the padding of the rows
+
+   if (ip->pending && !pushIP6Start(ip, ip->next, 0) || ns->pending && !pushIP6Start(ns, ns->next, 0)
+    || !beginDBSection(db, "j6", sizeof(IP6Set)))
+      return false;
+   ip->pending = ns->pending = false;
+
+   while (i < ip->count || j < ns->count)
+   {
+      lo = (j == ns->count || i < ip->count && le_u128(ip->keys[i], ns->keys[j])) ? ip->keys[i] : ns->keys[j];
+      if (i < ip->count && eq_u128(ip->keys[i], lo))
+         cc = ip->vals[i++];
+      if (j < ns->count && eq_u128(ns->keys[j], lo))
+         id = ns->vals[j++];
+
+      if (open && row.cc == cc && row.id == id)
+         continue;
+
+      if (open)
+      {
+         row.hi = sub_u128(lo, u64_to_u128t(1)), rows[k++] = row;
+         if (k == JOIN_BATCH && !appendDBSection(db, rows, k*sizeof(IP6Set)))
+            return false;
+         k %= JOIN_BATCH;
+      }
+
+      if (open = cc || id)
+         row.lo = lo, row.cc = cc, row.id = id;
+   }
+
+   if (open)
+      row.hi = sub_u128(u64_to_u128t(0), u64_to_u128t(1)), rows[k++] = row;
+   return appendDBSection(db, rows, k*sizeof(IP6Set));
+}
+
+
+// The bisection keeps the largest start <= ip within [base, base+n), so that it is
+// also within the window of PRED_WINDOW keys, which begins at or before base.
+static inline int windowIP4(uint32_t ip4, uint32_t keys[], int count, int wnd)
+{
+   int base = 0, half, n;
+   for (n = count; n > wnd; n -= half)
+   {
+      half = n >> 1;
+      base = (keys[base + half] <= ip4) ? base + half : base;
+   }
+   return (base < count - wnd) ? base : count - wnd;
+}
+
+static inline int windowIP6(uint128t ip6, uint128t keys[], int count, int wnd)
+{
+   int base = 0, half, n;
+   for (n = count; n > wnd; n -= half)
+   {
+      half = n >> 1;
+      base = (le_u128(keys[base + half], ip6)) ? base + half : base;
+   }
+   return (base < count - wnd) ? base : count - wnd;
+}
+
+static int predecessorIP4Scalar(uint32_t ip4, uint32_t keys[], int count)
+{
+   int base = 0, half, n;
+   if (count == 0)
+      return -1;
+
+   for (n = count; n > 1; n -= half)
+   {
+      half = n >> 1;
+      base = (keys[base + half] <= ip4) ? base + half : base;
+   }
+
+   return (keys[base] <= ip4) ? base : -1;
+}
+
+static int predecessorIP6Scalar(uint128t ip6, uint128t keys[], int count)
+{
+   int base = 0, half, n;
+   if (count == 0)
+      return -1;
+
+   for (n = count; n > 1; n -= half)
+   {
+      half = n >> 1;
+      base = (le_u128(keys[base + half], ip6)) ? base + half : base;
+   }
+
+   return (le_u128(keys[base], ip6)) ? base : -1;
+}
+
+#if defined(__x86_64__)
+
+   // The keys are unsigned, and the signed compares need the sign bits flipped.
+   // The number of keys <= ip in the window gives the index of the predecessor.
+
+   static int predecessorIP4SSE2(uint32_t ip4, uint32_t keys[], int count)
+   {
+      int      w    = windowIP4(ip4, keys, count, PRED_WINDOW);
+      __m128i  sign = _mm_set1_epi32(INT32_MIN),
+               ip   = _mm_set1_epi32((int32_t)(ip4 ^ 0x80000000));
+      uint32_t gt   = 0;
+
+      for (int k = 0; k < PRED_WINDOW/4; k++)
+         gt |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(_mm_xor_si128(_mm_loadu_si128((__m128i *)&keys[w + 4*k]), sign), ip))) << 4*k;
+
+      return w + PRED_WINDOW - __builtin_popcount(gt) - 1;
+   }
+
+   __attribute__((target("avx2")))
+   static int predecessorIP4AVX2(uint32_t ip4, uint32_t keys[], int count)
+   {
+      int      w    = windowIP4(ip4, keys, count, PRED_WINDOW);
+      __m256i  sign = _mm256_set1_epi32(INT32_MIN),
+               ip   = _mm256_set1_epi32((int32_t)(ip4 ^ 0x80000000));
+      uint32_t gt   = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_loadu_si256((__m256i *)&keys[w]), sign), ip)))
+                    | (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_loadu_si256((__m256i *)&keys[w + 8]), sign), ip))) << 8;
+
+      return w + PRED_WINDOW - __builtin_popcount(gt) - 1;
+   }
+
+   // Each 256 bit vector holds 2 keys, the lo and hi quads of key i are compared into the bits 2i and 2i+1 of the masks.
+   __attribute__((target("avx2")))
+   static int predecessorIP6AVX2(uint128t ip6, uint128t keys[], int count)
+   {
+      int      w    = windowIP6(ip6, keys, count, PRED_WINDOW/2);
+      IP6Desc  d    = {.number = ip6};
+      __m256i  sign = _mm256_set1_epi64x(INT64_MIN),
+               ip   = _mm256_xor_si256(_mm256_set_epi64x((int64_t)d.quad[b2_1], (int64_t)d.quad[b2_0], (int64_t)d.quad[b2_1], (int64_t)d.quad[b2_0]), sign),
+               key;
+      uint32_t gt = 0, eq = 0;
+
+      for (int k = 0; k < PRED_WINDOW/4; k++)
+      {
+         key = _mm256_xor_si256(_mm256_loadu_si256((__m256i *)&keys[w + 2*k]), sign);
+         gt |= (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(key, ip))) << 4*k;
+         eq |= (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(key, ip))) << 4*k;
+      }
+
+      gt = (gt >> 1 | eq >> 1 & gt) & 0x5555;   // key > ip, if its hi quad is greater, or equal and its lo quad is greater
+      return w + PRED_WINDOW/2 - __builtin_popcount(gt) - 1;
+   }
+
+#endif
+
+int predecessorIP4Search(uint32_t ip4, uint32_t keys[], int count)
+{
+   if (count < PRED_WINDOW)
+      return predecessorIP4Scalar(ip4, keys, count);
+
+#if defined(__x86_64__)
+   static int avx2 = -1;
+   if (avx2 < 0)
+      avx2 = __builtin_cpu_supports("avx2") != 0;
+   return (avx2) ? predecessorIP4AVX2(ip4, keys, count) : predecessorIP4SSE2(ip4, keys, count);
+
+#else
+   return predecessorIP4Scalar(ip4, keys, count);
+
+#endif
+}
+
+int predecessorIP6Search(uint128t ip6, uint128t keys[], int count)
+{
+#if defined(__x86_64__)
+   static int avx2 = -1;
+   if (avx2 < 0)
+      avx2 = __builtin_cpu_supports("avx2") != 0;
+   if (avx2 && count >= PRED_WINDOW/2)
+      return predecessorIP6AVX2(ip6, keys, count);
+
+#endif
+
+   return predecessorIP6Scalar(ip6, keys, count);
+}
+
+
+#pragma mark ••• Posting Lists •••
+
+Postings *createPostings(boolean owners)
+{
+   Postings *post = allocate(sizeof(Postings), default_align, true);
+   if (post)
+      post->owners = owners, post->nkeys = (owners) ? 1 : ccTableSize + 1;
+   return post;
+}
+
+
+static boolean pushPosting(Postings *post, uint32_t key)
+{
+   if (post->count == post->cap)
+   {
+      int       cap  = post->cap*2 + 4096;
+      uint32_t *keys = reallocate(post->keys, cap*(ssize_t)sizeof(uint32_t), false, false);
+      if (!keys)
+         return false;
+      post->keys = keys, post->cap = cap;
+   }
+
+   if (key >= post->nkeys)
+      post->nkeys = key + 1;
+   post->keys[post->count++] = key;
+   return true;
+}
+
+
+boolean appendIP4Postings(Postings *post, IP4Set sets[], int count)
+{
+   for (int i = 0; i < count; i++)
+      if (!pushPosting(post, (post->owners) ? sets[i].id : ccKey(sets[i].cc)))
+         return false;
+   return true;
+}
+
+boolean appendIP6Postings(Postings *post, IP6Set sets[], int count)
+{
+   for (int i = 0; i < count; i++)
+      if (!pushPosting(post, (post->owners) ? sets[i].id : ccKey(sets[i].cc)))
+         return false;
+   return true;
+}
+
+
+boolean collectIP4Postings(Postings *post, IP4Index *index)
+{
+   return appendIP4Postings(post, index->set, index->gap)
+       && appendIP4Postings(post, &index->set[index->gap + index->cap - index->count], index->count - index->gap);
+}
+
+boolean collectIP6Postings(Postings *post, IP6Index *index)
+{
+   return appendIP6Postings(post, index->set, index->gap)
+       && appendIP6Postings(post, &index->set[index->gap + index->cap - index->count], index->count - index->gap);
+}
+
+
+// Counting sort of the row numbers by their keys, which keeps the rows of each key in ascending order.
+boolean serializePostings(DBWriter *db, const char *tab, Postings *post)
+{
+   char      name[8];
+   uint32_t  k, *offs, *rows;
+   int       i;
+   boolean   rc = false;
+
+   offs = allocate((post->nkeys + 1)*sizeof(uint32_t), default_align, true);
+   rows = allocate((post->count + 1)*sizeof(uint32_t), default_align, false);
+   if (offs && rows)
+   {
+      for (i = 0; i < post->count; i++)
+         offs[post->keys[i] + 1]++;
+      for (k = 1; k <= post->nkeys; k++)
+         offs[k] += offs[k-1];
+
+      for (i = 0; i < post->count; i++)
+         rows[offs[post->keys[i]]++] = (uint32_t)i;
+      memmove(&offs[1], &offs[0], post->nkeys*sizeof(uint32_t));
+      offs[0] = 0;
+
+      snprintf(name, sizeof(name), "%sx", tab);
+      rc = beginDBSection(db, name, sizeof(uint32_t))
+        && appendDBSection(db, &post->nkeys, sizeof(uint32_t))
+        && appendDBSection(db, offs, (post->nkeys + 1)*sizeof(uint32_t))
+        && appendDBSection(db, rows, post->count*sizeof(uint32_t));
+   }
+
+   deallocate_batch(false, VPR(rows), VPR(offs), NULL);
+   return rc;
+}
+
+
+void releasePostings(Postings **post)
+{
+   if (post && *post)
+   {
+      deallocate(VPR((*post)->keys), false);
+      deallocate(VPR(*post), false);
+   }
+}
+
+
+boolean openPostings(DBFile *db, const char *tab, int rows, PostingIndex *index)
+{
+   char      name[8];
+   int       n;
+   uint32_t  k, *sect;
+
+   snprintf(name, sizeof(name), "%sx", tab);
+   if (!(sect = getDBSection(db, name, sizeof(uint32_t), &n)) || n < 2 || sect[0] > (uint32_t)n - 2)
+      return false;
+
+   index->nkeys = sect[0];
+   index->offs  = &sect[1];
+   index->rows  = &sect[index->nkeys + 2];
+   if (index->offs[0] != 0 || index->offs[index->nkeys] != (uint32_t)rows || (uint32_t)n != index->nkeys + 2 + (uint32_t)rows)
+      return false;
+
+   for (k = 0; k < index->nkeys; k++)
+      if (index->offs[k] > index->offs[k+1])
+         return false;
+
+   return true;
+}
+
+
+#pragma mark ••• Summaries •••
+
+Summaries *createSummaries(boolean owners)
+{
+   Summaries *sums = allocate(sizeof(Summaries), default_align, true);
+   if (sums)
+      sums->owners = owners;
+   return sums;
+}
+
+
+static Summary *summaryOf(Summaries *sums, uint32_t key)
+{
+   if (key >= sums->cap)
+   {
+      uint32_t cap = (key < ccTableSize) ? ccTableSize + 1 : key*2 + 1024;
+      Summary *sum = reallocate(sums->sum, cap*(ssize_t)sizeof(Summary), false, false);
+      if (!sum)
+         return NULL;
+      memset(&sum[sums->cap], 0, (cap - sums->cap)*sizeof(Summary));
+      sums->sum = sum, sums->cap = cap;
+   }
+
+   if (key >= sums->nkeys)
+      sums->nkeys = key + 1;
+   return &sums->sum[key];
+}
+
+
+boolean appendIP4Summaries(Summaries *sums, IP4Set sets[], int count)
+{
+   Summary *sum;
+   uint32_t ip, last;
+   int      i;
+
+   for (i = 0; i < count; i++)
+   {
+      if (!(sum = summaryOf(sums, (sums->owners) ? sets[i].id : ccKey(sets[i].cc))))
+         return false;
+
+      sum->rows++;
+      sum->addrs = add_u128(sum->addrs, u64_to_u128t((uint64_t)(sets[i].hi - sets[i].lo) + 1));
+      ip = sets[i].lo;
+      do
+         sum->cidrs++;
+      while ((last = ip + (uint32_t)(((uint64_t)1<<cidrIP4(ip, sets[i].hi)) - 1)) < sets[i].hi && (ip = last + 1, true));
+   }
+
+   return true;
+}
+
+boolean appendIP6Summaries(Summaries *sums, IP6Set sets[], int count)
+{
+   Summary *sum;
+   uint128t ip, last;
+   int      i;
+
+   for (i = 0; i < count; i++)
+   {
+      if (!(sum = summaryOf(sums, (sums->owners) ? sets[i].id : ccKey(sets[i].cc))))
+         return false;
+
+      sum->rows++;
+      sum->addrs = add_u128(sum->addrs, add_u128(sub_u128(sets[i].hi, sets[i].lo), u64_to_u128t(1)));
+      ip = sets[i].lo;
+      do
+         sum->cidrs++;
+      while (lt_u128(last = add_u128(ip, v6[cidrIP6(ip, sets[i].hi)].number), sets[i].hi) && (ip = add_u128(last, u64_to_u128t(1)), true));
+   }
+
+   return true;
+}
+
+
+boolean collectIP4Summaries(Summaries *sums, IP4Index *index)
+{
+   return appendIP4Summaries(sums, index->set, index->gap)
+       && appendIP4Summaries(sums, &index->set[index->gap + index->cap - index->count], index->count - index->gap);
+}
+
+boolean collectIP6Summaries(Summaries *sums, IP6Index *index)
+{
+   return appendIP6Summaries(sums, index->set, index->gap)
+       && appendIP6Summaries(sums, &index->set[index->gap + index->cap - index->count], index->count - index->gap);
+}
+
+
+boolean serializeSummaries(DBWriter *db, const char *tab, Summaries *sums)
+{
+   char     name[8];
+   uint32_t k;
+   boolean  rc;
+
+   snprintf(name, sizeof(name), "%sc", tab);
+   rc = beginDBSection(db, name, sizeof(Summary));
+   for (k = 0; rc && k < sums->nkeys; k++)
+      if (sums->sum[k].rows)
+      {
+         sums->sum[k].key = k;
+         rc = appendDBSection(db, &sums->sum[k], sizeof(Summary));
+      }
+
+   return rc;
+}
+
 
-   else
+void releaseSummaries(Summaries **sums)
+{
+   if (sums && *sums)
    {
-      (*exch)->R = NULL;
-      *exch = o;
-      return 1;
+      deallocate(VPR((*sums)->sum), false);
+      deallocate(VPR(*sums), false);
    }
 }
 
 
-static int pickNextCCNode(CCNode **node, CCNode **exch)
-{                                             // *exch on entry = parent node
-   CCNode *o = *node;                         // *exch on exit  = picked next value node
+Summary *findSummary(Summary sum[], int count, uint32_t key)
+{
+   int o, p, q;
 
-   if (o->L)
+   for (p = 0, q = count - 1; p <= q;)
    {
-      *exch = o;
-      int change = +pickNextCCNode(&o->L, exch);
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceCCNode(node);
-         else
-            return o->B == 0;
+      o = (p + q) >> 1;
+      if (key < sum[o].key)
+         q = o - 1;
+      else if (key > sum[o].key)
+         p = o + 1;
       else
-         return 0;
+         return &sum[o];
    }
 
-   else if (o->R)
-   {
-      CCNode *q = o->R;
-      o->R = NULL;
-      (*exch)->L = q;
-      *exch = o;
-      return q->B == 0;
-   }
+   return NULL;
+}
 
-   else
-   {
-      (*exch)->L = NULL;
-      *exch = o;
-      return 1;
-   }
+
+#pragma mark ••• AVL Tree of Country Codes •••
+
+static int cmpCCNode(const void *key, const avlnode *node)
+{
+   uint32_t cc = *(uint32_t *)key;
+   return (cc < ((CCNode *)node)->cc) ? -1 : (cc > ((CCNode *)node)->cc);
 }
 
 
 CCNode *findCCNode(uint32_t cc, CCNode *node)
 {
-   if (node)
+   while (node)
    {
       if (cc < node->cc)
-         return findCCNode(cc, node->L);
+         node = (CCNode *)node->avl.L;
 
       else if (cc > node->cc)
-         return findCCNode(cc, node->R);
+         node = (CCNode *)node->avl.R;
 
       else // (cc == node->cc)
          return node;
    }
-   else
-      return NULL;
+
+   return NULL;
 }
 
 
 int addCCNode(uint32_t cc, uint32_t val, CCNode **node)
 {
-   CCNode *o = *node;
-
-   if (o != NULL)
-   {
-      int change;
-
-      if (cc < o->cc)
-         change = -addCCNode(cc, val, &o->L);
-
-      else if (cc > o->cc)
-         change = +addCCNode(cc, val, &o->R);
-
-      else // (cc == o->cc)               // already in the tree
-      {
-         o->val = val;                    // update the value
-         return 0;
-      }
-
-      if (change)
-         if (abs(o->B += change) > 1)
-            return 1 - balanceCCNode(node);
-         else
-            return o->B != 0;
-      else
-         return 0;
+   int       change = 0;
+   avlpath   path;
+   avlnode  *root = (avlnode *)*node;
+   avlnode **link = avlSearch(&root, &cc, cmpCCNode, &path);
+   CCNode   *o;
+
+   if (o = (CCNode *)*link)               // already in the tree
+      o->val = val;                       // update the value
+
+   else if (o = allocate(sizeof(CCNode), default_align, true))
+   {                                      // otherwise Out of Memory situation, nothing changed
+      o->cc  = cc;
+      o->val = val;
+      change = avlInsert(link, &o->avl, &path);
+      *node = (CCNode *)root;
    }
 
-   else // (o == NULL)                    // if the CCNode is not in the tree
-   {                                      // then add it into a new leaf
-      if (o = allocate(sizeof(CCNode), default_align, true))
-      {
-         o->cc  = cc;
-         o->val = val;
-         *node = o;                       // report back the new node
-         return 1;                        // add the weight of 1 leaf onto the balance
-      }
-
-      return 0;                           // Out of Memory situation, nothing changed
-   }
+   return change;
 }
 
 
 int removeCCNode(uint32_t cc, CCNode **node)
 {
-   CCNode *o = *node;
+   avlpath   path;
+   avlnode  *root = (avlnode *)*node;
+   avlnode **link = avlSearch(&root, &cc, cmpCCNode, &path);
 
-   if (o != NULL)
+   if (*link)
    {
-      int change;
-
-      if (cc < o->cc)
-         change = +removeCCNode(cc, &o->L);
-
-      else if (cc > o->cc)
-         change = -removeCCNode(cc, &o->R);
-
-      else // (cc == o->cc)
-      {
-         int     b = o->B;
-         CCNode *p = o->L;
-         CCNode *q = o->R;
-
-         if (!p || !q)
-         {
-            deallocate(VPR(*node), false);
-            *node = (p > q) ? p : q;
-            return 1;                     // remove the weight of 1 leaf from the balance
-         }
-
-         else
-         {
-            if (b == -1)
-            {
-               if (!p->R)
-               {
-                  change = +1;
-                  o      =  p;
-                  o->R   =  q;
-               }
-               else
-               {
-                  change = +pickPrevCCNode(&p, &o);
-                  o->L   =  p;
-                  o->R   =  q;
-               }
-            }
-
-            else
-            {
-               if (!q->L)
-               {
-                  change = -1;
-                  o      =  q;
-                  o->L   =  p;
-               }
-               else
-               {
-                  change = -pickNextCCNode(&q, &o);
-                  o->L   =  p;
-                  o->R   =  q;
-               }
-            }
-
-            o->B = b;
-            deallocate(VPR(*node), false);
-            *node = o;
-         }
-      }
-
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceCCNode(node);
-         else
-            return o->B == 0;
-      else
-         return 0;
+      avlnode *o = avlRemove(link, &path);
+      deallocate(VPR(o), false);
+      *node = (CCNode *)root;
+      return 1;
    }
-
-   else // (o == NULL)
-      return 0;                           // not found -> recursively do nothing
+   else
+      return 0;                           // not found -> do nothing
 }
 
 
 void releaseCCTree(CCNode *node)
 {
-   if (node)
-   {
-      if (node->L)
-         releaseCCTree(node->L);
-
-      if (node->R)
-         releaseCCTree(node->R);
-
-      deallocate(VPR(node), false);
-   }
+   avlRelease((avlnode *)node, NULL);
 }
 
 
@@ -1077,7 +1998,7 @@ void removeCC(CCNode *table[], uint32_t cc)
    CCNode  *node;
    uint32_t idx = cci(cc);
    if (node = table[idx])
-      if (!node->L && !node->R)
+      if (!node->avl.L && !node->avl.R)
          deallocate(VPR(table[idx]), false);
       else
          removeCCNode(cc, &table[idx]);
@@ -1086,305 +2007,72 @@ void removeCC(CCNode *table[], uint32_t cc)
 
 #pragma mark ••• AVL Tree of unique Net Segements Owner ID's •••
 
-static int balanceNSONode(NSONode **node)
+static int cmpNSONode(const void *key, const avlnode *node)
 {
-   int change = 0;
-   NSONode *o = *node;
-   NSONode *p, *q;
-
-   if (o->B == -2)
-   {
-      if (p = o->L)                    // make the static analyzer happy
-         if (p->B == +1)
-         {
-            change = 1;                // double left-right rotation
-            q      = p->R;             // left rotation
-            p->R   = q->L;
-            q->L   = p;
-            o->L   = q->R;             // right rotation
-            q->R   = o;
-            o->B   = +(q->B < 0);
-            p->B   = -(q->B > 0);
-            q->B   = 0;
-            *node  = q;
-         }
-
-         else
-         {
-            change = p->B;             // single right rotation
-            o->L   = p->R;
-            p->R   = o;
-            o->B   = -(++p->B);
-            *node  = p;
-         }
-   }
-
-   else if (o->B == +2)
-   {
-      if (q = o->R)                    // make the static analyzer happy
-         if (q->B == -1)
-         {
-            change = 1;                // double right-left rotation
-            p      = q->L;             // right rotation
-            q->L   = p->R;
-            p->R   = q;
-            o->R   = p->L;             // left rotation
-            p->L   = o;
-            o->B   = -(p->B > 0);
-            q->B   = +(p->B < 0);
-            p->B   = 0;
-            *node  = p;
-         }
-
-         else
-         {
-            change = q->B;             // single left rotation
-            o->R   = q->L;
-            q->L   = o;
-            o->B   = -(--q->B);
-            *node  = q;
-         }
-   }
-
-   return change != 0;
-}
-
-
-static int pickPrevNSONode(NSONode **node, NSONode **exch)
-{                                       // *exch on entry = parent node
-   NSONode *o = *node;                  // *exch on exit  = picked previous value node
-
-   if (o->R)
-   {
-      *exch = o;
-      int change = -pickPrevNSONode(&o->R, exch);
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceNSONode(node);
-         else
-            return o->B == 0;
-      else
-         return 0;
-   }
-
-   else if (o->L)
-   {
-      NSONode *p = o->L;
-      o->L = NULL;
-      (*exch)->R = p;
-      *exch = o;
-      return p->B == 0;
-   }
-
-   else
-   {
-      (*exch)->R = NULL;
-      *exch = o;
-      return 1;
-   }
-}
-
-
-static int pickNextNSONode(NSONode **node, NSONode **exch)
-{                                       // *exch on entry = parent node
-   NSONode *o = *node;                  // *exch on exit  = picked next value node
-
-   if (o->L)
-   {
-      *exch = o;
-      int change = +pickNextNSONode(&o->L, exch);
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceNSONode(node);
-         else
-            return o->B == 0;
-      else
-         return 0;
-   }
-
-   else if (o->R)
-   {
-      NSONode *q = o->R;
-      o->R = NULL;
-      (*exch)->L = q;
-      *exch = o;
-      return q->B == 0;
-   }
-
-   else
-   {
-      (*exch)->L = NULL;
-      *exch = o;
-      return 1;
-   }
+   return strcmp((const char *)key, ((NSONode *)node)->nso);
 }
 
 
-// CAUTION: The following recursive functions must not be called with nso == NULL.
+// CAUTION: The following functions must not be called with nso == NULL.
 //          For performace reasons no extra error cheking is done.
 
 NSONode *findNSONode(const char *nso, NSONode *node)
 {
-   if (node)
-   {
-      int ord = strcmp(nso, node->nso);
+   int ord;
 
-      if (ord == 0)
+   while (node)
+   {
+      if ((ord = strcmp(nso, node->nso)) == 0)
          return node;
 
       else if (ord < 0)
-         return findNSONode(nso, node->L);
+         node = (NSONode *)node->avl.L;
 
       else // (ord > 0)
-         return findNSONode(nso, node->R);
+         node = (NSONode *)node->avl.R;
    }
 
-   else
-      return NULL;
+   return NULL;
 }
 
-int addNSONode(const char *nso, int nsl, uint32_t val, NSONode **node)
+int addNSONode(const char *nso, int nsl, uint32_t val, NSONode **node, arena *arena)
 {
-   NSONode *o = *node;
-
-   if (o == NULL)                         // if the nso is not in the tree
-   {                                      // then add it into a new leaf
-      if (o = allocate(sizeof(NSONode), default_align, true))
-         if (o->nso = allocate(nsl+1, default_align, false))
-         {
-            strcpy(o->nso, nso);
-            o->val = val;
-            *node = o;
-            return 1;                     // add the weight of 1 leaf onto the balance
-         }
-         else
-            deallocate(VPR(o), false);
-
-      return 0;                           // Out of Memory situation, nothing changed
+   int       change = 0;
+   avlpath   path;
+   avlnode  *root = (avlnode *)*node;
+   avlnode **link = avlSearch(&root, nso, cmpNSONode, &path);
+   NSONode  *o;
+   char     *key;
+
+   if (o = (NSONode *)*link)              // already in the tree
+      o->val = val;                       // update the value
+
+   else if ((key = arenaBytes(arena, nsl+1))
+         && (o = arenaAlloc(arena)))
+   {                                      // otherwise Out of Memory situation, nothing changed
+      o->nso = strcpy(key, nso);
+      o->val = val;
+      change = avlInsert(link, &o->avl, &path);
+      *node = (NSONode *)root;
    }
 
-   else
-   {
-      int change;
-      int ord = strcmp(nso, o->nso);
-
-      if (ord == 0)                       // already in the tree
-      {
-         o->val = val;                    // update the value
-         return 0;
-      }
-
-      else if (ord < 0)
-         change = -addNSONode(nso, nsl, val, &o->L);
-
-      else // (ord > 0)
-         change = +addNSONode(nso, nsl, val, &o->R);
-
-      if (change)
-         if (abs(o->B += change) > 1)
-            return 1 - balanceNSONode(node);
-         else
-            return o->B != 0;
-      else
-         return 0;
-   }
+   return change;
 }
 
-int removeNSONode(const char *nso, int nsl, NSONode **node)
+int removeNSONode(const char *nso, int nsl, NSONode **node, arena *arena)
 {
-   NSONode *o = *node;
-
-   if (o == NULL)
-      return 0;                              // not found -> recursively do nothing
-
-   else
-   {
-      int change;
-      int ord = strcmp(nso, o->nso);
-
-      if (ord == 0)
-      {
-         int      b = o->B;
-         NSONode *p = o->L;
-         NSONode *q = o->R;
-
-         if (!p || !q)
-         {
-            deallocate_batch(false, VPR((*node)->nso),
-                                    VPR(*node), NULL);
-            *node = (p > q) ? p : q;
-            return 1;                        // remove the weight of 1 leaf from the balance
-         }
-
-         else
-         {
-            if (b == -1)
-            {
-               if (!p->R)
-               {
-                  change = +1;
-                  o      =  p;
-                  o->R   =  q;
-               }
-               else
-               {
-                  change = +pickPrevNSONode(&p, &o);
-                  o->L   =  p;
-                  o->R   =  q;
-               }
-            }
-
-            else
-            {
-               if (!q->L)
-               {
-                  change = -1;
-                  o      =  q;
-                  o->L   =  p;
-               }
-               else
-               {
-                  change = -pickNextNSONode(&q, &o);
-                  o->L   =  p;
-                  o->R   =  q;
-               }
-            }
-
-            o->B = b;
-            deallocate_batch(false, VPR((*node)->nso),
-                                    VPR(*node), NULL);
-            *node = o;
-         }
-      }
-
-      else if (ord < 0)
-         change = +removeNSONode(nso, nsl, &o->L);
-
-      else // (ord > 0)
-         change = -removeNSONode(nso, nsl, &o->R);
+   avlpath   path;
+   avlnode  *root = (avlnode *)*node;
+   avlnode **link = avlSearch(&root, nso, cmpNSONode, &path);
 
-      if (change)
-         if (abs(o->B += change) > 1)
-            return balanceNSONode(node);
-         else
-            return o->B == 0;
-      else
-         return 0;
-   }
-}
-
-void releaseNSOTree(NSONode *node)
-{
-   if (node)
+   if (*link)
    {
-      if (node->L)
-         releaseNSOTree(node->L);
-      if (node->R)
-         releaseNSOTree(node->R);
-
-      deallocate_batch(false, VPR(node->nso),
-                              VPR(node), NULL);
+      arenaFree(arena, avlRemove(link, &path));    // the key remains in the arena until its release
+      *node = (NSONode *)root;
+      return 1;
    }
+   else
+      return 0;                           // not found -> do nothing
 }
 
 
@@ -1395,17 +2083,24 @@ NSONode **createNSOTable(uint n)
 {
    NSONode **table = allocate((n+2)*sizeof(NSONode *), default_align, true);
    if (table)
+   {
       *(uint *)table = n;
+      if ((*(arena **)&table[n+1] = createArena(sizeof(NSONode))) == NULL)
+         deallocate(VPR(table), false);
+   }
    return table;
 }
 
+static inline arena *nsoArena(NSONode *table[])
+{
+   return *(arena **)&table[*(uint *)&table[0] + 1];
+}
+
 void releaseNSOTable(NSONode *table[])
 {
    if (table)
    {
-      uint i, n = 2 + *(uint *)&table[0];
-      for (i = 2; i < n; i++)
-         releaseNSOTree(table[i]);
+      releaseArena((arena **)&table[*(uint *)&table[0] + 1]);   // releases all nodes of all trees at once
       deallocate(VPR(table), false);
    }
 }
@@ -1423,7 +2118,7 @@ NSONode *findNSO(NSONode *table[], const char *nso)
 void storeNSO(NSONode *table[], const char *nso, int nsl, uint32_t val)
 {
    if (nso && *nso)
-      addNSONode(nso, nsl, val, &table[mmh3(nso, nsl) % *(uint*)&table[0] + 1]);
+      addNSONode(nso, nsl, val, &table[mmh3(nso, nsl) % *(uint*)&table[0] + 1], nsoArena(table));
 }
 
 void removeNSO(NSONode *table[], const char *nso, int nsl)
@@ -1434,10 +2129,115 @@ void removeNSO(NSONode *table[], const char *nso, int nsl)
       NSONode *node = table[tidx];
       if (node)
       {
-         if (!node->L && !node->R)
-            deallocate_batch(false, VPR(node->nso), VPR(table[tidx]), NULL);
+         if (!node->avl.L && !node->avl.R)
+         {
+            arenaFree(nsoArena(table), node);
+            table[tidx] = NULL;
+         }
          else
-            removeNSONode(nso, nsl, &table[tidx]);
+            removeNSONode(nso, nsl, &table[tidx], nsoArena(table));
       }
    }
 }
+
+
+#pragma mark ••• Dictionary of Net Segment Owners •••
+
+static boolean appendNSO(NSODict *dict, const char *nso, uint32_t nsl)
+{
+   if (dict->count + 2 > dict->ocap)      // offs[0] is not used
+   {
+      uint32_t  ocap = (dict->ocap) ? 2*dict->ocap : 4096;
+      uint32_t *offs = reallocate(dict->offs, ocap*(ssize_t)sizeof(uint32_t), false, false);
+      if (!offs)
+         return false;
+      dict->offs = offs, dict->ocap = ocap;
+   }
+
+   if (dict->size + nsl + 1 > dict->cap)
+   {
+      uint32_t cap = (dict->cap) ? 2*dict->cap : 65536;
+      char   *data;
+      while (dict->size + nsl + 1 > cap)
+         cap *= 2;
+      if ((data = reallocate(dict->data, cap, false, false)) == NULL)
+         return false;
+      dict->data = data, dict->cap = cap;
+   }
+
+   dict->offs[++dict->count] = dict->size;
+   memvcpy(dict->data + dict->size, nso, nsl);
+   dict->data[dict->size += nsl] = '\0';
+   dict->size++;
+   return true;
+}
+
+
+NSODict *createNSODict(const char *data, size_t size, boolean intern)
+{
+   NSODict    *dict = allocate(sizeof(NSODict), default_align, true);
+   const char *nso, *end, *nul;
+
+   if (!dict)
+      return NULL;
+
+   if (intern && (dict->table = createNSOTable(65536)) == NULL)
+      goto error;
+
+   if (data)
+      for (nso = data, end = data + size; nso < end && (nul = memchr(nso, '\0', end - nso)); nso = nul+1)
+         if (appendNSO(dict, nso, (uint32_t)(nul - nso)))
+         {
+            if (intern)
+               storeNSO(dict->table, nso, (int)(nul - nso), dict->count);
+         }
+         else
+            goto error;
+
+   return dict;
+
+error:
+   releaseNSODict(&dict);
+   return NULL;
+}
+
+
+NSODict *loadNSODict(DBFile *db, boolean intern)
+{
+   int   n;
+   char *nso = getDBSection(db, "nso", 1, &n);
+   return (nso) ? createNSODict(nso, n, intern) : NULL;
+}
+
+
+uint32_t internNSO(NSODict *dict, const char *nso)
+{
+   NSONode *node;
+   int      nsl;
+
+   if (!*nso)
+      return 0;
+
+   else if (node = findNSO(dict->table, nso))
+      return node->val;
+
+   else if (appendNSO(dict, nso, nsl = strvlen(nso)))
+   {
+      storeNSO(dict->table, nso, nsl, dict->count);
+      return dict->count;
+   }
+
+   else
+      return 0;
+}
+
+
+void releaseNSODict(NSODict **dict)
+{
+   if (dict && *dict)
+   {
+      releaseNSOTable((*dict)->table);
+      deallocate_batch(false, VPR((*dict)->offs), VPR((*dict)->data), NULL);
+      deallocate(VPR(*dict), false);
+   }
+}
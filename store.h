@@ -24,7 +24,94 @@
 //  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
-#pragma mark ••• AVL Tree of IPv4-Ranges •••
+#pragma mark ••• Database File •••
+
+// All tables are stored in one database file (<bstfiles>). The header is followed by the section directory within the first
+// page, and each section begins at a page boundary, so that the file can be mapped into memory and the tables can be used
+// in place. The byte order mark is written in the byte order of the generating machine. On opening, the checksums of the
+// header, the directory and all sections are verified in one pass.
+//
+// Sections:
+//   v4, s4         IP4Set rows of the country codes and of the net segment owners
+//   v6, s6         IP6Set rows of the same
+//   v4p .. s6p     block compressed copies of the row tables (ipdb -z), see IP4Packer
+//   v4k, v4v ..    keys and values of the range start tables (ipdb -k), see IP4Starts
+//   v4x .. s6x     posting lists of the country codes and owners (ipdb -x), see Postings
+//   j4, j6         joined rows of the country codes and owners (ipdb -j), see serializeIP4Join()
+//   v4c .. s6c     summaries of the country codes and owners (ipdb -c), see Summaries
+//   nso            NSODict strings of the owners
+//
+// Side files, which are not sections: the incremental update (ipdb -i) keeps the delegation snapshots of each registry in
+// <bstfile>.<registry>.d4 and .d6 next to the database file, and writes the changeset of each update into <bstfile>.chg.
+
+#define DB_MAGIC        'IPDB'
+#define DB_VERSION      1
+#define DB_BOM          0x01020304
+#define DB_PAGE_SIZE    4096
+#define DB_MAX_SECTIONS ((DB_PAGE_SIZE - sizeof(DBHeader))/sizeof(DBSection))
+
+typedef struct
+{
+   uint32_t magic;         // DB_MAGIC
+   uint32_t version;       // DB_VERSION
+   uint32_t bom;           // DB_BOM
+   uint32_t count;         // number of sections in the directory
+   uint64_t size;          // size of the file
+   uint32_t dircrc;        // CRC32C of the section directory
+   uint32_t hdrcrc;        // CRC32C of the preceding fields of the header
+} DBHeader;
+
+typedef struct
+{
+   char     name[8];       // see the list of the sections above
+   uint64_t offset;        // a multiple of DB_PAGE_SIZE
+   uint64_t size;          // length of the section in bytes
+   uint32_t rowsize;       // size of the rows of the tables, 1 for the nso strings
+   uint32_t crc;           // CRC32C of the section
+} DBSection;
+
+typedef struct
+{
+   FILE     *out;
+   char     *name, *temp;  // the file is written to <name>.tmp and finally renamed to <name>
+   DBHeader  head;
+   DBSection sect[DB_MAX_SECTIONS];
+} DBWriter;
+
+DBWriter *createDB(const char *name);
+boolean   beginDBSection(DBWriter *db, const char *name, uint32_t rowsize);
+boolean  appendDBSection(DBWriter *db, const void *data, size_t size);
+boolean         commitDB(DBWriter *db);   // completes and renames the file, and releases the writer
+void             abortDB(DBWriter *db);   // removes the incomplete file, and releases the writer
+
+typedef struct
+{
+   void      *base;        // memory mapping of the file
+   size_t     size;
+   DBHeader  *head;
+   DBSection *sect;
+} DBFile;
+
+DBFile *openDB(const char *name);         // returns NULL, if the file is missing, incompatible or damaged
+DBSection *findDBSection(DBFile *db, const char *name);
+void *getDBSection(DBFile *db, const char *name, uint32_t rowsize, int *count);
+boolean copyDBSection(DBWriter *db, DBFile *src, const char *name);   // verbatim with its checksum, false if missing
+void     closeDB(DBFile **db);
+
+
+#pragma mark ••• Generic AVL Tree •••
+
+// All tree nodes begin with this head, and the search path recording, the balancing, the unlinking and the
+// traversal are implemented once in store.c for the trees of all node types. The head is placed in front of
+// the keys, so that the descent through a tree touches only the first cache line of each node.
+typedef struct avlnode
+{
+   struct avlnode *L, *R;
+   int32_t B;                 // house holding
+} avlnode;
+
+
+#pragma mark ••• Sorted Index of IPv4-Ranges •••
 
 typedef union
 {
@@ -35,26 +122,27 @@ typedef union
 typedef struct
 {
    uint32_t lo, hi;
-   uint32_t cc;
-   char nso[36];
+   uint32_t cc;            // country code in the .v4 table
+   uint32_t id;            // ID of the net segment owner in the .s4 table, see NSODict
 } IP4Set;
 
-typedef struct IP4Node
+// Build-time index of the consolidated IPv4-Ranges. The ranges are kept in a sorted array with a gap at the
+// position of the last modification. ipdb merges the delegations of each registry in ascending order, and
+// so the gap moves forward by only a few rows at a time, and most insertions and removals cost O(1).
+typedef struct
 {
-   uint32_t lo, hi;           // IPv4 number range
-   uint32_t cc;               // country code
-   char nso[36];              // unique identifier of the network segment owner
-
-   int32_t  B;                // house holding
-   struct IP4Node *L, *R;
-} IP4Node;
-
-IP4Node  *findIP4Node(uint32_t ip, IP4Node  *node);
-IP4Node *findNet4Node(uint32_t lo, uint32_t hi, uint32_t cc, char *nso, IP4Node  *node);
-int        addIP4Node(uint32_t lo, uint32_t hi, uint32_t cc, char *nso, IP4Node **node);
-int     removeIP4Node(uint32_t ip, IP4Node **node);
-void serializeIP4Tree(FILE *out, IP4Node *node);
-void   releaseIP4Tree(IP4Node *node);
+   IP4Set *set;
+   int     count, cap;        // number of ranges, capacity of the array
+   int     gap;               // index of the gap, set[gap .. gap+cap-count-1] is unused
+   uint32_t reach;            // length of the longest range, which ever overlapped another one
+} IP4Index;
+
+IP4Set *findNet4Range(uint32_t lo, uint32_t hi, uint32_t cc, uint32_t id, IP4Index *index);
+int      addIP4Range(uint32_t lo, uint32_t hi, uint32_t cc, uint32_t id, IP4Index *index);
+void  removeIP4Range(IP4Set *set, IP4Index *index);
+boolean serializeIP4Index(DBWriter *db, IP4Index *index);
+int    collectIP4Index(IP4Index *index, IP4Set sets[]);   // sorted copy into sets[], returns the number of copied sets
+void   releaseIP4Index(IP4Index *index);
 
 static inline int bisectionIP4Search(uint32_t ip4, IP4Set sortedIP4Sets[], int count)
 {
@@ -75,7 +163,7 @@ static inline int bisectionIP4Search(uint32_t ip4, IP4Set sortedIP4Sets[], int c
 }
 
 
-#pragma mark ••• AVL Tree of IPv6-Ranges •••
+#pragma mark ••• Sorted Index of IPv6-Ranges •••
 
 typedef union
 {
@@ -87,26 +175,25 @@ typedef union
 typedef struct
 {
    uint128t lo, hi;
-   uint32_t cc;
-   char nso[36];
+   uint32_t cc;            // country code in the .v6 table
+   uint32_t id;            // ID of the net segment owner in the .s6 table, see NSODict
 } IP6Set;
 
-typedef struct IP6Node
+// Build-time index of the consolidated IPv6-Ranges, organized like IP4Index.
+typedef struct
 {
-   uint128t lo, hi;           // IPv4 number range
-   uint32_t cc;               // country code
-   char nso[36];              // unique identifier of the network segment owner
-
-   int32_t  B;                // house holding
-   struct IP6Node *L, *R;
-} IP6Node;
-
-IP6Node  *findIP6Node(uint128t ip, IP6Node *node);
-IP6Node *findNet6Node(uint128t lo, uint128t hi, uint32_t cc, char *nso, IP6Node  *node);
-int        addIP6Node(uint128t lo, uint128t hi, uint32_t cc, char *nso, IP6Node **node);
-int     removeIP6Node(uint128t ip, IP6Node **node);
-void serializeIP6Tree(FILE *out, IP6Node *node);
-void   releaseIP6Tree(IP6Node *node);
+   IP6Set *set;
+   int     count, cap;        // number of ranges, capacity of the array
+   int     gap;               // index of the gap, set[gap .. gap+cap-count-1] is unused
+   uint128t reach;            // length of the longest range, which ever overlapped another one
+} IP6Index;
+
+IP6Set *findNet6Range(uint128t lo, uint128t hi, uint32_t cc, uint32_t id, IP6Index *index);
+int      addIP6Range(uint128t lo, uint128t hi, uint32_t cc, uint32_t id, IP6Index *index);
+void  removeIP6Range(IP6Set *set, IP6Index *index);
+boolean serializeIP6Index(DBWriter *db, IP6Index *index);
+int    collectIP6Index(IP6Index *index, IP6Set sets[]);   // sorted copy into sets[], returns the number of copied sets
+void   releaseIP6Index(IP6Index *index);
 
 static inline int bisectionIP6Search(uint128t ip6, IP6Set sortedIP6Sets[], int count)
 {
@@ -127,15 +214,229 @@ static inline int bisectionIP6Search(uint128t ip6, IP6Set sortedIP6Sets[], int c
 }
 
 
+#pragma mark ••• Block Compressed Range Tables •••
+
+// Optional packed copies of the range tables (sections v4p, s4p, v6p and s6p) for lookups. The rows are encoded in blocks of
+// PACK_BLOCK_ROWS, and the lo key of the first row of each block is kept in a plain array for the search. The blocks are
+// frame-of-reference encoded in columns of fixed width little endian integers:
+//
+//    lsh, lw, ssh, sw, cw, iw   6 bytes: shifts and byte widths of the columns
+//    (lo - key) >> lsh          lw bytes per row
+//    (hi - lo + 1) >> ssh       sw bytes per row, 0 stands for the whole address space
+//    cc                         cw bytes per row
+//    id                         iw bytes per row
+//
+// The shifts strip the trailing zero bits, which all offsets or lengths of a block have in common. Because the ranges
+// are mostly CIDR blocks, this takes the IPv6 values down to a few bytes, and a column of all zero ids takes no space.
+// A lookup bisects the keys, and then the lo column of one block.
+//
+// Section layout: PackHead, keys[blocks] (uint32_t or uint128t), offs[blocks+1] (uint32_t), encoded blocks[size]
+
+#define PACK_BLOCK_ROWS 64
+
+typedef struct
+{
+   uint32_t count;         // number of rows
+   uint32_t blocks;        // number of blocks, the last one may be incomplete
+   uint32_t rows;          // rows per block
+   uint32_t size;          // length of the encoded blocks
+} PackHead;
+
+typedef struct
+{
+   PackHead  head;
+   uint32_t *keys, *offs;
+   uint8_t  *data;
+   uint32_t  kcap, dcap;   // capacities of keys/offs and data
+   int       fill;         // number of rows in block
+   IP4Set    block[PACK_BLOCK_ROWS];
+} IP4Packer;
+
+IP4Packer *createIP4Packer(void);
+boolean       packIP4Sets(IP4Packer *pack, IP4Set sets[], int count);   // appends the rows, which must be in sorted order
+boolean      packIP4Index(IP4Packer *pack, IP4Index *index);
+boolean serializeIP4Packer(DBWriter *db, IP4Packer *pack);
+void     releaseIP4Packer(IP4Packer **pack);
+
+typedef struct
+{
+   PackHead  head;
+   uint128t *keys;
+   uint32_t *offs;
+   uint8_t  *data;
+   uint32_t  kcap, dcap;
+   int       fill;
+   IP6Set    block[PACK_BLOCK_ROWS];
+} IP6Packer;
+
+IP6Packer *createIP6Packer(void);
+boolean       packIP6Sets(IP6Packer *pack, IP6Set sets[], int count);
+boolean      packIP6Index(IP6Packer *pack, IP6Index *index);
+boolean serializeIP6Packer(DBWriter *db, IP6Packer *pack);
+void     releaseIP6Packer(IP6Packer **pack);
+
+typedef struct
+{
+   PackHead *head;
+   uint32_t *keys, *offs;
+   uint8_t  *data;
+} IP4Pack;
+
+typedef struct
+{
+   PackHead *head;
+   uint128t *keys;
+   uint32_t *offs;
+   uint8_t  *data;
+} IP6Pack;
+
+boolean openIP4Pack(DBFile *db, const char *name, IP4Pack *pack);   // false, if the section is missing or inconsistent
+boolean openIP6Pack(DBFile *db, const char *name, IP6Pack *pack);
+int   searchIP4Pack(uint32_t ip4, IP4Pack *pack, IP4Set *set);      // returns the row number and decodes the row into set, or -1
+int   searchIP6Pack(uint128t ip6, IP6Pack *pack, IP6Set *set);
+
+
+#pragma mark ••• Range Start Tables •••
+
+// Optional tables of the range starts only (sections v4k/v4v, s4k/s4v, v6k/v6v and s6k/s6v). Since the ranges are sorted and
+// disjoint, each hi bound is implied by the start of the following range, and a gap is marked by a start with the value 0.
+// The values are the country codes of the v tables or the owner IDs of the s tables. A lookup is a predecessor search for
+// the largest start <= ip in the plain key array, and the range ends before the following start. Of overlapping ranges, a
+// later one cuts the earlier one off, as it does for the packed tables.
+typedef struct
+{
+   uint32_t *keys;         // the range starts
+   uint32_t *vals;         // the values, 0 for the gaps
+   int       count, cap;
+   boolean   owners;       // store the owner IDs instead of the country codes
+   boolean   pending;      // next is the start of the gap after the last range
+   uint32_t  next;
+} IP4Starts;
+
+IP4Starts *createIP4Starts(boolean owners);
+boolean   appendIP4Starts(IP4Starts *starts, IP4Set sets[], int count);   // the rows must be in sorted order
+boolean  collectIP4Starts(IP4Starts *starts, IP4Index *index);
+boolean serializeIP4Starts(DBWriter *db, const char *tab, IP4Starts *starts);   // sections <tab>k and <tab>v
+void     releaseIP4Starts(IP4Starts **starts);
+
+typedef struct
+{
+   uint128t *keys;
+   uint32_t *vals;
+   int       count, cap;
+   boolean   owners;
+   boolean   pending;
+   uint128t  next;
+} IP6Starts;
+
+IP6Starts *createIP6Starts(boolean owners);
+boolean   appendIP6Starts(IP6Starts *starts, IP6Set sets[], int count);
+boolean  collectIP6Starts(IP6Starts *starts, IP6Index *index);
+boolean serializeIP6Starts(DBWriter *db, const char *tab, IP6Starts *starts);
+void     releaseIP6Starts(IP6Starts **starts);
+
+// The joined table of a v table and an s table (sections j4 and j6), which is swept together from the range starts of both.
+// Its rows are the maximal ranges with the same country code and owner ID, either of which may be 0 for none, so that one
+// search gives both. Both tables must be complete, the range starts of the v table in ip and those of the s table in ns.
+boolean serializeIP4Join(DBWriter *db, IP4Starts *ip, IP4Starts *ns);
+boolean serializeIP6Join(DBWriter *db, IP6Starts *ip, IP6Starts *ns);
+
+// Return the index of the largest start <= ip, or -1. The search is branch free down to a window of PRED_WINDOW
+// keys (one cache line of IPv4 keys, two of IPv6 keys), which is then counted out with vector compares. The AVX2
+// variants are selected at run time, if the CPU supports them, otherwise SSE2 or scalar code is used.
+#define PRED_WINDOW 16
+
+int predecessorIP4Search(uint32_t ip4, uint32_t keys[], int count);
+int predecessorIP6Search(uint128t ip6, uint128t keys[], int count);
+
+
+#pragma mark ••• Posting Lists •••
+
+// Optional reverse index of a table (sections v4x, s4x, v6x and s6x), which lists per country code or owner the numbers of
+// its rows in ascending order, so that the ranges of a few countries or owners are gathered without a scan over the whole
+// table. The keys of the v tables are the encoded country codes cce(), and ccTableSize for any improper code, and the keys
+// of the s tables are the owner IDs. Section layout: nkeys, offs[nkeys+1], rows[offs[nkeys]] (all uint32_t).
+typedef struct
+{
+   uint32_t *keys;         // the key of each row
+   int       count, cap;
+   uint32_t  nkeys;        // highest key + 1
+   boolean   owners;       // key the rows by the owner IDs instead of the country codes
+} Postings;
+
+Postings *createPostings(boolean owners);
+boolean appendIP4Postings(Postings *post, IP4Set sets[], int count);   // in the order of the rows
+boolean appendIP6Postings(Postings *post, IP6Set sets[], int count);
+boolean collectIP4Postings(Postings *post, IP4Index *index);
+boolean collectIP6Postings(Postings *post, IP6Index *index);
+boolean serializePostings(DBWriter *db, const char *tab, Postings *post);   // section <tab>x
+void     releasePostings(Postings **post);
+
+typedef struct
+{
+   uint32_t  nkeys;
+   uint32_t *offs;
+   uint32_t *rows;
+} PostingIndex;
+
+boolean openPostings(DBFile *db, const char *tab, int rows, PostingIndex *index);   // false, if the section is missing or inconsistent
+
+// The row numbers of the key, the count of which is stored into *count.
+static inline uint32_t *postingRows(PostingIndex *index, uint32_t key, int *count)
+{
+   if (key < index->nkeys)
+   {
+      *count = (int)(index->offs[key+1] - index->offs[key]);
+      return &index->rows[index->offs[key]];
+   }
+
+   else
+   {
+      *count = 0;
+      return NULL;
+   }
+}
+
+
+#pragma mark ••• Summaries •••
+
+// Optional summary of a table (sections v4c, s4c, v6c and s6c), which holds per country code or owner the number of its rows,
+// the number of the address/masklen pairs into which ipup decomposes them, and the number of their addresses, so that the
+// size of a firewall table is known without generating it. The keys are those of the posting lists, and only the keys with
+// rows are stored, in ascending order. Overlapping rows of the same key are counted each, as ipup outputs them without -a.
+typedef struct
+{
+   uint32_t key;           // cce() of the country code or the owner ID
+   uint32_t rows;          // number of rows
+   uint64_t cidrs;         // number of address/masklen pairs
+   uint128t addrs;         // number of addresses
+} Summary;
+
+typedef struct
+{
+   Summary  *sum;          // indexed by the keys
+   uint32_t  nkeys, cap;   // highest key + 1, and the capacity of sum
+   boolean   owners;       // key the rows by the owner IDs instead of the country codes
+} Summaries;
+
+Summaries *createSummaries(boolean owners);
+boolean appendIP4Summaries(Summaries *sums, IP4Set sets[], int count);
+boolean appendIP6Summaries(Summaries *sums, IP6Set sets[], int count);
+boolean collectIP4Summaries(Summaries *sums, IP4Index *index);
+boolean collectIP6Summaries(Summaries *sums, IP6Index *index);
+boolean serializeSummaries(DBWriter *db, const char *tab, Summaries *sums);   // section <tab>c
+void     releaseSummaries(Summaries **sums);
+
+Summary *findSummary(Summary sum[], int count, uint32_t key);   // bisection, NULL if the key has no rows
+
+
 #pragma mark ••• AVL Tree of Country Codes •••
 
 typedef struct CCNode
 {
+   avlnode  avl;           // tree head
    uint32_t cc;            // country code
    uint32_t val;           // value
-
-   int32_t        B;       // house holding
-   struct CCNode *L, *R;
 } CCNode;
 
 CCNode *findCCNode(uint32_t cc, CCNode  *node);
@@ -154,6 +455,21 @@ static inline uint32_t cce(uint16_t cc)
    return (ca[b2_0]-'A')*26 + (ca[b2_1]-'A');   // AA to ZZ ranges from 0 to 675
 }
 
+// The two letters of a country code, f.ex. in the cc field of the range sets, as the uint16_t of cce() and of the values.
+static inline uint16_t cc16(const void *cc)
+{
+   uint16_t cc2;
+   memcpy(&cc2, cc, sizeof(uint16_t));
+   return cc2;
+}
+
+// The cce() of a proper country code, or ccTableSize for anything else in the cc field.
+static inline uint32_t ccKey(uint32_t cc)
+{
+   uint8_t *ca = (uint8_t *)&cc;
+   return ((uint8_t)(ca[0] - 'A') < 26 && (uint8_t)(ca[1] - 'A') < 26 && !ca[2] && !ca[3]) ? cce(cc16(&cc)) : ccTableSize;
+}
+
 CCNode **createCCTable(void);
 void    releaseCCTable(CCNode *table[]);
 
@@ -166,22 +482,20 @@ void  removeCC(CCNode *table[], uint32_t cc);
 
 typedef struct NSONode
 {
+   avlnode  avl;           // tree head
    char    *nso;           // net segmenet owner ID is the key
    uint32_t val;           // value
-
-   int             B;      // house holding
-   struct NSONode *L, *R;
 } NSONode;
 
-// CAUTION: The following recursive functions must not be called with nso == NULL.
+// CAUTION: The following functions must not be called with nso == NULL.
 //          For performace reasons no extra error cheking is done.
 NSONode *findNSONode(const char *nso, NSONode  *node);
-int       addNSONode(const char *nso, int nsl, uint32_t val, NSONode **node);
-int    removeNSONode(const char *nso, int nsl, NSONode **node);
-void  releaseNSOTree(NSONode *node);
+int       addNSONode(const char *nso, int nsl, uint32_t val, NSONode **node, arena *arena);
+int    removeNSONode(const char *nso, int nsl, NSONode **node, arena *arena);
 
 
 #pragma mark ••• Hash Table of unique Net Segements Owner ID's •••
+// table[0] holds the number n of slots, table[1..n] the trees and table[n+1] the arena of the nodes.
 NSONode **createNSOTable(uint n);
 void     releaseNSOTable(NSONode *table[]);
 
@@ -191,11 +505,69 @@ void    storeNSO(NSONode *table[], const char *nso, int nsl, uint32_t val);
 void   removeNSO(NSONode *table[], const char *nso, int nsl);
 
 
+#pragma mark ••• Dictionary of Net Segment Owners •••
+
+// The net segment owners are interned into a dictionary, and the rows of the s4 and s6 tables refer to them by their IDs.
+// The nso section of the database file holds the compacted owner strings (see nsocpy()) NUL-terminated in the order of
+// their IDs, beginning with ID 1, while ID 0 stands for no owner. Incremental updates only append new owners to the
+// dictionary, so that the IDs in the unchanged rows of the tables remain valid.
+typedef struct
+{
+   char     *data;         // the owner strings
+   uint32_t *offs;         // offs[id] is the offset of the string of the owner id in data
+   uint32_t  count;        // number of owners = highest ID
+   uint32_t  size, cap;    // length and capacity of data
+   uint32_t  ocap;         // capacity of offs
+   NSONode **table;        // hash table of the owners with their IDs as the values, only present for interning
+} NSODict;
+
+NSODict *createNSODict(const char *data, size_t size, boolean intern);   // from the content of an nso section, or empty
+NSODict   *loadNSODict(DBFile *db, boolean intern);                   // from the nso section of the database file
+uint32_t     internNSO(NSODict *dict, const char *nso);                 // returns the ID of the compacted owner, 0 on error
+void    releaseNSODict(NSODict **dict);
+
+static inline const char *nsoString(NSODict *dict, uint32_t id)
+{
+   return (dict && 0 < id && id <= dict->count) ? dict->data + dict->offs[id] : "";
+}
+
+
 #pragma mark ••• IP number/string utility functions •••
 
 #include <sys/socket.h>
 #include <arpa/inet.h>
 
+// Copy a net segment owner ID into the 36 bytes nso field of the range sets.
+// UUID's are compacted to 32 hex digits by removing the dashes, shorter ID's
+// are copied as is, and any other ID's are truncated to 31 chars.
+static inline void nsocpy(char *dst, const char *nso)
+{
+   switch (strvlen(nso))
+   {
+      default: // len < 32
+         strmlcpy(dst, nso, 32, NULL);
+         break;
+
+      case 32:
+         memvcpy(dst, nso, 32);
+         dst[32] = '\0';
+         break;
+
+      case 36:
+      {
+         const char *p = nso;
+         char *q = dst;
+          cpy8(q, p); p += 9, q += 8;
+          cpy4(q, p); p += 5, q += 4;
+          cpy4(q, p); p += 5, q += 4;
+          cpy4(q, p); p += 5, q += 4;
+         cpy12(q, p);
+         dst[32] = '\0';
+         break;
+      }
+   }
+}
+
 static inline uint32_t ipv4_str2bin(char *str)
 {
    uint32_t bin;
@@ -230,9 +602,28 @@ static inline char *ipv6_bin2str(uint128t bin, char *str)
 }
 
 
-static inline int32_t intlb4_1p(double v)
+// CIDR decomposition of the range [ip, hi]: returns the number of host bits m of the largest block which begins at ip
+// and does not extend beyond hi, i.e. the minimum of the trailing zeros of ip and the floor of log2 of hi - ip + 1.
+static inline int32_t cidrIP4(uint32_t ip, uint32_t hi)
+{
+   uint32_t span = hi - ip;
+   int32_t  a = (ip) ? __builtin_ctz(ip) : 32,
+            l = (span != UINT32_MAX) ? 31 - __builtin_clz(span + 1) : 32;
+   return (a < l) ? a : l;
+}
+
+static inline int32_t cidrIP6(uint128t ip, uint128t hi)
 {
-   return (int32_t)log2(v+1);
+   IP6Desc  d = {.number = ip}, s = {.number = sub_u128(hi, ip)};
+   int32_t  a = (d.quad[b2_0]) ? __builtin_ctzll(d.quad[b2_0])
+              : (d.quad[b2_1]) ? __builtin_ctzll(d.quad[b2_1]) + 64 : 128, l;
+
+   if (s.quad[b2_0] != UINT64_MAX)
+      l = (s.quad[b2_1]) ? 127 - __builtin_clzll(s.quad[b2_1]) : 63 - __builtin_clzll(s.quad[b2_0] + 1);
+   else
+      l = (s.quad[b2_1] == UINT64_MAX) ? 128 : 127 - __builtin_clzll(s.quad[b2_1] + 1);
+
+   return (a < l) ? a : l;
 }
 
 
@@ -272,20 +663,3 @@ static inline uint128t inteb6_m1(int32_t e)
    return (0 <= e && e <= 127) ? v6[e].number : u64_to_u128t(1);
 }
 
-static inline int32_t intlb6_1p(uint128t v)
-{
-   uint128t u;
-   int o, p, q;
-   for (p = 0, q = 127; p <= q;)
-   {
-      o = (p + q) >> 1;
-      if (le_u128(u = v6[o].number, v) && lt_u128(v, v6[o+1].number))
-         return o;
-      else if (lt_u128(v, u))
-         q = o-1;
-      else // (ge_u128(v, v6[o+1]))
-         p = o+1;
-   }
-
-   return 0;
-}
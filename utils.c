@@ -1021,6 +1021,333 @@ int num2str(char *dst, long double x, int m, int width, int digits, int formsel,
 }
 
 
+#pragma mark ••• Vector String Scanners •••
+
+#if defined(__x86_64__)
+
+   // All variants load aligned vectors only, which never cross a page boundary, and so, they may safely read
+   // beyond the terminating nul. The AVX2 and AVX-512 variants start at the vector boundary at or before s, and shift
+   // the mask of the first vector down by the excess. The SSE2 variants start exactly at s, which therefore must be
+   // 16 byte aligned, as are all the buffers passed by the callers.
+
+   static int chrscan_sse2(const char *s, char c)
+   {
+      __m128i  chr = _mm_set1_epi8(c), v;
+      unsigned bmask;
+
+      for (const char *p = s;; p += 16)
+      {
+         v = _mm_load_si128((__m128i *)p);
+         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nul16))
+                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, chr)))
+            return (int)(p - s) + __builtin_ctz(bmask);
+      }
+   }
+
+   static int ctlscan_sse2(const char *s)
+   {
+      unsigned bmask;
+
+      for (const char *p = s;; p += 16)
+         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(blk16, _mm_max_epu8(blk16, _mm_load_si128((__m128i *)p)))))
+            return (int)(p - s) + __builtin_ctz(bmask);
+   }
+
+   static int txtscan_sse2(const char *s)
+   {
+      __m128i  v;
+      unsigned bmask;
+
+      for (const char *p = s;; p += 16)
+      {
+         v = _mm_load_si128((__m128i *)p);
+         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nul16))
+                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(obl16, _mm_min_epu8(obl16, v))))
+            return (int)(p - s) + __builtin_ctz(bmask);
+      }
+   }
+
+
+   __attribute__((target("avx2")))
+   static int chrscan_avx2(const char *s, char c)
+   {
+      const char *p = (const char *)((intptr_t)s & ~31);
+      __m256i  nul = _mm256_setzero_si256(), chr = _mm256_set1_epi8(c), v;
+      unsigned bmask;
+
+      for (int sh = (int)(s - p);; p += 32, sh = 0)
+      {
+         v = _mm256_load_si256((__m256i *)p);
+         if (bmask = ((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nul))
+                    | (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, chr))) >> sh)
+            return (int)(p - s) + sh + __builtin_ctz(bmask);
+      }
+   }
+
+   __attribute__((target("avx2")))
+   static int ctlscan_avx2(const char *s)
+   {
+      const char *p = (const char *)((intptr_t)s & ~31);
+      __m256i  blk = _mm256_set1_epi8(0x20);
+      unsigned bmask;
+
+      for (int sh = (int)(s - p);; p += 32, sh = 0)
+         if (bmask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(blk, _mm256_max_epu8(blk, _mm256_load_si256((__m256i *)p)))) >> sh)
+            return (int)(p - s) + sh + __builtin_ctz(bmask);
+   }
+
+   __attribute__((target("avx2")))
+   static int txtscan_avx2(const char *s)
+   {
+      const char *p = (const char *)((intptr_t)s & ~31);
+      __m256i  nul = _mm256_setzero_si256(), obl = _mm256_set1_epi8(0x21), v;
+      unsigned bmask;
+
+      for (int sh = (int)(s - p);; p += 32, sh = 0)
+      {
+         v = _mm256_load_si256((__m256i *)p);
+         if (bmask = ((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nul))
+                    | (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(obl, _mm256_min_epu8(obl, v)))) >> sh)
+            return (int)(p - s) + sh + __builtin_ctz(bmask);
+      }
+   }
+
+
+   __attribute__((target("avx512bw")))
+   static int chrscan_avx512(const char *s, char c)
+   {
+      const char *p = (const char *)((intptr_t)s & ~63);
+      __m512i  chr = _mm512_set1_epi8(c), v;
+      uint64_t bmask;
+
+      for (int sh = (int)(s - p);; p += 64, sh = 0)
+      {
+         v = _mm512_load_si512((__m512i *)p);
+         if (bmask = (_mm512_testn_epi8_mask(v, v) | _mm512_cmpeq_epi8_mask(v, chr)) >> sh)
+            return (int)(p - s) + sh + __builtin_ctzll(bmask);
+      }
+   }
+
+   __attribute__((target("avx512bw")))
+   static int ctlscan_avx512(const char *s)
+   {
+      const char *p = (const char *)((intptr_t)s & ~63);
+      __m512i  blk = _mm512_set1_epi8(0x20);
+      uint64_t bmask;
+
+      for (int sh = (int)(s - p);; p += 64, sh = 0)
+         if (bmask = _mm512_cmple_epu8_mask(_mm512_load_si512((__m512i *)p), blk) >> sh)
+            return (int)(p - s) + sh + __builtin_ctzll(bmask);
+   }
+
+   __attribute__((target("avx512bw")))
+   static int txtscan_avx512(const char *s)
+   {
+      const char *p = (const char *)((intptr_t)s & ~63);
+      __m512i  blk = _mm512_set1_epi8(0x20), v;
+      uint64_t bmask;
+
+      for (int sh = (int)(s - p);; p += 64, sh = 0)
+      {
+         v = _mm512_load_si512((__m512i *)p);
+         if (bmask = (_mm512_testn_epi8_mask(v, v) | _mm512_cmpgt_epu8_mask(v, blk)) >> sh)
+            return (int)(p - s) + sh + __builtin_ctzll(bmask);
+      }
+   }
+
+
+   // The delimiter masks of the 64 byte blocks are flattened into the offsets of the set bits. delimscan() returns
+   // after the block with the terminating nul, or when less than 64 free offsets would remain.
+   static inline int flattenDelims(uint64_t dmask, uint64_t zmask, uint32_t base, uint32_t offs[], int n)
+   {
+      if (zmask)
+         dmask &= (zmask & -zmask) - 1;   // only the delimiters before the nul
+
+      for (; dmask; dmask &= dmask - 1)
+         offs[n++] = base + (uint32_t)__builtin_ctzll(dmask);
+      return n;
+   }
+
+   static int delimscan_sse2(const char *s, char sep, char eol, uint32_t offs[], int max, const char **end)
+   {
+      const char *p = (const char *)((intptr_t)s & ~63);
+      __m128i  spr = _mm_set1_epi8(sep), eor = _mm_set1_epi8(eol), v;
+      uint64_t dmask, zmask;
+      int      n = 0;
+
+      for (int sh = (int)(s - p);; p += 64, sh = 0)
+      {
+         dmask = zmask = 0;
+         for (int k = 0; k < 4; k++)
+         {
+            v = _mm_load_si128((__m128i *)&p[16*k]);
+            zmask |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nul16)) << 16*k;
+            dmask |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, spr), _mm_cmpeq_epi8(v, eor))) << 16*k;
+         }
+
+         n = flattenDelims(dmask >> sh, zmask >>= sh, (uint32_t)(p - s + sh), offs, n);
+         if (zmask)
+            return *end = p + sh + __builtin_ctzll(zmask), n;
+         if (n > max - 64)
+            return *end = p + 64, n;
+      }
+   }
+
+   __attribute__((target("avx2")))
+   static int delimscan_avx2(const char *s, char sep, char eol, uint32_t offs[], int max, const char **end)
+   {
+      const char *p = (const char *)((intptr_t)s & ~63);
+      __m256i  nul = _mm256_setzero_si256(), spr = _mm256_set1_epi8(sep), eor = _mm256_set1_epi8(eol), v, w;
+      uint64_t dmask, zmask;
+      int      n = 0;
+
+      for (int sh = (int)(s - p);; p += 64, sh = 0)
+      {
+         v = _mm256_load_si256((__m256i *)p), w = _mm256_load_si256((__m256i *)&p[32]);
+         zmask = (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nul))
+               | (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(w, nul)) << 32;
+         dmask = (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, spr), _mm256_cmpeq_epi8(v, eor)))
+               | (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(w, spr), _mm256_cmpeq_epi8(w, eor))) << 32;
+
+         n = flattenDelims(dmask >> sh, zmask >>= sh, (uint32_t)(p - s + sh), offs, n);
+         if (zmask)
+            return *end = p + sh + __builtin_ctzll(zmask), n;
+         if (n > max - 64)
+            return *end = p + 64, n;
+      }
+   }
+
+   __attribute__((target("avx512bw")))
+   static int delimscan_avx512(const char *s, char sep, char eol, uint32_t offs[], int max, const char **end)
+   {
+      const char *p = (const char *)((intptr_t)s & ~63);
+      __m512i  spr = _mm512_set1_epi8(sep), eor = _mm512_set1_epi8(eol), v;
+      uint64_t dmask, zmask;
+      int      n = 0;
+
+      for (int sh = (int)(s - p);; p += 64, sh = 0)
+      {
+         v = _mm512_load_si512((__m512i *)p);
+         zmask = _mm512_testn_epi8_mask(v, v);
+         dmask = _mm512_cmpeq_epi8_mask(v, spr) | _mm512_cmpeq_epi8_mask(v, eor);
+
+         n = flattenDelims(dmask >> sh, zmask >>= sh, (uint32_t)(p - s + sh), offs, n);
+         if (zmask)
+            return *end = p + sh + __builtin_ctzll(zmask), n;
+         if (n > max - 64)
+            return *end = p + 64, n;
+      }
+   }
+
+
+   // The SSE2 variants serve as long as the scanners are not bound, e.g. in other constructors.
+   int (*chrscan)(const char *s, char c) = chrscan_sse2;
+   int (*ctlscan)(const char *s)         = ctlscan_sse2;
+   int (*txtscan)(const char *s)         = txtscan_sse2;
+   int (*delimscan)(const char *s, char sep, char eol, uint32_t offs[], int max, const char **end) = delimscan_sse2;
+
+   __attribute__((constructor))
+   static void bindScanners(void)
+   {
+      __builtin_cpu_init();
+
+      if (__builtin_cpu_supports("avx512bw"))
+         chrscan = chrscan_avx512, ctlscan = ctlscan_avx512, txtscan = txtscan_avx512, delimscan = delimscan_avx512;
+
+      else if (__builtin_cpu_supports("avx2"))
+         chrscan = chrscan_avx2, ctlscan = ctlscan_avx2, txtscan = txtscan_avx2, delimscan = delimscan_avx2;
+   }
+
+#else
+
+   int delimscan(const char *s, char sep, char eol, uint32_t offs[], int max, const char **end)
+   {
+      int n = 0;
+      const char *p;
+
+      for (p = s; *p && n < max; p++)
+         if (*p == sep || *p == eol)
+            offs[n++] = (uint32_t)(p - s);
+
+      *end = p;
+      return n;
+   }
+
+#endif
+
+
+#pragma mark ••• CRC32C Checksums •••
+
+#if defined(__x86_64__)
+
+   __attribute__((target("sse4.2")))
+   static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t n)
+   {
+      uint64_t c = crc;
+      for (; n && ((uintptr_t)p & 7); n--)
+         c = _mm_crc32_u8((uint32_t)c, *p++);
+      for (; n >= 8; n -= 8, p += 8)
+         c = _mm_crc32_u64(c, *(uint64_t *)p);
+      for (; n; n--)
+         c = _mm_crc32_u8((uint32_t)c, *p++);
+      return (uint32_t)c;
+   }
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+   #include <arm_acle.h>
+
+   static uint32_t crc32c_armv8(uint32_t crc, const uint8_t *p, size_t n)
+   {
+      for (; n && ((uintptr_t)p & 7); n--)
+         crc = __crc32cb(crc, *p++);
+      for (; n >= 8; n -= 8, p += 8)
+         crc = __crc32cd(crc, *(uint64_t *)p);
+      for (; n; n--)
+         crc = __crc32cb(crc, *p++);
+      return crc;
+   }
+
+#endif
+
+static uint32_t crc32c_table(uint32_t crc, const uint8_t *p, size_t n)
+{
+   static uint32_t table[256];
+
+   if (!table[1])
+      for (uint32_t i = 0; i < 256; i++)
+      {
+         uint32_t c = i;
+         for (int k = 0; k < 8; k++)
+            c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : c >> 1;   // reversed Castagnoli polynomial
+         table[i] = c;
+      }
+
+   for (; n; n--)
+      crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+   return crc;
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t size)
+{
+   crc = ~crc;
+
+#if defined(__x86_64__)
+   static int sse42 = -1;
+   if (sse42 < 0)
+      sse42 = __builtin_cpu_supports("sse4.2") != 0;
+   if (sse42)
+      return ~crc32c_sse42(crc, data, size);
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+   return ~crc32c_armv8(crc, data, size);
+
+#endif
+
+   return ~crc32c_table(crc, data, size);
+}
+
+
 #pragma mark ••• Fencing Memory Allocation Wrappers •••
 // FEATURES
 // -- optional clean-out in all stage, allocation, re-allocation and de-allocation
@@ -1030,14 +1357,24 @@ int num2str(char *dst, long double x, int m, int width, int digits, int formsel,
 // -- deallocate via handle which places NULL into the pointer
 
 ssize_t gAllocationTotal = 0;
+ssize_t gAllocationPeak  = 0;
+ssize_t gAllocationCount = 0;
 
 static inline void countAllocation(ssize_t size)
 {
-   if (__atomic_add_fetch(&gAllocationTotal, size, __ATOMIC_RELAXED) < 0)
+   ssize_t total;
+   if ((total = __atomic_add_fetch(&gAllocationTotal, size, __ATOMIC_RELAXED)) < 0)
    {
       syslog(LOG_ERR, "Corruption of allocated memory detected by countAllocation().");
       exit(EXIT_FAILURE);
    }
+
+   if (size > 0)
+   {
+      __atomic_add_fetch(&gAllocationCount, 1, __ATOMIC_RELAXED);
+      if (total > gAllocationPeak)
+         gAllocationPeak = total;
+   }
 }
 
 static inline uint8_t padcalc(void *ptr, uint8_t align)
@@ -1203,3 +1540,50 @@ ssize_t allocsize(void *p)
       ? ((allocation *)(p - allocationMetaSize - *(uint8_t *)(p-1)))->size
       : 0;
 }
+
+
+#pragma mark ••• Node Arena •••
+
+arena *createArena(ssize_t size)
+{
+   arena *a = allocate(sizeof(arena), default_align, true);
+   if (a)
+      a->size = (size + 15) & ~(ssize_t)15;  // keep the nodes 16 byte aligned
+   return a;
+}
+
+void releaseArena(arena **a)
+{
+   if (a && *a)
+   {
+      arenablock *b, *next;
+      for (b = (*a)->block; b; b = next)
+      {
+         next = b->next;
+         deallocate(VPR(b), false);
+      }
+      deallocate(VPR(*a), false);
+   }
+}
+
+void *arenaSpace(arena *a, ssize_t size)
+{
+   ssize_t     space = (size <= ARENA_BLOCK_SIZE) ? ARENA_BLOCK_SIZE : size;
+   arenablock *b = allocate(sizeof(arenablock) + space, 16, false);
+   if (b)
+   {
+      b->next  = a->block;
+      b->size  = space;
+      a->block = b;
+      a->blocks++;
+
+      if (space > size)                   // oversized requests don't replace the current block
+      {
+         a->next = b->space + size;
+         a->end  = b->space + space;
+      }
+      return b->space;
+   }
+
+   return NULL;
+}
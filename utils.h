@@ -435,7 +435,14 @@ static inline char *uppercase(char *s, int n)
    static const __m128i blk16 = {0x2020202020202020ULL, 0x2020202020202020ULL};  // 16 bytes with inner blank limit
    static const __m128i obl16 = {0x2121212121212121ULL, 0x2121212121212121ULL};  // 16 bytes with outer blank limit
 
-   // Drop-in replacement for strlen() and memcpy(), utilizing some builtin SSSE3 instructions
+   // Continuation of the scanners below beyond their first 16 bytes, s is aligned to 16 bytes. The scans are bound
+   // once at startup to the SSE2, AVX2 or AVX-512BW variants in utils.c, whichever are the widest the CPU supports.
+   extern int (*chrscan)(const char *s, char c);   // offset of the first nul or c
+   extern int (*ctlscan)(const char *s);           // offset of the first control character or blank, incl. nul
+   extern int (*txtscan)(const char *s);           // offset of the first nul or the first non-blank character
+   extern int (*delimscan)(const char *s, char sep, char eol, uint32_t offs[], int max, const char **end);
+
+   // Drop-in replacement for strlen() and memcpy(), utilizing some builtin SSE2 instructions
    static inline int strvlen(const char *str)
    {
       if (!str || !*str)
@@ -445,9 +452,8 @@ static inline char *uppercase(char *s, int n)
       if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)str), nul16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)str%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&str[len]), nul16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)str%16;
+      return len + chrscan(&str[len], '\0');
    }
 
    static inline void memvcpy(void *dst, const void *src, size_t n)
@@ -491,10 +497,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)line), lfd16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)line%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&line[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&line[len]), lfd16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)line%16;
+      return len + chrscan(&line[len], '\n');
    }
 
    static inline int sectlen(const char *sect)
@@ -507,10 +511,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)sect), vtt16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)sect%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&sect[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&sect[len]), vtt16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)sect%16;
+      return len + chrscan(&sect[len], '\v');
    }
 
    static inline int collen(const char *col)
@@ -523,10 +525,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)col), col16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)col%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&col[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&col[len]), col16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)col%16;
+      return len + chrscan(&col[len], ':');
    }
 
    static inline int taglen(const char *tag)
@@ -539,10 +539,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)tag), grt16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)tag%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&tag[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&tag[len]), grt16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)tag%16;
+      return len + chrscan(&tag[len], '>');
    }
 
    static inline int fieldlen(const char *field)
@@ -555,10 +553,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)field), vtl16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)field%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&field[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&field[len]), vtl16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)field%16;
+      return len + chrscan(&field[len], '|');
    }
 
    static inline int domlen(const char *domain)
@@ -571,10 +567,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)domain), dot16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)domain%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&domain[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&domain[len]), dot16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)domain%16;
+      return len + chrscan(&domain[len], '.');
    }
 
    static inline int segmlen(const char *segm)
@@ -587,10 +581,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)segm), sls16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)segm%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&segm[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&segm[len]), sls16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)segm%16;
+      return len + chrscan(&segm[len], '/');
    }
 
    static inline int vdeflen(const char *vardef)
@@ -603,10 +595,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)vardef), amp16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)vardef%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&vardef[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&vardef[len]), amp16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)vardef%16;
+      return len + chrscan(&vardef[len], '&');
    }
 
    static inline int vnamlen(const char *varname)
@@ -619,10 +609,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)varname), equ16)))
          return __builtin_ctz(bmask);
 
-      for (int len = 16 - (intptr_t)varname%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&varname[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&varname[len]), equ16)))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)varname%16;
+      return len + chrscan(&varname[len], '=');
    }
 
    static inline int wordlen(const char *word)
@@ -634,9 +622,8 @@ static inline char *uppercase(char *s, int n)
       if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(blk16, _mm_max_epu8(blk16, _mm_loadu_si128((__m128i *)word)))))
          return __builtin_ctz(bmask);      // ^^^^^^^ unsigned comparison (a >= b) is identical to a == maxu(a, b) ^^^^^^^
 
-      for (int len = 16 - (intptr_t)word%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(blk16, _mm_max_epu8(blk16, _mm_load_si128((__m128i *)&word[len])))))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)word%16;
+      return len + ctlscan(&word[len]);
    }
 
    static inline int blanklen(const char *blank)
@@ -649,10 +636,8 @@ static inline char *uppercase(char *s, int n)
                 | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(obl16, _mm_min_epu8(obl16, _mm_loadu_si128((__m128i *)blank)))))
          return __builtin_ctz(bmask);      // ^^^^^^^ unsigned comparison (a <= b) is identical to a == minu(a, b) ^^^^^^^
 
-      for (int len = 16 - (intptr_t)blank%16;; len += 16)
-         if (bmask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)&blank[len]), nul16))
-                   | (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(obl16, _mm_min_epu8(obl16, _mm_load_si128((__m128i *)&blank[len])))))
-            return len + __builtin_ctz(bmask);
+      int len = 16 - (intptr_t)blank%16;
+      return len + txtscan(&blank[len]);
    }
 
 
@@ -713,6 +698,8 @@ static inline char *uppercase(char *s, int n)
    #define strvlen(s) (int)strlen(s)
    #define memvcpy(d,s,n)  memcpy(d,s,n)
 
+   int delimscan(const char *s, char sep, char eol, uint32_t offs[], int max, const char **end);
+
    static inline int linelen(const char *line)
    {
       if (!line || !*line)
@@ -865,6 +852,46 @@ static inline char *uppercase(char *s, int n)
 #endif
 
 
+// Structural index of a buffer with records of fields, f.ex. the pipe separated RIR statistics. delimscan() scans
+// the buffer once in blocks of 64 bytes, and stores the offsets of all sep and eol characters up to the terminating
+// nul into offs, which are then walked by nextDelim(), so that the fields are never scanned again.
+#define DELIM_BATCH 4096
+
+typedef struct
+{
+   char      *base;      // the offsets are relative to base
+   char      *next;      // scanning continues here, once all offsets have been walked
+   char       sep, eol;
+   int        count, k;
+   uint32_t   offs[DELIM_BATCH];
+} FieldIndex;
+
+static inline void indexFields(FieldIndex *fi, char *buf, char sep, char eol)
+{
+   fi->base = fi->next = buf;
+   fi->sep = sep, fi->eol = eol;
+   fi->count = fi->k = 0;
+}
+
+// Returns the position of the next sep or eol character, or NULL at the terminating nul of the buffer.
+// The fields which have been walked already may be modified, f.ex. by placing a nul at their ends.
+static inline char *nextDelim(FieldIndex *fi)
+{
+   if (fi->k == fi->count)
+   {
+      if (!*fi->next)
+         return NULL;
+
+      fi->base = fi->next;
+      if ((fi->count = delimscan(fi->base, fi->sep, fi->eol, fi->offs, DELIM_BATCH, (const char **)&fi->next)) == 0)
+         return NULL;
+      fi->k = 0;
+   }
+
+   return fi->base + fi->offs[fi->k++];
+}
+
+
 // String concat to dst with variable number of src/len pairs, whereby each len
 // serves as the l parameter in strmlcpy(), i.e. strmlcpy(dst, src, ml, &len)
 // m: Max. capacity of dst, including the final nul.
@@ -1275,6 +1302,13 @@ enum
 int num2str(char *dst, long double x, int m, int width, int digits, int formsel, char decsep);
 
 
+#pragma mark ••• CRC32C Checksums •••
+
+// CRC-32C (Castagnoli) of size bytes of data, continuing from the checksum crc of the preceding
+// data, which is 0 at the beginning. Utilizes the CRC32 instructions of SSE4.2 or ARMv8, if present.
+uint32_t crc32c(uint32_t crc, const void *data, size_t size);
+
+
 #pragma mark ••• Oversize Protection for variable length arrays and alloca() •••
 #define OSP(cnt) ((cnt <= 4096) ? cnt : (exit(EXIT_FAILURE), 1))
 
@@ -1306,6 +1340,10 @@ typedef struct
 
 #define allocationMetaSize (offsetof(allocation, payload) - offsetof(allocation, size))
 
+extern ssize_t gAllocationTotal;   // bytes currently allocated
+extern ssize_t gAllocationPeak;    // maximum of gAllocationTotal
+extern ssize_t gAllocationCount;   // number of allocations and growing reallocations
+
 void *allocate(ssize_t size, uint8_t align, boolean cleanout);
 void *reallocate(void *p, ssize_t size, boolean cleanout, boolean free_on_error);
 void deallocate(void **p, boolean cleanout);
@@ -1314,6 +1352,77 @@ void deallocate_batch(int cleanout, ...);
 ssize_t allocsize(void *p);
 
 
+#pragma mark ••• Node Arena •••
+// Slab allocation of equally sized nodes for the search trees. The nodes are cut from large blocks
+// without any per node overhead, removed nodes are recycled by way of a free list, and all nodes of
+// an arena are released at once together with its blocks.
+
+#define ARENA_BLOCK_SIZE 262144
+
+typedef struct arenablock
+{
+   struct arenablock *next;
+   ssize_t size;
+   char    space[] __attribute__((aligned(16)));   // the nodes and bytes are cut at 16 byte boundaries
+} arenablock;
+
+typedef struct
+{
+   ssize_t     size;          // node size
+   ssize_t     count;         // number of nodes in use
+   ssize_t     total;         // number of node allocations
+   ssize_t     reused;        // number of allocations served by the free list
+   ssize_t     blocks;        // number of allocated blocks
+   void       *free;          // free list of removed nodes
+   char       *next, *end;    // unused space of the current block
+   arenablock *block;         // list of the allocated blocks
+} arena;
+
+arena *createArena(ssize_t size);
+void  releaseArena(arena **a);
+void *arenaSpace(arena *a, ssize_t size);       // slow path, cuts size bytes from a new block
+
+static inline void *arenaAlloc(arena *a)
+{
+   void *p;
+
+   if (p = a->free)
+      a->free = *(void **)p, a->reused++;
+   else if (a->end - a->next >= a->size)
+      p = a->next, a->next += a->size;
+   else if ((p = arenaSpace(a, a->size)) == NULL)
+      return NULL;
+
+   a->count++, a->total++;
+   return memset(p, 0, a->size);
+}
+
+static inline void arenaFree(arena *a, void *p)
+{
+   if (p)
+   {
+      *(void **)p = a->free;
+      a->free = p;
+      a->count--;
+   }
+}
+
+// Bytes of arbitrary size, e.g. for the keys of the nodes, are not recycled but released together with the arena.
+// The sizes are rounded up like those of the nodes, so that the nodes cut after them stay 16 byte aligned.
+static inline void *arenaBytes(arena *a, ssize_t size)
+{
+   void *p;
+
+   size = (size + 15) & ~(ssize_t)15;
+   if (a->end - a->next >= size)
+      p = a->next, a->next += size;
+   else
+      p = arenaSpace(a, size);
+
+   return p;
+}
+
+
 #pragma mark ••• Dynamic Buffer facility •••
 
 #define DYNAMIC_BUFFER_SIZE 8192